@@ -2,6 +2,7 @@
 #define AIGRAPH_H
 
 #include <stddef.h>
+#include <stdlib.h>
 
 #define LEN(x) (sizeof(x)/sizeof(x)[0])
 
@@ -9,6 +10,11 @@ typedef short node_type;
 
 typedef enum { FIELD_INT, FIELD_FLOAT, FIELD_ENUM } property_type;
 
+/* built-in kernels a node type compiles to, see compiler.h; OP_KERNEL calls the type's own, see kernels.h */
+typedef enum { OP_NONE, OP_INPUT, OP_SUM, OP_SUM3, OP_NEGATE, OP_PLAY_ANIM, OP_KERNEL, OP_GLOBAL, OP_COUNT } node_op;
+
+struct node_kernels;
+
 struct property_info
 {
     char *name;
@@ -30,16 +36,19 @@ struct node_info
 {
     char *name;
     char *category;
+    node_op op;
     int prop_count;
     int input_count;
     int output_count;
     struct property_info *props;
     struct input_info *inputs;
     struct output_info *outputs;
+    const struct node_kernels *kernels;  /* native kernels of OP_KERNEL types */
 };
 
 struct enum_info
 {
+    char *name;
     int count;
     char **values;
 };
@@ -50,6 +59,9 @@ struct config
     struct enum_info *enums;
     int enum_count;
     int node_count;
+    struct config_symbols *symbols;  /* name lookups, see symbols.h */
+    void *storage;  /* owned by whatever loaded the config, see config_file.h */
+    void (*release)(struct config *conf);
 };
 
 static struct input_info sum_inputs[] = 
@@ -87,25 +99,45 @@ static struct property_info play_anim_props[] =
 {
     {.name = "animation", .type = FIELD_ENUM, .enum_type = 0 /* animation */ }
 };
+static struct property_info input_props[] =
+{
+    {.name = "index", .type = FIELD_INT}
+};
+static struct output_info input_outputs[] =
+{
+    {.name = "out"}
+};
+static struct property_info global_props[] =
+{
+    {.name = "index", .type = FIELD_INT}
+};
+static struct output_info global_outputs[] =
+{
+    {.name = "out"}
+};
 #define INPUTS(x) .inputs = x, .input_count = LEN(x)
 #define OUTPUTS(x) .outputs = x, .output_count = LEN(x)
 #define PROPS(x) .props = x, .prop_count = LEN(x)
 static struct node_info default_nodes[] = 
 {
-    {.name = "sum", .category = "math", INPUTS(sum_inputs), OUTPUTS(sum_outputs)},
-    {.name = "sum3", .category = "math", INPUTS(sum3_inputs), OUTPUTS(sum3_outputs)},
-    {.name = "negate", .category = "math", INPUTS(negate_inputs), OUTPUTS(negate_outputs)},
-    {.name = "play_anim", .category = "control", INPUTS(play_anim_inputs), PROPS(play_anim_props)}
+    {.name = "sum", .category = "math", .op = OP_SUM, INPUTS(sum_inputs), OUTPUTS(sum_outputs)},
+    {.name = "sum3", .category = "math", .op = OP_SUM3, INPUTS(sum3_inputs), OUTPUTS(sum3_outputs)},
+    {.name = "negate", .category = "math", .op = OP_NEGATE, INPUTS(negate_inputs), OUTPUTS(negate_outputs)},
+    {.name = "play_anim", .category = "control", .op = OP_PLAY_ANIM, INPUTS(play_anim_inputs), PROPS(play_anim_props)},
+    /* reads the agent's input slot `index` */
+    {.name = "input", .category = "input", .op = OP_INPUT, PROPS(input_props), OUTPUTS(input_outputs)},
+    /* reads the world's global slot `index`, the same for every agent */
+    {.name = "global", .category = "input", .op = OP_GLOBAL, PROPS(global_props), OUTPUTS(global_outputs)}
 };
 #undef INPUTS
 #undef OUTPUTS
 #undef PROPS
 
 static char *animation_enum[] = {"idle", "wave_hand"};
-#define ENUM(x) {.count = LEN(x), .values = x}
+#define ENUM(n, x) {.name = n, .count = LEN(x), .values = x}
 static struct enum_info default_enums[] = 
 {
-    ENUM(animation_enum)
+    ENUM("animation", animation_enum)
 };
 #undef ENUM
 
@@ -116,11 +148,21 @@ config_init_default(struct config *conf)
     conf->enums = default_enums;
     conf->node_count = LEN(default_nodes);
     conf->enum_count = LEN(default_enums);
+    conf->symbols = NULL;
+    conf->storage = NULL;
+    conf->release = NULL;
 }
 
 static void
 config_cleanup(struct config *conf)
 {
+    free(conf->symbols);
+    conf->symbols = NULL;
+    if (conf->release)
+    {
+        conf->release(conf);
+        return;
+    }
     if (conf->nodes != default_nodes) free(conf->nodes);
     if (conf->enums != default_enums) free(conf->enums);
 }
@@ -0,0 +1,425 @@
+#ifndef ASSET_INDEX_H
+#define ASSET_INDEX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <SDL2/SDL_endian.h>
+#include <SDL2/SDL_error.h>
+#include "aigraph.h"
+#include "graph_file.h"
+#include "compiler.h"
+#include "save_job.h"
+#include "jobs.h"
+#include "dir_walk.h"
+
+/*
+ * Index of the graphs in an asset directory, kept in '<dir>/aigraph.idx' so
+ * a library can be browsed without opening any graph. Per .aig it records
+ * mtime and size (to notice changes), the graph hash, node and link counts,
+ * how many nodes of each type it has and how often each enum value is
+ * referenced. Refreshing only rescans files whose mtime or size changed.
+ *
+ * File layout (little-endian):
+ *   struct aidx_header
+ *   struct aidx_entry[entry_count]
+ *   u32 counts[entry_count][type_count + enum_value_count]
+ *   string table of NUL-terminated paths relative to the directory
+ * An index written against another config is thrown away and rebuilt.
+ */
+
+#define AIDX_MAGIC "AIGIDX"
+#define AIDX_VERSION 1
+#define AIDX_FILE "aigraph.idx"
+
+enum asset_flags { ASSET_INVALID = 1 };
+
+struct aidx_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint64_t config_hash;
+    uint32_t type_count, enum_value_count;
+    uint32_t strings_size;
+    uint32_t reserved;
+};
+
+struct aidx_entry
+{
+    uint64_t mtime, size, hash;
+    uint32_t path;      /* offset into the string table */
+    uint32_t flags;
+    uint32_t node_count, link_count;
+};
+
+struct asset_entry
+{
+    char *path;         /* relative to the index directory */
+    uint64_t mtime, size, hash;
+    uint32_t flags;
+    uint32_t node_count, link_count;
+    uint32_t *counts;   /* nodes per type, then references per enum value */
+};
+
+struct asset_index
+{
+    char *dir;
+    struct config *conf;
+    struct asset_entry *entries;    /* sorted by path */
+    int entry_count;
+    int type_count, enum_value_count;
+    int *enum_base;                 /* first enum value slot of each enum */
+};
+
+static void
+asset_entry_free(struct asset_entry *e)
+{
+    free(e->path);
+    free(e->counts);
+}
+
+static void
+asset_entries_free(struct asset_entry *entries, int count)
+{
+    for (int i = 0; i < count; ++i) asset_entry_free(&entries[i]);
+    free(entries);
+}
+
+static void
+asset_index_cleanup(struct asset_index *index)
+{
+    asset_entries_free(index->entries, index->entry_count);
+    free(index->enum_base);
+    free(index->dir);
+    memset(index, 0, sizeof *index);
+}
+
+static int
+asset_index_count_size(const struct asset_index *index)
+{
+    return index->type_count + index->enum_value_count;
+}
+
+static void
+aidx_swap_header(struct aidx_header *h)
+{
+    h->version = SDL_SwapLE32(h->version);
+    h->entry_count = SDL_SwapLE32(h->entry_count);
+    h->config_hash = SDL_SwapLE64(h->config_hash);
+    h->type_count = SDL_SwapLE32(h->type_count);
+    h->enum_value_count = SDL_SwapLE32(h->enum_value_count);
+    h->strings_size = SDL_SwapLE32(h->strings_size);
+}
+
+static void
+aidx_swap_entry(struct aidx_entry *e)
+{
+    e->mtime = SDL_SwapLE64(e->mtime);
+    e->size = SDL_SwapLE64(e->size);
+    e->hash = SDL_SwapLE64(e->hash);
+    e->path = SDL_SwapLE32(e->path);
+    e->flags = SDL_SwapLE32(e->flags);
+    e->node_count = SDL_SwapLE32(e->node_count);
+    e->link_count = SDL_SwapLE32(e->link_count);
+}
+
+/* reads '<dir>/aigraph.idx' if it matches the config; a missing or stale index is just empty */
+static void
+asset_index_read(struct asset_index *index)
+{
+    struct file_map map;
+    struct aidx_header h;
+    struct aidx_entry *records;
+    uint32_t *counts;
+    char *strings, path[1024];
+    int n = asset_index_count_size(index);
+    size_t size;
+
+    snprintf(path, sizeof path, "%s/%s", index->dir, AIDX_FILE);
+    if (!file_map_open(&map, path)) { SDL_ClearError(); return; }
+
+    if (map.size < sizeof h) goto done;
+    memcpy(&h, map.data, sizeof h);
+    aidx_swap_header(&h);
+    size = sizeof h + (size_t)h.entry_count * (sizeof *records + n * sizeof *counts) + h.strings_size;
+    if (memcmp(h.magic, AIDX_MAGIC, sizeof AIDX_MAGIC) || h.version != AIDX_VERSION ||
+        h.config_hash != config_hash(index->conf) || h.type_count != (uint32_t)index->type_count ||
+        h.enum_value_count != (uint32_t)index->enum_value_count || map.size != size || !h.strings_size)
+        goto done;
+
+    records = (struct aidx_entry*)((char*)map.data + sizeof h);
+    counts = (uint32_t*)(records + h.entry_count);
+    strings = (char*)(counts + (size_t)h.entry_count * n);
+    if (strings[h.strings_size - 1] != '\0') goto done;
+
+    index->entries = calloc(h.entry_count ? h.entry_count : 1, sizeof *index->entries);
+    if (!index->entries) goto done;
+    for (uint32_t i = 0; i < h.entry_count; ++i)
+    {
+        struct asset_entry *e = &index->entries[index->entry_count];
+        struct aidx_entry r = records[i];
+        aidx_swap_entry(&r);
+        if (r.path >= h.strings_size) break;
+        e->path = _strdup(strings + r.path);
+        e->counts = malloc(n * sizeof *e->counts + 1);
+        if (!e->path || !e->counts) { asset_entry_free(e); break; }
+        e->mtime = r.mtime;
+        e->size = r.size;
+        e->hash = r.hash;
+        e->flags = r.flags;
+        e->node_count = r.node_count;
+        e->link_count = r.link_count;
+        for (int j = 0; j < n; ++j) e->counts[j] = SDL_SwapLE32(counts[(size_t)i * n + j]);
+        ++index->entry_count;
+    }
+
+done:
+    file_map_close(&map);
+}
+
+/* writes `entries` as the index durably; returns 0 and sets the SDL error on failure */
+static int
+asset_index_write(const struct asset_index *index, const struct asset_entry *entries, int entry_count)
+{
+    struct aidx_header h;
+    struct aidx_entry *records;
+    uint32_t *counts;
+    char *data, *strings, path[1024], error[256];
+    int n = asset_index_count_size(index), ok;
+    size_t strings_size = 1, size;
+
+    for (int i = 0; i < entry_count; ++i) strings_size += strlen(entries[i].path) + 1;
+    size = sizeof h + (size_t)entry_count * (sizeof *records + n * sizeof *counts) + strings_size;
+    data = calloc(1, size);
+    if (!data) { SDL_SetError("out of memory"); return 0; }
+
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, AIDX_MAGIC, sizeof AIDX_MAGIC);
+    h.version = AIDX_VERSION;
+    h.entry_count = entry_count;
+    h.config_hash = config_hash(index->conf);
+    h.type_count = index->type_count;
+    h.enum_value_count = index->enum_value_count;
+    h.strings_size = (uint32_t)strings_size;
+    aidx_swap_header(&h);
+    memcpy(data, &h, sizeof h);
+
+    records = (struct aidx_entry*)(data + sizeof h);
+    counts = (uint32_t*)(records + entry_count);
+    strings = (char*)(counts + (size_t)entry_count * n);
+    strings_size = 1;  /* offset 0 is the empty string */
+    for (int i = 0; i < entry_count; ++i)
+    {
+        const struct asset_entry *e = &entries[i];
+        struct aidx_entry *r = &records[i];
+        size_t len = strlen(e->path) + 1;
+        r->mtime = e->mtime;
+        r->size = e->size;
+        r->hash = e->hash;
+        r->path = (uint32_t)strings_size;
+        r->flags = e->flags;
+        r->node_count = e->node_count;
+        r->link_count = e->link_count;
+        aidx_swap_entry(r);
+        for (int j = 0; j < n; ++j) counts[(size_t)i * n + j] = SDL_SwapLE32(e->counts[j]);
+        memcpy(strings + strings_size, e->path, len);
+        strings_size += len;
+    }
+
+    snprintf(path, sizeof path, "%s/%s", index->dir, AIDX_FILE);
+    ok = file_write_durable(path, data, size, error, sizeof error);
+    if (!ok) SDL_SetError("%s", error);
+    free(data);
+    return ok;
+}
+
+/* returns 0 and sets the SDL error on failure */
+static int
+asset_index_init(struct asset_index *index, const char *dir, struct config *conf)
+{
+    memset(index, 0, sizeof *index);
+    index->dir = _strdup(dir);
+    index->conf = conf;
+    index->type_count = conf->node_count;
+    index->enum_base = malloc((conf->enum_count + 1) * sizeof *index->enum_base);
+    if (!index->dir || !index->enum_base)
+    {
+        asset_index_cleanup(index);
+        SDL_SetError("out of memory");
+        return 0;
+    }
+    for (int i = 0; i < conf->enum_count; ++i)
+    {
+        index->enum_base[i] = index->enum_value_count;
+        index->enum_value_count += conf->enums[i].count;
+    }
+    index->enum_base[conf->enum_count] = index->enum_value_count;
+    asset_index_read(index);
+    return 1;
+}
+
+/* fills the summary of one graph; a graph that doesn't load is kept but flagged invalid */
+static void
+asset_index_scan(const struct asset_index *index, struct asset_entry *e)
+{
+    struct config *conf = index->conf;
+    struct graph_view view;
+    char path[1024];
+
+    memset(e->counts, 0, asset_index_count_size(index) * sizeof *e->counts);
+    e->flags = ASSET_INVALID;
+    e->node_count = e->link_count = 0;
+    e->hash = 0;
+
+    snprintf(path, sizeof path, "%s/%s", index->dir, e->path);
+    if (!graph_view_open(&view, path) || !graph_view_validate(&view, conf) ||
+        !graph_view_hash(&view, conf, NULL, NULL, &e->hash))
+    {
+        graph_view_free(&view);
+        return;
+    }
+
+    e->flags = 0;
+    e->node_count = view.node_count;
+    e->link_count = view.link_count;
+    for (int i = 0; i < view.node_count; ++i) ++e->counts[view.nodes[i].type];
+    for (int i = 0; i < view.prop_count; ++i)
+    {
+        struct aig_prop *p = &view.props[i];
+        struct property_info *info = &conf->nodes[view.nodes[p->node_id].type].props[p->slot];
+        union { int32_t i; short e; } value;
+        value.i = p->value;
+        if (info->type == FIELD_ENUM && value.e >= 0 && value.e < conf->enums[info->enum_type].count)
+            ++e->counts[index->type_count + index->enum_base[info->enum_type] + value.e];
+    }
+    graph_view_free(&view);
+}
+
+static void
+asset_index_scan_job(void *user, int i, int worker)
+{
+    const struct asset_index *index = ((void**)user)[0];
+    struct asset_entry **pending = ((void**)user)[1];
+    (void)worker;
+    asset_index_scan(index, pending[i]);
+}
+
+static int
+asset_entry_compare(const void *a, const void *b)
+{
+    return strcmp(((const struct asset_entry*)a)->path, ((const struct asset_entry*)b)->path);
+}
+
+/*
+ * Lists the directory as it is now into `*entries`: new and changed files
+ * are scanned (on `pool` if given), the others copied from the index, and
+ * the index file is rewritten if anything changed. The index itself is only
+ * read, so it can be shown meanwhile and swapped in with
+ * asset_index_replace. Returns the number of entries that changed, or -1
+ * and sets the SDL error on failure.
+ */
+static int
+asset_index_rescan(const struct asset_index *index, struct job_pool *pool, struct asset_entry **entries,
+    int *entry_count)
+{
+    struct path_list files;
+    struct asset_entry *next, **pending;
+    int pending_count = 0, matched = 0, changed, n = asset_index_count_size(index);
+    size_t prefix = strlen(index->dir) + 1;
+    const void *job[2];
+
+    if (!dir_walk(index->dir, ".aig", &files)) return -1;
+
+    next = calloc(files.count ? files.count : 1, sizeof *next);
+    pending = malloc((files.count ? files.count : 1) * sizeof *pending);
+    if (!next || !pending) goto out_of_memory;
+
+    /* both lists are sorted by path, so old entries are matched in one merge */
+    for (int i = 0, j = 0; i < files.count; ++i)
+    {
+        struct asset_entry *e = &next[i];
+        const char *rel = files.paths[i] + prefix;
+        const struct asset_entry *old = NULL;
+        int cmp = 1;
+
+        while (j < index->entry_count && (cmp = strcmp(index->entries[j].path, rel)) < 0) ++j;
+        file_stat(files.paths[i], &e->mtime, &e->size);
+        if (j < index->entry_count && cmp == 0)
+        {
+            old = &index->entries[j++];
+            ++matched;
+            if (old->mtime != e->mtime || old->size != e->size) old = NULL;
+        }
+        e->path = _strdup(rel);
+        e->counts = malloc(n * sizeof *e->counts + 1);
+        if (!e->path || !e->counts) goto out_of_memory;
+        if (!old)
+        {
+            pending[pending_count++] = e;
+            continue;
+        }
+        e->hash = old->hash;
+        e->flags = old->flags;
+        e->node_count = old->node_count;
+        e->link_count = old->link_count;
+        memcpy(e->counts, old->counts, n * sizeof *e->counts);
+    }
+
+    job[0] = index;
+    job[1] = pending;
+    if (pool) jobs_run(pool, pending_count, asset_index_scan_job, (void*)job);
+    else for (int i = 0; i < pending_count; ++i) asset_index_scan(index, pending[i]);
+
+    changed = pending_count + (index->entry_count - matched);
+    free(pending);
+    *entries = next;
+    *entry_count = files.count;
+    path_list_free(&files);
+
+    if (changed && !asset_index_write(index, *entries, *entry_count)) return -1;
+    return changed;
+
+out_of_memory:
+    asset_entries_free(next, next ? files.count : 0);
+    free(pending);
+    path_list_free(&files);
+    SDL_SetError("out of memory");
+    return -1;
+}
+
+/* swaps in entries from asset_index_rescan, taking ownership of them */
+static void
+asset_index_replace(struct asset_index *index, struct asset_entry *entries, int entry_count)
+{
+    asset_entries_free(index->entries, index->entry_count);
+    index->entries = entries;
+    index->entry_count = entry_count;
+}
+
+/*
+ * Brings the index up to date with the directory. Returns the number of
+ * entries that changed, or -1 and sets the SDL error on failure.
+ */
+static int
+asset_index_refresh(struct asset_index *index, struct job_pool *pool)
+{
+    struct asset_entry *entries = NULL;
+    int entry_count = 0, changed = asset_index_rescan(index, pool, &entries, &entry_count);
+
+    /* a failed write still leaves a current listing */
+    if (entries) asset_index_replace(index, entries, entry_count);
+    return changed;
+}
+
+/* entry for a path relative to the index directory, or NULL */
+static struct asset_entry*
+asset_index_find(struct asset_index *index, const char *path)
+{
+    struct asset_entry key;
+    key.path = (char*)path;
+    return bsearch(&key, index->entries, index->entry_count, sizeof key, asset_entry_compare);
+}
+
+#endif
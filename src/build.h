@@ -0,0 +1,216 @@
+#ifndef BUILD_H
+#define BUILD_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_timer.h>
+#include <SDL2/SDL_error.h>
+#include "aigraph.h"
+#include "graph_file.h"
+#include "compiler.h"
+#include "native.h"
+#include "jobs.h"
+#include "dir_walk.h"
+
+/*
+ * Headless batch build (aigraph -build <dir>): every .aig file under a
+ * directory is loaded, validated and compiled next to itself as .aigc,
+ * spread over all cores. A graph whose .aigc already holds the same graph
+ * hash is left alone unless the build is forced. With -native each graph
+ * also gets its native library (see native.h), verified against the
+ * interpreter. Prints one line per graph and a summary.
+ */
+
+typedef enum { BUILD_COMPILED, BUILD_UP_TO_DATE, BUILD_FAILED } build_status;
+
+static const char *build_status_names[] = { "compiled", "up to date", "FAILED" };
+
+struct build_item
+{
+    const char *path;
+    build_status status;
+    float load_ms, compile_ms, native_ms;
+    unsigned instruction_count, register_count;
+    unsigned eliminated, merged;    /* eliminated: nodes folded or dead */
+    char message[256];
+};
+
+struct build
+{
+    struct config *conf;
+    struct build_item *items;
+    int force;
+    int native;     /* also build native libraries */
+};
+
+static float
+build_ms_since(Uint64 start)
+{
+    return (float)((SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+/*
+ * Builds the native library of a graph from `g` next to its .aig, unless
+ * the graph is up to date and its library already matches. A library that
+ * can't be built or doesn't match the interpreter fails the graph.
+ */
+static void
+build_native(struct build_item *item, struct compiled_graph *g)
+{
+    struct native_graph ng;
+    char base[1024], library[1024];
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    snprintf(base, sizeof base, "%.*s", (int)strlen(item->path) - 4, item->path);
+    snprintf(library, sizeof library, "%s" NATIVE_SUFFIX, base);
+    if (item->status == BUILD_UP_TO_DATE && native_graph_open(&ng, library, g))
+    {
+        native_graph_close(&ng);
+    }
+    else if (!native_graph_build(&ng, g, base))
+    {
+        item->status = BUILD_FAILED;
+        snprintf(item->message, sizeof item->message, "native: %s", SDL_GetError());
+    }
+    else
+    {
+        item->status = BUILD_COMPILED;
+        native_graph_close(&ng);
+    }
+    item->native_ms = build_ms_since(start);
+}
+
+static void
+build_graph(void *user, int index, int worker)
+{
+    struct build *b = user;
+    struct build_item *item = &b->items[index];
+    struct graph_view view;
+    struct compiled_graph g, existing;
+    char out[1024];
+    uint64_t hash;
+    Uint64 start = SDL_GetPerformanceCounter();
+    size_t len = strlen(item->path);
+
+    (void)worker;
+    item->status = BUILD_FAILED;
+    snprintf(out, sizeof out, "%.*sc", (int)len, item->path);
+
+    if (!graph_view_open(&view, item->path) || !graph_view_validate(&view, b->conf))
+    {
+        snprintf(item->message, sizeof item->message, "%s", SDL_GetError());
+        graph_view_free(&view);
+        return;
+    }
+    item->load_ms = build_ms_since(start);
+
+    start = SDL_GetPerformanceCounter();
+    if (!graph_view_hash(&view, b->conf, NULL, NULL, &hash))
+    {
+        item->compile_ms = build_ms_since(start);
+        snprintf(item->message, sizeof item->message, "%s", SDL_GetError());
+        graph_view_free(&view);
+        return;
+    }
+    if (!b->force && compiled_graph_open(&existing, out, b->conf))
+    {
+        int current = existing.header->graph_hash == hash;
+        item->instruction_count = existing.header->instruction_count;
+        item->eliminated = existing.header->folded_count + existing.header->dead_count;
+        item->merged = existing.header->merged_count;
+        item->register_count = existing.header->register_count;
+        if (current)
+        {
+            item->status = BUILD_UP_TO_DATE;
+            item->compile_ms = build_ms_since(start);
+            if (b->native) build_native(item, &existing);
+            compiled_graph_free(&existing);
+            graph_view_free(&view);
+            return;
+        }
+        compiled_graph_free(&existing);
+    }
+
+    if (!compile_graph_view(&g, &view, b->conf) || !compiled_graph_save(&g, out))
+        snprintf(item->message, sizeof item->message, "%s", SDL_GetError());
+    else
+    {
+        item->status = BUILD_COMPILED;
+        item->instruction_count = g.header->instruction_count;
+        item->eliminated = g.header->folded_count + g.header->dead_count;
+        item->merged = g.header->merged_count;
+        item->register_count = g.header->register_count;
+    }
+    item->compile_ms = build_ms_since(start);
+    if (b->native && item->status == BUILD_COMPILED) build_native(item, &g);
+    compiled_graph_free(&g);
+    graph_view_free(&view);
+}
+
+/*
+ * Builds every graph under `dir` on `thread_count` extra threads (negative
+ * for one per extra core), with native libraries if `native` is set.
+ * Returns 0 if any graph failed.
+ */
+static int
+build_directory(const char *dir, struct config *conf, int force, int native, int thread_count, FILE *report)
+{
+    struct path_list files;
+    struct job_pool pool;
+    struct build b;
+    int counts[3] = {0};
+    float load_ms = 0, compile_ms = 0, native_ms = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    if (!dir_walk(dir, ".aig", &files))
+    {
+        fprintf(report, "error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    /* the workers link graphs, pick their kernels before they start */
+    kernel_isa_active();
+    b.conf = conf;
+    b.force = force;
+    b.native = native;
+    b.items = calloc(files.count ? files.count : 1, sizeof *b.items);
+    if (!b.items || !jobs_init(&pool, thread_count))
+    {
+        fprintf(report, "error: couldn't start the build\n");
+        free(b.items);
+        path_list_free(&files);
+        return 0;
+    }
+    for (int i = 0; i < files.count; ++i) b.items[i].path = files.paths[i];
+
+    jobs_run(&pool, files.count, build_graph, &b);
+
+    for (int i = 0; i < files.count; ++i)
+    {
+        struct build_item *item = &b.items[i];
+        ++counts[item->status];
+        load_ms += item->load_ms;
+        compile_ms += item->compile_ms;
+        native_ms += item->native_ms;
+        fprintf(report, "%-10s %8.2f ms load %8.2f ms compile %7u instructions %6u registers %7u eliminated %7u merged  %s%s%s\n",
+            build_status_names[item->status], item->load_ms, item->compile_ms, item->instruction_count,
+            item->register_count, item->eliminated, item->merged, item->path, item->message[0] ? ": " : "", item->message);
+    }
+    fprintf(report, "%d graphs: %d compiled, %d up to date, %d failed\n",
+        files.count, counts[BUILD_COMPILED], counts[BUILD_UP_TO_DATE], counts[BUILD_FAILED]);
+    if (native)
+        fprintf(report, "%.1f ms load + %.1f ms compile + %.1f ms native in %.1f ms on %d threads, %s kernels\n",
+            load_ms, compile_ms, native_ms, build_ms_since(start), jobs_worker_count(&pool),
+            kernel_isa_names[kernel_isa_active()]);
+    else
+        fprintf(report, "%.1f ms load + %.1f ms compile in %.1f ms on %d threads, %s kernels\n",
+            load_ms, compile_ms, build_ms_since(start), jobs_worker_count(&pool), kernel_isa_names[kernel_isa_active()]);
+
+    jobs_cleanup(&pool);
+    free(b.items);
+    path_list_free(&files);
+    return counts[BUILD_FAILED] == 0;
+}
+
+#endif
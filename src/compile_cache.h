@@ -0,0 +1,168 @@
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <SDL2/SDL_error.h>
+#include "compiler.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+/*
+ * Content-addressed cache of compiled graphs keyed by graph_view_hash. A
+ * lookup tries the in-memory entries, then '<dir>/<hash>.aigc', and only
+ * compiles on a miss, storing the result in both. Files compiled against a
+ * different config never match since the config hash is part of the key,
+ * and compiled_graph_open rejects them anyway.
+ */
+
+#define COMPILE_CACHE_DEFAULT_DIR "aigcache"
+#define COMPILE_CACHE_CAPACITY 64
+
+struct compile_cache_entry
+{
+    uint64_t hash;
+    uint32_t last_use;
+    struct compiled_graph graph;  /* header == NULL for a free entry */
+};
+
+struct compile_cache
+{
+    char *dir;
+    struct config *conf;
+    struct compile_cache_entry entries[COMPILE_CACHE_CAPACITY];
+    uint32_t clock;
+    int memory_hits, disk_hits, misses;
+};
+
+static void
+compile_cache_init(struct compile_cache *cache, const char *dir, struct config *conf)
+{
+    memset(cache, 0, sizeof *cache);
+    cache->dir = _strdup(dir);
+    cache->conf = conf;
+#ifdef _WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0777);
+#endif
+}
+
+static void
+compile_cache_cleanup(struct compile_cache *cache)
+{
+    for (int i = 0; i < COMPILE_CACHE_CAPACITY; ++i) compiled_graph_free(&cache->entries[i].graph);
+    free(cache->dir);
+    memset(cache, 0, sizeof *cache);
+}
+
+static void
+compile_cache_path(struct compile_cache *cache, uint64_t hash, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%08x%08x.aigc", cache->dir, (uint32_t)(hash >> 32), (uint32_t)hash);
+}
+
+/* the least recently used entry, emptied */
+static struct compile_cache_entry*
+compile_cache_victim(struct compile_cache *cache)
+{
+    struct compile_cache_entry *victim = &cache->entries[0];
+
+    for (int i = 0; i < COMPILE_CACHE_CAPACITY; ++i)
+    {
+        struct compile_cache_entry *e = &cache->entries[i];
+        if (!e->graph.header) victim = e;
+        else if (victim->graph.header && e->last_use < victim->last_use) victim = e;
+    }
+    compiled_graph_free(&victim->graph);
+    return victim;
+}
+
+/* moves `g`, the program of `hash`, into the cache; returns where it now is */
+static struct compiled_graph*
+compile_cache_insert(struct compile_cache *cache, uint64_t hash, struct compiled_graph *g)
+{
+    struct compile_cache_entry *e = compile_cache_victim(cache);
+    e->hash = hash;
+    e->last_use = ++cache->clock;
+    e->graph = *g;
+    memset(g, 0, sizeof *g);
+    return &e->graph;
+}
+
+/*
+ * Program of `hash` from memory or disk, NULL on a miss. The result belongs
+ * to the cache and stays valid for the next COMPILE_CACHE_CAPACITY - 1
+ * lookups at least.
+ */
+static struct compiled_graph*
+compile_cache_find(struct compile_cache *cache, uint64_t hash)
+{
+    struct compiled_graph g;
+    char path[1024];
+
+    for (int i = 0; i < COMPILE_CACHE_CAPACITY; ++i)
+    {
+        struct compile_cache_entry *e = &cache->entries[i];
+        if (e->graph.header && e->hash == hash)
+        {
+            e->last_use = ++cache->clock;
+            ++cache->memory_hits;
+            return &e->graph;
+        }
+    }
+
+    compile_cache_path(cache, hash, path, sizeof path);
+    if (!compiled_graph_open(&g, path, cache->conf)) return NULL;
+    if (g.header->graph_hash != hash)
+    {
+        compiled_graph_free(&g);
+        return NULL;
+    }
+    ++cache->disk_hits;
+    return compile_cache_insert(cache, hash, &g);
+}
+
+/* stores a program compiled on a miss; a cache that can't be written still works from memory */
+static struct compiled_graph*
+compile_cache_store(struct compile_cache *cache, uint64_t hash, struct compiled_graph *g)
+{
+    char path[1024];
+
+    ++cache->misses;
+    compile_cache_path(cache, hash, path, sizeof path);
+    if (!compiled_graph_save(g, path)) SDL_ClearError();
+    return compile_cache_insert(cache, hash, g);
+}
+
+/*
+ * Compiled program for a validated, host-order view, with the lifetime of
+ * compile_cache_find's. `hit` is set when no compile was needed. Returns
+ * NULL and sets the SDL error on failure.
+ */
+static struct compiled_graph*
+compile_cache_get(struct compile_cache *cache, struct graph_view *view, int *hit)
+{
+    struct compiled_graph *found, g;
+    uint64_t hash;
+
+    *hit = 0;
+    if (!graph_view_hash(view, cache->conf, NULL, NULL, &hash)) return NULL;
+
+    found = compile_cache_find(cache, hash);
+    if (found)
+    {
+        *hit = 1;
+        return found;
+    }
+    if (!compile_graph_view(&g, view, cache->conf)) return NULL;
+    return compile_cache_store(cache, hash, &g);
+}
+
+#endif
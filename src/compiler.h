@@ -0,0 +1,1871 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <SDL2/SDL_endian.h>
+#include <SDL2/SDL_error.h>
+#include "aigraph.h"
+#include "kernels.h"
+#include "kernels_isa.h"
+#include "graph_file.h"
+#include "file_map.h"
+#include "save_job.h"
+
+/*
+ * Graph compiler and the compiled graph format (.aigc).
+ *
+ * A compiled graph is one relocatable blob: every reference inside it is an
+ * index or an offset from the start of the blob, so the runtime maps or reads
+ * the file and executes it where it lies.
+ *
+ *   header
+ *   instructions   struct aigc_instruction, in topological order, the
+ *                  uniform prologue first
+ *   operands       u32 register indices, instructions point at runs of them
+ *   constants      float, loaded into registers [0, const_count) once per agent
+ *   properties     i32, instructions point at runs of them
+ *   segments       struct aigc_segment, runs of instructions, see graph_compile_schedule
+ *
+ * Node outputs share the registers after the constants, reusing those of
+ * values no longer needed. Only nodes feeding a side effect get
+ * instructions, constant subgraphs are evaluated by the compiler,
+ * duplicate nodes share one instruction and frequent chains of nodes run
+ * as one superinstruction. Nodes that read no agent input, only globals
+ * and constants, compute the same for every agent; they form a prologue
+ * run once per tick (see compiled_graph_run_uniform) and their results
+ * keep their registers for the rest of the program. OP_KERNEL instructions
+ * name their node type and call its native kernels, which are looked up in
+ * the config when the blob is opened.
+ * Everything is stored little-endian and each section is AIGC_ALIGN-aligned.
+ * The header carries a hash of the config the graph was compiled against; a
+ * blob compiled against a different config is rejected when loaded. It also
+ * carries the hash of the source graph, which names the blob in compile
+ * caches.
+ */
+
+#define AIGC_MAGIC "AIGCOMP"
+#define AIGC_VERSION 9
+#define AIGC_ALIGN 16
+#define AIGC_ALIGN_UP(x) (((x) + AIGC_ALIGN - 1) & ~(size_t)(AIGC_ALIGN - 1))
+#define AIGC_NO_REGISTER UINT32_MAX
+
+struct aigc_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t size;              /* total blob size in bytes */
+    uint64_t config_hash;
+    uint64_t graph_hash;        /* see graph_view_hash */
+    uint32_t register_count;    /* peak registers live at once, see graph_compile_allocate */
+    uint32_t input_count;       /* agent input slots read, highest index + 1 */
+    uint32_t event_count;       /* most events one run can emit */
+    uint32_t instruction_count, instruction_offset;
+    uint32_t operand_count, operand_offset;
+    uint32_t const_count, const_offset;
+    uint32_t prop_count, prop_offset;
+    uint32_t node_count;        /* nodes in the source graph */
+    uint32_t folded_count;      /* of those, evaluated at compile time */
+    uint32_t merged_count;      /* of those, duplicates of another */
+    uint32_t dead_count;        /* of those, feeding no side effect */
+    uint32_t value_count;       /* outputs of the compiled nodes, registers they'd take without reuse */
+    uint32_t fused_count;       /* live nodes running inside another's superinstruction */
+    uint32_t segment_count, segment_offset;
+    uint32_t parallel_count;    /* instructions in parallel segments */
+    uint32_t global_count;      /* global slots read, highest index + 1 */
+    uint32_t uniform_count;     /* instructions of the uniform prologue */
+};
+
+struct aigc_instruction
+{
+    uint32_t op;        /* node_op */
+    uint32_t node;      /* id of the node in the source graph */
+    uint32_t dst;       /* first output register, AIGC_NO_REGISTER without outputs */
+    uint32_t props;     /* first property in the property table */
+    uint32_t args;      /* first operand */
+    uint32_t arg_count;
+    uint32_t type;      /* node type in the config */
+};
+
+/*
+ * A run of instructions. Those of a parallel segment are independent: none
+ * reads a register another one writes, so threads can split them; see
+ * wavefront.h. Segments cover the program in order.
+ */
+struct aigc_segment
+{
+    uint32_t first, count;
+    uint32_t parallel;
+};
+
+/* side effect requested by a run, e.g. an animation to play */
+struct aigc_event
+{
+    uint32_t op;
+    uint32_t node;
+    const int32_t *props;
+    float value;
+    uint32_t agent;     /* index in the batch, 0 for single runs */
+};
+
+/*
+ * Superinstructions: ops no node type compiles to, which the compiler fuses
+ * frequent chains of nodes into (see graph_compile_fuse), numbered after
+ * the node ops.
+ */
+enum
+{
+    AIGC_OP_SUB = OP_COUNT,     /* sum fed by a negate: a0 - a1 */
+    AIGC_OP_SUM_CHAIN,          /* left-nested sums: ((a0 + a1) + a2) + ... */
+    AIGC_OP_ADD_INPUT,          /* sum fed by an agent input: a0 + inputs[p0] */
+    AIGC_OP_COUNT
+};
+
+#define AIGC_CHAIN_MAX 8    /* operands of the longest sum chain */
+
+/* shape of each op, compiled nodes must match it; OP_KERNEL takes its node type's */
+struct aigc_op_info
+{
+    const char *name;
+    int inputs, outputs, props;     /* -1 for variable */
+    int side_effect;
+};
+
+static const struct aigc_op_info aigc_ops[AIGC_OP_COUNT] =
+{
+    [OP_NONE] = { "none", 0, 0, 0, 0 },
+    [OP_INPUT] = { "input", 0, 1, 1, 0 },
+    [OP_SUM] = { "sum", 2, 1, 0, 0 },
+    [OP_SUM3] = { "sum3", 3, 1, 0, 0 },
+    [OP_NEGATE] = { "negate", 1, 1, 0, 0 },
+    [OP_PLAY_ANIM] = { "play_anim", 1, 0, 1, 1 },
+    [OP_KERNEL] = { "kernel", -1, -1, -1, 0 },
+    [OP_GLOBAL] = { "global", 0, 1, 1, 0 },
+    [AIGC_OP_SUB] = { "sub", 2, 1, 0, 0 },
+    [AIGC_OP_SUM_CHAIN] = { "sum_chain", -1, 1, 0, 0 },
+    [AIGC_OP_ADD_INPUT] = { "add_input", 1, 1, 1, 0 },
+};
+
+/* kernels of an instruction op that reads and writes registers only, NULL for the others */
+static const struct node_kernels*
+aigc_op_kernels(uint32_t op)
+{
+    switch (op)
+    {
+        case AIGC_OP_SUB: return &sub_kernels;
+        case AIGC_OP_SUM_CHAIN: return &sum_kernels;
+        default: return op < OP_COUNT ? builtin_kernels((node_op)op) : NULL;
+    }
+}
+
+/* a compiled graph, either built in memory or opened from a file */
+struct compiled_graph
+{
+    struct aigc_header *header;
+    struct aigc_instruction *instructions;
+    uint32_t *operands;
+    float *consts;
+    int32_t *props;
+    struct aigc_segment *segments;
+    node_kernel *calls;             /* per instruction, see compiled_graph_link */
+    node_batch_kernel *batch_calls;
+    uint32_t *uniform_registers;    /* registers holding the prologue's results, see compiled_graph_link */
+    uint32_t uniform_register_count;
+    void *storage;          /* owned blob, if any */
+    struct file_map map;    /* owned mapping of the blob, if any */
+};
+
+static inline uint64_t
+fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ p[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+#define FNV1A_INIT 0xcbf29ce484222325ull
+
+static uint64_t
+fnv1a_int(uint64_t hash, int32_t value)
+{
+    return fnv1a(hash, &value, sizeof value);
+}
+
+static uint64_t
+fnv1a_string(uint64_t hash, const char *s)
+{
+    return fnv1a(hash, s, strlen(s) + 1);
+}
+
+/* hash of everything in the config a compiled graph depends on */
+static uint64_t
+config_hash(struct config *conf)
+{
+    uint64_t h = FNV1A_INIT;
+
+    h = fnv1a_int(h, conf->node_count);
+    for (int i = 0; i < conf->node_count; ++i)
+    {
+        struct node_info *n = &conf->nodes[i];
+        h = fnv1a_string(h, n->name);
+        h = fnv1a_int(h, n->op);
+        h = fnv1a_int(h, n->input_count);
+        h = fnv1a_int(h, n->output_count);
+        h = fnv1a_int(h, n->prop_count);
+        for (int j = 0; j < n->prop_count; ++j)
+        {
+            h = fnv1a_int(h, n->props[j].type);
+            h = fnv1a_int(h, n->props[j].enum_type);
+        }
+        /* purity decides what programs the compiler makes */
+        if (n->op == OP_KERNEL) h = fnv1a_int(h, n->kernels && (n->kernels->flags & KERNEL_PURE));
+    }
+    h = fnv1a_int(h, conf->enum_count);
+    for (int i = 0; i < conf->enum_count; ++i)
+        h = fnv1a_int(h, conf->enums[i].count);
+    return h;
+}
+
+static void
+compiled_graph_free(struct compiled_graph *g)
+{
+    free(g->storage);
+    free(g->calls);
+    free(g->batch_calls);
+    free(g->uniform_registers);
+    file_map_close(&g->map);
+    memset(g, 0, sizeof *g);
+}
+
+/* everything but the magic and the two hashes is 32-bit words */
+static void
+aigc_swap(void *blob, size_t size)
+{
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    struct aigc_header *h = blob;
+    uint32_t *w = blob;
+    h->config_hash = SDL_SwapLE64(h->config_hash);
+    h->graph_hash = SDL_SwapLE64(h->graph_hash);
+    for (size_t i = offsetof(struct aigc_header, version) / 4; i < size / 4; ++i)
+        if (i < offsetof(struct aigc_header, config_hash) / 4 ||
+            i >= offsetof(struct aigc_header, register_count) / 4)
+            w[i] = SDL_SwapLE32(w[i]);
+#else
+    (void)blob; (void)size;
+#endif
+}
+
+static int
+aigc_section_ok(struct aigc_header *h, uint32_t offset, uint32_t count, size_t record_size)
+{
+    return offset % 4 == 0 && offset <= h->size && count <= (h->size - offset) / record_size;
+}
+
+/*
+ * Points `g` into a host-order blob after checking that every offset,
+ * register and operand stays in bounds, so a corrupt file can't make a run
+ * read or write out of bounds. Returns 0 and sets the SDL error on failure.
+ */
+static int
+compiled_graph_bind(struct compiled_graph *g, void *blob, size_t size)
+{
+    struct aigc_header *h = blob;
+    uint32_t events = 0;
+
+    if (size < sizeof *h || h->size != size ||
+        !aigc_section_ok(h, h->instruction_offset, h->instruction_count, sizeof *g->instructions) ||
+        !aigc_section_ok(h, h->operand_offset, h->operand_count, sizeof *g->operands) ||
+        !aigc_section_ok(h, h->const_offset, h->const_count, sizeof *g->consts) ||
+        !aigc_section_ok(h, h->prop_offset, h->prop_count, sizeof *g->props) ||
+        !aigc_section_ok(h, h->segment_offset, h->segment_count, sizeof *g->segments) ||
+        h->const_count > h->register_count || h->uniform_count > h->instruction_count)
+    {
+        SDL_SetError("compiled graph is truncated or corrupt");
+        return 0;
+    }
+
+    g->header = h;
+    g->instructions = (struct aigc_instruction*)((char*)blob + h->instruction_offset);
+    g->operands = (uint32_t*)((char*)blob + h->operand_offset);
+    g->consts = (float*)((char*)blob + h->const_offset);
+    g->props = (int32_t*)((char*)blob + h->prop_offset);
+    g->segments = (struct aigc_segment*)((char*)blob + h->segment_offset);
+
+    for (uint32_t i = 0, next = 0; i <= h->segment_count; ++i)
+    {
+        if (i == h->segment_count ? next != h->instruction_count :
+            g->segments[i].first != next || g->segments[i].count > h->instruction_count - next)
+        {
+            SDL_SetError("compiled graph segments don't cover its instructions");
+            return 0;
+        }
+        if (i < h->segment_count) next += g->segments[i].count;
+    }
+
+    for (uint32_t i = 0; i < h->operand_count; ++i)
+    {
+        if (g->operands[i] >= h->register_count)
+        {
+            SDL_SetError("operand %u is out of range", i);
+            return 0;
+        }
+    }
+
+    for (uint32_t i = 0; i < h->instruction_count; ++i)
+    {
+        struct aigc_instruction *in = &g->instructions[i];
+        const struct aigc_op_info *op;
+        if (in->op == OP_NONE || in->op >= AIGC_OP_COUNT)
+        {
+            SDL_SetError("instruction %u: unknown op %u", i, in->op);
+            return 0;
+        }
+        op = &aigc_ops[in->op];
+        /* the prologue runs once for every agent, it can't read an agent's inputs or emit events */
+        if (i < h->uniform_count ? in->op == OP_INPUT || in->op == AIGC_OP_ADD_INPUT || op->side_effect :
+            in->op == OP_GLOBAL)
+        {
+            SDL_SetError("instruction %u doesn't belong %s the uniform prologue", i, i < h->uniform_count ? "in" : "after");
+            return 0;
+        }
+        if (in->op == OP_KERNEL)
+        {
+            /* the rest of the shape comes from the node type, see compiled_graph_link */
+            if (in->args > h->operand_count || in->arg_count > h->operand_count - in->args ||
+                in->props > h->prop_count)
+            {
+                SDL_SetError("instruction %u is out of range", i);
+                return 0;
+            }
+            continue;
+        }
+        if ((op->inputs < 0 ? in->arg_count < 2 || in->arg_count > AIGC_CHAIN_MAX : in->arg_count != (uint32_t)op->inputs) ||
+            in->args > h->operand_count ||
+            in->arg_count > h->operand_count - in->args ||
+            in->props > h->prop_count || (uint32_t)op->props > h->prop_count - in->props ||
+            (op->outputs && (in->dst >= h->register_count || in->dst < h->const_count ||
+                (uint32_t)op->outputs > h->register_count - in->dst)))
+        {
+            SDL_SetError("instruction %u is out of range", i);
+            return 0;
+        }
+        if ((in->op == OP_INPUT || in->op == AIGC_OP_ADD_INPUT) && (uint32_t)g->props[in->props] >= h->input_count)
+        {
+            SDL_SetError("instruction %u reads a missing input", i);
+            return 0;
+        }
+        if (in->op == OP_GLOBAL && (uint32_t)g->props[in->props] >= h->global_count)
+        {
+            SDL_SetError("instruction %u reads a missing global", i);
+            return 0;
+        }
+        events += op->side_effect;
+    }
+    if (events > h->event_count)
+    {
+        SDL_SetError("compiled graph emits more events than it declares");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Checks that the instructions of every parallel segment are independent,
+ * OP_KERNEL ones having their node type's outputs. Returns 0 and sets the
+ * SDL error if one reads or writes a register another one writes.
+ */
+static int
+compiled_graph_check_segments(struct compiled_graph *g, struct config *conf)
+{
+    struct aigc_header *h = g->header;
+    uint32_t *writer = NULL;    /* per register, 1 + the last segment writing it */
+    int ok = 1;
+
+    for (uint32_t s = 0; s < h->segment_count && ok; ++s)
+    {
+        struct aigc_segment *seg = &g->segments[s];
+        uint32_t end = seg->first + seg->count;
+
+        if (!seg->parallel) continue;
+        if (!writer && !(writer = calloc(h->register_count + 1, sizeof *writer)))
+        {
+            SDL_SetError("out of memory");
+            return 0;
+        }
+        for (uint32_t k = seg->first; k < end && ok; ++k)
+        {
+            struct aigc_instruction *in = &g->instructions[k];
+            int outputs = in->op == OP_KERNEL ? conf->nodes[in->type].output_count : aigc_ops[in->op].outputs;
+            for (int o = 0; o < outputs && ok; ++o)
+            {
+                ok = writer[in->dst + o] != s + 1;
+                writer[in->dst + o] = s + 1;
+            }
+        }
+        for (uint32_t k = seg->first; k < end && ok; ++k)
+        {
+            struct aigc_instruction *in = &g->instructions[k];
+            for (uint32_t j = 0; j < in->arg_count && ok; ++j) ok = writer[g->operands[in->args + j]] != s + 1;
+        }
+    }
+    free(writer);
+    if (!ok) SDL_SetError("compiled graph has dependent instructions in a parallel segment");
+    return ok;
+}
+
+/*
+ * Lists the registers the program after the uniform prologue reads before
+ * writing, constants aside: the prologue's results, which batches
+ * broadcast to every agent. Returns 0 and sets the SDL error when out of
+ * memory.
+ */
+static int
+compiled_graph_find_uniform(struct compiled_graph *g, struct config *conf)
+{
+    struct aigc_header *h = g->header;
+    unsigned char *seen = calloc(h->register_count + 1, 1);
+
+    g->uniform_register_count = 0;
+    g->uniform_registers = malloc((h->register_count + 1) * sizeof *g->uniform_registers);
+    if (!seen || !g->uniform_registers)
+    {
+        free(seen);
+        SDL_SetError("out of memory");
+        return 0;
+    }
+    for (uint32_t k = h->uniform_count; k < h->instruction_count; ++k)
+    {
+        struct aigc_instruction *in = &g->instructions[k];
+        int outputs = in->op == OP_KERNEL ? conf->nodes[in->type].output_count : aigc_ops[in->op].outputs;
+        for (uint32_t j = 0; j < in->arg_count; ++j)
+        {
+            uint32_t r = g->operands[in->args + j];
+            if (r < h->const_count || seen[r]) continue;
+            seen[r] = 1;
+            g->uniform_registers[g->uniform_register_count++] = r;
+        }
+        for (int o = 0; o < outputs; ++o) seen[in->dst + o] = 1;
+    }
+    free(seen);
+    return 1;
+}
+
+/*
+ * Looks up the kernels of every instruction in `conf`, built-in batch
+ * kernels in their variant for the active ISA (see kernels_isa.h), checks
+ * OP_KERNEL instructions against their node type and parallel segments
+ * for independence, which compiled_graph_bind can't, and finds the
+ * prologue's results.
+ * Returns 0 and sets the SDL error if a type is missing or doesn't match,
+ * e.g. because the plugin that provided it isn't loaded.
+ */
+static int
+compiled_graph_link(struct compiled_graph *g, struct config *conf)
+{
+    struct aigc_header *h = g->header;
+    uint32_t n = h->instruction_count;
+
+    g->calls = calloc(n + 1, sizeof *g->calls);
+    g->batch_calls = calloc(n + 1, sizeof *g->batch_calls);
+    if (!g->calls || !g->batch_calls)
+    {
+        SDL_SetError("out of memory");
+        return 0;
+    }
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        struct aigc_instruction *in = &g->instructions[i];
+        const struct node_kernels *k = aigc_op_kernels(in->op);
+        if (in->op == OP_KERNEL)
+        {
+            struct node_info *info = in->type < (uint32_t)conf->node_count ? &conf->nodes[in->type] : NULL;
+            if (!info || info->op != OP_KERNEL || !info->kernels)
+            {
+                SDL_SetError("instruction %u: node type %u has no native kernels", i, in->type);
+                return 0;
+            }
+            if (in->arg_count != (uint32_t)info->input_count ||
+                (uint32_t)info->prop_count > h->prop_count - in->props ||
+                (info->output_count ? in->dst >= h->register_count || in->dst < h->const_count ||
+                    (uint32_t)info->output_count > h->register_count - in->dst : in->dst != AIGC_NO_REGISTER))
+            {
+                SDL_SetError("instruction %u doesn't match node type '%s'", i, info->name);
+                return 0;
+            }
+            k = info->kernels;
+        }
+        if (!k) continue;
+        g->calls[i] = kernels_scalar(k, in->arg_count);
+        g->batch_calls[i] = kernels_batch(kernels_for_isa(k), in->arg_count);
+        if (!g->calls[i] || !g->batch_calls[i])
+        {
+            SDL_SetError("instruction %u: no kernel takes %u inputs", i, in->arg_count);
+            return 0;
+        }
+    }
+    return compiled_graph_check_segments(g, conf) && compiled_graph_find_uniform(g, conf);
+}
+
+/*
+ * Opens a compiled graph by mapping it. Returns 0 and sets the SDL error if
+ * the file is corrupt or was compiled against another config.
+ */
+static int
+compiled_graph_open(struct compiled_graph *g, const char *path, struct config *conf)
+{
+    struct aigc_header *h;
+
+    memset(g, 0, sizeof *g);
+    if (!file_map_open(&g->map, path)) return 0;
+
+    h = g->map.data;
+    if (g->map.size < sizeof *h || memcmp(h->magic, AIGC_MAGIC, sizeof h->magic))
+    {
+        SDL_SetError("'%s' is not a compiled graph", path);
+        goto error;
+    }
+    if (SDL_SwapLE32(h->version) != AIGC_VERSION)
+    {
+        SDL_SetError("'%s' has unsupported version %u", path, SDL_SwapLE32(h->version));
+        goto error;
+    }
+    if (SDL_SwapLE64(h->config_hash) != config_hash(conf))
+    {
+        SDL_SetError("'%s' was compiled against a different config", path);
+        goto error;
+    }
+
+    aigc_swap(g->map.data, g->map.size);
+    if (!compiled_graph_bind(g, g->map.data, g->map.size) || !compiled_graph_link(g, conf)) goto error;
+    return 1;
+
+error:
+    compiled_graph_free(g);
+    return 0;
+}
+
+/* writes the blob out little-endian; returns 0 and sets the SDL error on failure */
+static int
+compiled_graph_save(struct compiled_graph *g, const char *path)
+{
+    char error[256];
+    size_t size = g->header->size;
+    void *blob = g->header;
+    int ok;
+
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    blob = malloc(size);
+    if (!blob) { SDL_SetError("out of memory"); return 0; }
+    memcpy(blob, g->header, size);
+    aigc_swap(blob, size);
+#endif
+    ok = file_write_durable(path, blob, size, error, sizeof error);
+    if (!ok) SDL_SetError("%s", error);
+    if (blob != (void*)g->header) free(blob);
+    return ok;
+}
+
+/* loads the constant pool into an agent's register file, once per agent */
+static void
+compiled_graph_init_registers(struct compiled_graph *g, float *registers)
+{
+    memcpy(registers, g->consts, g->header->const_count * sizeof *registers);
+}
+
+/* side effect of a play_anim instruction */
+#define AIGC_PLAY_ANIM(value_, agent_) do { \
+        struct aigc_event *e = &events[event_count++]; \
+        e->op = in->op; \
+        e->node = in->node; \
+        e->props = props + in->props; \
+        e->value = (value_); \
+        e->agent = (agent_); \
+    } while (0)
+
+/*
+ * Evaluates the graph for one agent with a switch per instruction, the
+ * portable dispatch; see compiled_graph_run.
+ */
+static int
+compiled_graph_run_switch(struct compiled_graph *g, float *registers, const float *inputs,
+    struct aigc_event *events)
+{
+    struct aigc_instruction *in = g->instructions + g->header->uniform_count;
+    struct aigc_instruction *end = g->instructions + g->header->instruction_count;
+    const uint32_t *operands = g->operands;
+    const int32_t *props = g->props;
+    float *r = registers;
+    int event_count = 0;
+
+    for (; in < end; ++in)
+    {
+        const uint32_t *a = operands + in->args;
+        switch (in->op)
+        {
+            case OP_INPUT:
+                r[in->dst] = inputs[props[in->props]];
+                break;
+            case OP_SUM:
+                r[in->dst] = r[a[0]] + r[a[1]];
+                break;
+            case OP_SUM3:
+                r[in->dst] = r[a[0]] + r[a[1]] + r[a[2]];
+                break;
+            case OP_NEGATE:
+                r[in->dst] = -r[a[0]];
+                break;
+            case OP_PLAY_ANIM:
+                if (r[a[0]] > 0) AIGC_PLAY_ANIM(r[a[0]], 0);
+                break;
+            case OP_KERNEL:
+            case AIGC_OP_SUM_CHAIN:
+                g->calls[in - g->instructions](r, a, in->arg_count, in->dst, props + in->props);
+                break;
+            case AIGC_OP_SUB:
+                r[in->dst] = r[a[0]] - r[a[1]];
+                break;
+            case AIGC_OP_ADD_INPUT:
+                r[in->dst] = r[a[0]] + inputs[props[in->props]];
+                break;
+        }
+    }
+    return event_count;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define AIGC_THREADED 1
+
+/*
+ * The same with computed goto: every handler jumps straight to the next
+ * one through a table of label addresses, so there's no bounds check and
+ * each op has its own indirect branch for the predictor to learn.
+ */
+static int
+compiled_graph_run_threaded(struct compiled_graph *g, float *registers, const float *inputs,
+    struct aigc_event *events)
+{
+    static void *const dispatch[AIGC_OP_COUNT] =
+    {
+        [OP_NONE] = &&op_none,
+        [OP_INPUT] = &&op_input,
+        [OP_SUM] = &&op_sum,
+        [OP_SUM3] = &&op_sum3,
+        [OP_NEGATE] = &&op_negate,
+        [OP_PLAY_ANIM] = &&op_play_anim,
+        [OP_KERNEL] = &&op_call,
+        [OP_GLOBAL] = &&op_none,
+        [AIGC_OP_SUB] = &&op_sub,
+        [AIGC_OP_SUM_CHAIN] = &&op_call,
+        [AIGC_OP_ADD_INPUT] = &&op_add_input,
+    };
+    struct aigc_instruction *in = g->instructions + g->header->uniform_count;
+    struct aigc_instruction *end = g->instructions + g->header->instruction_count;
+    const uint32_t *operands = g->operands, *a;
+    const int32_t *props = g->props;
+    float *r = registers;
+    int event_count = 0;
+
+#define DISPATCH do { if (in == end) return event_count; a = operands + in->args; goto *dispatch[in->op]; } while (0)
+#define NEXT do { ++in; DISPATCH; } while (0)
+    DISPATCH;
+op_input:
+    r[in->dst] = inputs[props[in->props]];
+    NEXT;
+op_sum:
+    r[in->dst] = r[a[0]] + r[a[1]];
+    NEXT;
+op_sum3:
+    r[in->dst] = r[a[0]] + r[a[1]] + r[a[2]];
+    NEXT;
+op_negate:
+    r[in->dst] = -r[a[0]];
+    NEXT;
+op_play_anim:
+    if (r[a[0]] > 0) AIGC_PLAY_ANIM(r[a[0]], 0);
+    NEXT;
+op_call:
+    g->calls[in - g->instructions](r, a, in->arg_count, in->dst, props + in->props);
+    NEXT;
+op_sub:
+    r[in->dst] = r[a[0]] - r[a[1]];
+    NEXT;
+op_add_input:
+    r[in->dst] = r[a[0]] + inputs[props[in->props]];
+    NEXT;
+op_none:
+    NEXT;
+#undef DISPATCH
+#undef NEXT
+}
+#endif
+
+/*
+ * Evaluates the graph for one agent. `registers` holds register_count floats
+ * set up by compiled_graph_init_registers and compiled_graph_run_uniform,
+ * `inputs` the agent's input_count input slots and `events` room for
+ * event_count events. Returns the number of events emitted. Dispatch is
+ * threaded where the compiler has computed goto and a switch elsewhere.
+ */
+static int
+compiled_graph_run(struct compiled_graph *g, float *registers, const float *inputs,
+    struct aigc_event *events)
+{
+#ifdef AIGC_THREADED
+    return compiled_graph_run_threaded(g, registers, inputs, events);
+#else
+    return compiled_graph_run_switch(g, registers, inputs, events);
+#endif
+}
+
+/*
+ * Runs the uniform prologue, the part of the program that is the same for
+ * every agent, on `registers` set up by compiled_graph_init_registers, with
+ * `globals` holding the global_count global slots. Once per tick is enough:
+ * the rest of the program never overwrites the prologue's results, so
+ * compiled_graph_run can then evaluate any number of agents on the same
+ * registers, and compiled_graph_init_batch broadcasts them to batches.
+ */
+static void
+compiled_graph_run_uniform(struct compiled_graph *g, float *registers, const float *globals)
+{
+    const uint32_t *operands = g->operands;
+    const int32_t *props = g->props;
+    float *r = registers;
+
+    for (uint32_t k = 0; k < g->header->uniform_count; ++k)
+    {
+        struct aigc_instruction *in = &g->instructions[k];
+        const uint32_t *a = operands + in->args;
+        if (in->op == OP_GLOBAL) r[in->dst] = globals[props[in->props]];
+        else g->calls[k](r, a, in->arg_count, in->dst, props + in->props);
+    }
+}
+
+/*
+ * Loads the constant pool and the results of the uniform prologue into the
+ * rows of a batch's SoA register file. `uniform` is the register file
+ * compiled_graph_run_uniform ran on this tick, NULL if there's no prologue.
+ */
+static void
+compiled_graph_init_batch(struct compiled_graph *g, float *registers, size_t stride, size_t count,
+    const float *uniform)
+{
+    for (uint32_t k = 0; k < g->header->const_count; ++k)
+        for (size_t i = 0; i < count; ++i) registers[k * stride + i] = g->consts[k];
+    for (uint32_t k = 0; uniform && k < g->uniform_register_count; ++k)
+    {
+        uint32_t row = g->uniform_registers[k];
+        for (size_t i = 0; i < count; ++i) registers[row * stride + i] = uniform[row];
+    }
+}
+
+/*
+ * Evaluates the graph for `count` agents at once, an instruction at a time
+ * over all of them, after the uniform prologue. `registers` holds
+ * register_count rows of `stride` floats set up by compiled_graph_init_batch,
+ * `inputs` input_count rows of `stride` floats and `events` room for
+ * event_count * count events, which come grouped by instruction rather than
+ * by agent. The register file is walked once per instruction, so batches are
+ * best kept small enough for it to stay in cache, a few dozen to a few
+ * hundred agents. Returns the number of events emitted.
+ */
+static int
+compiled_graph_run_batch(struct compiled_graph *g, float *registers, size_t stride, size_t count,
+    const float *inputs, struct aigc_event *events)
+{
+    const uint32_t *operands = g->operands;
+    const int32_t *props = g->props;
+    int event_count = 0;
+
+    for (uint32_t k = g->header->uniform_count; k < g->header->instruction_count; ++k)
+    {
+        struct aigc_instruction *in = &g->instructions[k];
+        const uint32_t *a = operands + in->args;
+        switch (in->op)
+        {
+            case OP_INPUT:
+                memcpy(registers + in->dst * stride, inputs + props[in->props] * stride, count * sizeof *registers);
+                break;
+            case OP_PLAY_ANIM:
+            {
+                const float *row = registers + a[0] * stride;
+                for (size_t i = 0; i < count; ++i)
+                    if (row[i] > 0) AIGC_PLAY_ANIM(row[i], (uint32_t)i);
+                break;
+            }
+            case AIGC_OP_ADD_INPUT:
+            {
+                float *out = registers + in->dst * stride;
+                const float *x = registers + a[0] * stride, *y = inputs + props[in->props] * stride;
+                for (size_t i = 0; i < count; ++i) out[i] = x[i] + y[i];
+                break;
+            }
+            default:
+                g->batch_calls[k](registers, stride, count, a, in->arg_count, in->dst, props + in->props);
+                break;
+        }
+    }
+    return event_count;
+}
+
+/*
+ * Kahn's topological sort of a validated view into `order`, linear in nodes
+ * and links. Returns 0 and sets the SDL error if the graph has a cycle.
+ */
+static int
+graph_view_sort(struct graph_view *view, int *order)
+{
+    int n = view->node_count;
+    int *indegree = calloc(n + 1, sizeof *indegree);
+    int *out_start = calloc(n + 2, sizeof *out_start);
+    int *out_links = malloc((view->link_count + 1) * sizeof *out_links);
+    int head = 0, tail = 0;
+
+    if (!indegree || !out_start || !out_links)
+    {
+        free(indegree);
+        free(out_start);
+        free(out_links);
+        SDL_SetError("out of memory");
+        return 0;
+    }
+
+    /* outbound links in CSR form, out_start[i + 1] is used as a fill cursor */
+    for (int i = 0; i < view->link_count; ++i)
+    {
+        out_start[view->links[i].in_id + 2]++;
+        indegree[view->links[i].out_id]++;
+    }
+    for (int i = 2; i <= n + 1; ++i) out_start[i] += out_start[i - 1];
+    for (int i = 0; i < view->link_count; ++i) out_links[out_start[view->links[i].in_id + 1]++] = i;
+
+    for (int i = 0; i < n; ++i) if (!indegree[i]) order[tail++] = i;
+    while (head < tail)
+    {
+        int node = order[head++];
+        for (int k = out_start[node]; k < out_start[node + 1]; ++k)
+        {
+            int next = view->links[out_links[k]].out_id;
+            if (!--indegree[next]) order[tail++] = next;
+        }
+    }
+
+    free(indegree);
+    free(out_start);
+    free(out_links);
+    if (tail != n) { SDL_SetError("graph has a cycle"); return 0; }
+    return 1;
+}
+
+static inline uint64_t
+hash_mix(uint64_t h, uint64_t v)
+{
+    h = (h ^ v) * 0x9e3779b97f4a7c15ull;
+    return h ^ (h >> 29);
+}
+
+/* splitmix64 finalizer, spreads the last few mixed words over all bits */
+static inline uint64_t
+hash_final(uint64_t h)
+{
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+/*
+ * Merkle hashes of a validated view. A node's hash covers its type, its
+ * properties and, for every input, either the constant or the hash and slot
+ * of the node feeding it, so equal hashes mean equal subgraphs wherever and
+ * under whatever ids they appear. Positions don't count.
+ *
+ * The graph hash rolls the config hash and the node hashes up in id order.
+ * Graphs with equal hashes compile to the same program, so it names cached
+ * compiles and makes graph equality one comparison.
+ *
+ * `order` is a topological order from graph_view_sort or NULL, `node_hashes`
+ * receives node_count hashes or is NULL. Returns 0 and sets the SDL error
+ * if the graph has a cycle.
+ */
+static int
+graph_view_hash(struct graph_view *view, struct config *conf, const int *order,
+    uint64_t *node_hashes, uint64_t *graph_hash)
+{
+    int n = view->node_count, ok = 0;
+    int *sorted = NULL, *input_base = NULL, *prop_base = NULL;
+    uint64_t *hashes = node_hashes, *input_words = NULL, *prop_words = NULL, h;
+
+    input_base = malloc((n + 1) * sizeof *input_base);
+    prop_base = malloc((n + 1) * sizeof *prop_base);
+    if (!hashes) hashes = malloc((n + 1) * sizeof *hashes);
+    if (!order) order = sorted = malloc((n + 1) * sizeof *sorted);
+    if (!input_base || !prop_base || !hashes || !order) goto oom;
+
+    input_base[0] = prop_base[0] = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        struct node_info *info = &conf->nodes[view->nodes[i].type];
+        input_base[i + 1] = input_base[i] + info->input_count;
+        prop_base[i + 1] = prop_base[i] + info->prop_count;
+    }
+
+    /* every input starts out as the constant 0, links overwrite it */
+    input_words = calloc(input_base[n] + 1, sizeof *input_words);
+    prop_words = calloc(prop_base[n] + 1, sizeof *prop_words);
+    if (!input_words || !prop_words) goto oom;
+    for (int i = 0; i < view->const_count; ++i)
+    {
+        uint32_t bits;
+        memcpy(&bits, &view->consts[i].value, sizeof bits);
+        input_words[input_base[view->consts[i].node_id] + view->consts[i].slot] = bits;
+    }
+    for (int i = 0; i < view->prop_count; ++i)
+        prop_words[prop_base[view->props[i].node_id] + view->props[i].slot] = (uint32_t)view->props[i].value;
+
+    if (sorted && !graph_view_sort(view, sorted)) goto cleanup;
+
+    {int *link_of_input = malloc((input_base[n] + 1) * sizeof *link_of_input);
+    if (!link_of_input) goto oom;
+    memset(link_of_input, 0xff, (input_base[n] + 1) * sizeof *link_of_input);
+    for (int i = 0; i < view->link_count; ++i)
+        link_of_input[input_base[view->links[i].out_id] + view->links[i].out_slot] = i;
+
+    for (int k = 0; k < n; ++k)
+    {
+        int i = order[k];
+        h = hash_mix(FNV1A_INIT, (uint64_t)view->nodes[i].type);
+        for (int j = input_base[i]; j < input_base[i + 1]; ++j)
+        {
+            int link = link_of_input[j];
+            if (link < 0)
+                h = hash_mix(h, input_words[j]);
+            else
+                h = hash_mix(hash_mix(h, hashes[view->links[link].in_id]),
+                    (uint64_t)1 << 32 | (uint32_t)view->links[link].in_slot);
+        }
+        for (int j = prop_base[i]; j < prop_base[i + 1]; ++j) h = hash_mix(h, prop_words[j]);
+        hashes[i] = hash_final(h);
+    }
+    free(link_of_input);}
+
+    h = hash_mix(config_hash(conf), (uint64_t)n);
+    for (int i = 0; i < n; ++i) h = hash_mix(h, hashes[i]);
+    *graph_hash = hash_final(h);
+    ok = 1;
+    goto cleanup;
+
+oom:
+    SDL_SetError("out of memory");
+cleanup:
+    free(sorted);
+    free(input_base);
+    free(prop_base);
+    free(input_words);
+    free(prop_words);
+    if (hashes != node_hashes) free(hashes);
+    return ok;
+}
+
+/* open addressing set of constant values, keyed by bit pattern */
+struct const_pool
+{
+    uint32_t *keys;
+    uint32_t *registers;
+    uint32_t mask;
+    float *values;
+    uint32_t count;
+};
+
+static int
+const_pool_init(struct const_pool *pool, uint32_t max_count)
+{
+    uint32_t capacity = 16;
+    while (capacity < max_count * 2) capacity *= 2;
+    pool->mask = capacity - 1;
+    pool->count = 0;
+    pool->keys = malloc(capacity * sizeof *pool->keys);
+    pool->registers = malloc(capacity * sizeof *pool->registers);
+    pool->values = malloc((max_count ? max_count : 1) * sizeof *pool->values);
+    if (pool->registers) memset(pool->registers, 0xff, capacity * sizeof *pool->registers);
+    return pool->keys && pool->registers && pool->values;
+}
+
+static void
+const_pool_free(struct const_pool *pool)
+{
+    free(pool->keys);
+    free(pool->registers);
+    free(pool->values);
+}
+
+/* register holding `value`, equal bit patterns share one */
+static uint32_t
+const_pool_add(struct const_pool *pool, float value)
+{
+    uint32_t key, h;
+    memcpy(&key, &value, sizeof key);
+    h = (key * 2654435761u) & pool->mask;
+    while (pool->registers[h] != AIGC_NO_REGISTER)
+    {
+        if (pool->keys[h] == key) return pool->registers[h];
+        h = (h + 1) & pool->mask;
+    }
+    pool->keys[h] = key;
+    pool->registers[h] = pool->count;
+    pool->values[pool->count] = value;
+    return pool->count++;
+}
+
+/* flags of compile_graph_view_flags */
+#define COMPILE_NO_FUSION 1     /* one instruction per live node, e.g. to measure what fusion gains */
+#define COMPILE_NO_LEVELS 2     /* topological order in one sequential segment, see graph_compile_schedule */
+#define COMPILE_NO_UNIFORM 4    /* hoist nothing but global reads into the uniform prologue */
+
+/* per-node state of the optimization passes */
+#define NODE_FOLDED 1   /* evaluated at compile time, consumers read its outputs as constants */
+#define NODE_LIVE 2     /* feeds a side effect, gets an instruction */
+#define NODE_MERGED 4   /* duplicate of an earlier node, consumers read that one */
+#define NODE_FUSED 8    /* runs inside its only consumer's superinstruction */
+
+/* working state of one compile, indexed by node or by input, output or property slot */
+struct graph_compile
+{
+    struct graph_view *view;
+    struct config *conf;
+    int n;
+    int *order;
+    int *input_base, *output_base;  /* n + 1 entries */
+    int32_t *prop_base;
+    int32_t *prop_values;
+    int *link_of;           /* per input slot, the link feeding it or -1 */
+    int *canon;             /* per node, the node that computes it: itself unless merged */
+    float *input_values;    /* per input slot, the constant of an unlinked one */
+    float *output_values;   /* per output of a folded node, its value */
+    unsigned char *state;
+    float *scratch;         /* register file for folding one node */
+    uint32_t *scratch_args;
+    uint32_t *op;           /* per node, the op of its instruction */
+    int *arg_base, *arg_count;  /* per node, the input slots its instruction reads, a run of `args` */
+    int *args;
+    int arg_total;
+    int *prop_node;         /* per node, the node whose properties its instruction takes */
+    int *emit;              /* nodes with an instruction, in program order */
+    int emit_count;
+    int *group;             /* per node, its register allocation group, see graph_compile_allocate */
+    unsigned char *uniform; /* per node, whether it computes the same for every agent */
+    int uniform_count;      /* of `emit`, the first ones form the uniform prologue */
+    struct aigc_segment *segments;
+    int segment_count;
+    uint32_t parallel_count;
+    int folded, merged, dead, fused;
+};
+
+/*
+ * Input slots are numbered per node input, then one extra slot per node
+ * holds a constant the fusion pass computed for it, unlinked like any
+ * other constant input.
+ */
+#define GRAPH_COMPILE_EXTRA_SLOT(c, i) ((c)->input_base[(c)->n] + (i))
+
+/* node `i` gets an instruction of its own */
+static int
+graph_compile_emitted(struct graph_compile *c, int i)
+{
+    return (c->state[i] & (NODE_LIVE | NODE_FUSED)) == NODE_LIVE;
+}
+
+/* whether input slot `j` carries a compile-time constant, and which */
+static int
+graph_compile_const_input(struct graph_compile *c, int j, float *value)
+{
+    int link = c->link_of[j];
+    struct aig_link *l;
+
+    if (link < 0)
+    {
+        *value = c->input_values[j];
+        return 1;
+    }
+    l = &c->view->links[link];
+    if (!(c->state[l->in_id] & NODE_FOLDED)) return 0;
+    *value = c->output_values[c->output_base[l->in_id] + l->in_slot];
+    return 1;
+}
+
+/* what feeds input slot `j`: -1 and its constant, or the node computing it and the output slot */
+static int
+graph_compile_source(struct graph_compile *c, int j, int *slot, float *value)
+{
+    struct aig_link *l;
+    if (graph_compile_const_input(c, j, value)) return -1;
+    l = &c->view->links[c->link_of[j]];
+    *slot = l->in_slot;
+    return c->canon[l->in_id];
+}
+
+/* node `i` without side effects, so running it once for every use is the same as sharing it */
+static int
+graph_compile_pure(struct graph_compile *c, int i)
+{
+    struct node_info *info = &c->conf->nodes[c->view->nodes[i].type];
+    const struct node_kernels *kernels = info->op == OP_KERNEL ? info->kernels : builtin_kernels(info->op);
+    if (aigc_ops[info->op].side_effect) return 0;
+    return info->op == OP_INPUT || info->op == OP_GLOBAL || (kernels && (kernels->flags & KERNEL_PURE));
+}
+
+/*
+ * Constant folding: in topological order, a node with a KERNEL_PURE kernel
+ * whose inputs are all constants is run once here, through the same kernel
+ * the program would call, and its outputs become constants of its
+ * consumers. Chains fold in one pass because sources come first.
+ */
+static void
+graph_compile_fold(struct graph_compile *c)
+{
+    for (int k = 0; k < c->n; ++k)
+    {
+        int i = c->order[k], j, inputs = c->input_base[i + 1] - c->input_base[i];
+        struct node_info *info = &c->conf->nodes[c->view->nodes[i].type];
+        const struct node_kernels *kernels = info->op == OP_KERNEL ? info->kernels : builtin_kernels(info->op);
+
+        /* a kernel without inputs is never folded, it's there for what it does at run time */
+        if (!kernels || !(kernels->flags & KERNEL_PURE) || !inputs) continue;
+        for (j = 0; j < inputs && graph_compile_const_input(c, c->input_base[i] + j, &c->scratch[j]); ++j);
+        if (j < inputs) continue;
+
+        kernels_scalar(kernels, inputs)(c->scratch, c->scratch_args, inputs, inputs, c->prop_values + c->prop_base[i]);
+        memcpy(c->output_values + c->output_base[i], c->scratch + inputs, info->output_count * sizeof *c->scratch);
+        c->state[i] |= NODE_FOLDED;
+        ++c->folded;
+    }
+}
+
+/* hash of what node `i` computes, equal for nodes graph_compile_same_node accepts */
+static uint64_t
+graph_compile_node_key(struct graph_compile *c, int i)
+{
+    uint64_t h = hash_mix(FNV1A_INIT, (uint64_t)c->view->nodes[i].type);
+    for (int j = c->input_base[i]; j < c->input_base[i + 1]; ++j)
+    {
+        int slot = 0;
+        float value = 0;
+        int source = graph_compile_source(c, j, &slot, &value);
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof bits);
+        h = hash_mix(h, source < 0 ? bits : (uint64_t)(source + 1) << 32 | (uint32_t)slot);
+    }
+    for (int j = c->prop_base[i]; j < c->prop_base[i + 1]; ++j) h = hash_mix(h, (uint32_t)c->prop_values[j]);
+    return hash_final(h);
+}
+
+static int
+graph_compile_same_node(struct graph_compile *c, int a, int b)
+{
+    if (c->view->nodes[a].type != c->view->nodes[b].type) return 0;
+    for (int j = 0; j < c->input_base[a + 1] - c->input_base[a]; ++j)
+    {
+        int slot_a = 0, slot_b = 0;
+        float value_a = 0, value_b = 0;
+        if (graph_compile_source(c, c->input_base[a] + j, &slot_a, &value_a) !=
+            graph_compile_source(c, c->input_base[b] + j, &slot_b, &value_b) ||
+            slot_a != slot_b || memcmp(&value_a, &value_b, sizeof value_a))
+            return 0;
+    }
+    return !memcmp(c->prop_values + c->prop_base[a], c->prop_values + c->prop_base[b],
+        (c->prop_base[a + 1] - c->prop_base[a]) * sizeof *c->prop_values);
+}
+
+/*
+ * Common subexpression elimination by hash-consing: in topological order
+ * each pure node is keyed on its type, properties and inputs, every input
+ * being a constant (by bit pattern) or the node computing its source, and a
+ * node whose key was seen before is merged into the first one, whose
+ * registers its consumers then read. Going bottom-up merges duplicate
+ * chains as a whole. Returns 0 when out of memory.
+ */
+static int
+graph_compile_merge(struct graph_compile *c)
+{
+    uint32_t capacity = 16, mask;
+    int *table;
+    uint64_t *keys;
+
+    while (capacity < (uint32_t)c->n * 2) capacity *= 2;
+    mask = capacity - 1;
+    table = malloc(capacity * sizeof *table);
+    keys = malloc((c->n + 1) * sizeof *keys);
+    if (!table || !keys)
+    {
+        free(table);
+        free(keys);
+        return 0;
+    }
+    memset(table, 0xff, capacity * sizeof *table);
+
+    for (int k = 0; k < c->n; ++k)
+    {
+        int i = c->order[k];
+        uint32_t h;
+        if ((c->state[i] & NODE_FOLDED) || !graph_compile_pure(c, i)) continue;
+        keys[i] = graph_compile_node_key(c, i);
+        for (h = (uint32_t)keys[i] & mask; table[h] >= 0; h = (h + 1) & mask)
+        {
+            if (keys[table[h]] == keys[i] && graph_compile_same_node(c, table[h], i))
+            {
+                c->canon[i] = table[h];
+                c->state[i] |= NODE_MERGED;
+                ++c->merged;
+                break;
+            }
+        }
+        if (table[h] < 0) table[h] = i;
+    }
+    free(table);
+    free(keys);
+    return 1;
+}
+
+/*
+ * Dead node elimination: only side effects are observable, so in reverse
+ * topological order a node is live if it has one or feeds a live node
+ * through a link that folding didn't turn into a constant.
+ */
+static void
+graph_compile_mark_live(struct graph_compile *c)
+{
+    for (int k = c->n - 1; k >= 0; --k)
+    {
+        int i = c->order[k];
+        struct node_info *info = &c->conf->nodes[c->view->nodes[i].type];
+
+        if (aigc_ops[info->op].side_effect) c->state[i] |= NODE_LIVE;
+        if (!(c->state[i] & NODE_LIVE)) continue;
+        for (int j = c->input_base[i]; j < c->input_base[i + 1]; ++j)
+        {
+            int slot;
+            float value;
+            int source = graph_compile_source(c, j, &slot, &value);
+            if (source >= 0) c->state[source] |= NODE_LIVE;
+        }
+    }
+    for (int i = 0; i < c->n; ++i)
+        if (!(c->state[i] & (NODE_LIVE | NODE_FOLDED | NODE_MERGED))) ++c->dead;
+}
+
+/*
+ * Uniformity: in topological order, a live node computes the same for
+ * every agent if it reads a global, or has a pure kernel and only uniform
+ * or constant inputs. Anything downstream of an agent input is per agent.
+ * With COMPILE_NO_UNIFORM only the global reads are, which the prologue
+ * must do.
+ */
+static void
+graph_compile_classify(struct graph_compile *c, int flags)
+{
+    for (int k = 0; k < c->n; ++k)
+    {
+        int i = c->order[k];
+        struct node_info *info = &c->conf->nodes[c->view->nodes[i].type];
+
+        c->uniform[i] = 0;
+        if (!(c->state[i] & NODE_LIVE)) continue;
+        if (info->op == OP_GLOBAL)
+        {
+            c->uniform[i] = 1;
+            continue;
+        }
+        if ((flags & COMPILE_NO_UNIFORM) || info->op == OP_INPUT || !graph_compile_pure(c, i)) continue;
+        c->uniform[i] = 1;
+        for (int j = c->input_base[i]; j < c->input_base[i + 1] && c->uniform[i]; ++j)
+        {
+            int slot;
+            float value;
+            int source = graph_compile_source(c, j, &slot, &value);
+            if (source >= 0 && !c->uniform[source]) c->uniform[i] = 0;
+        }
+    }
+}
+
+/*
+ * Superinstruction fusion, over the live nodes in topological order:
+ *  - a sum3 whose first two inputs are constants adds them here, as the
+ *    program would, and becomes a sum of that and its third input;
+ *  - a sum whose first input is the only use of another sum becomes a
+ *    sum_chain over both operand lists, or a sum3 if that's 3 operands;
+ *    sums add left to right, so the chain computes the same floats;
+ *  - a two-input sum of the only use of a negate becomes a sub;
+ *  - a two-input sum of the only use of an agent input becomes add_input.
+ * The producer then runs inside its consumer's instruction and is marked
+ * NODE_FUSED. Producers are only fused into consumers as uniform as they
+ * are, so nothing moves out of the uniform prologue. Returns 0 when out of
+ * memory.
+ */
+static int
+graph_compile_fuse(struct graph_compile *c)
+{
+    int *uses = calloc(c->output_base[c->n] + 1, sizeof *uses);
+    if (!uses) return 0;
+
+    for (int i = 0; i < c->n; ++i)
+    {
+        if (!(c->state[i] & NODE_LIVE)) continue;
+        for (int j = c->input_base[i]; j < c->input_base[i + 1]; ++j)
+        {
+            int slot;
+            float value;
+            int source = graph_compile_source(c, j, &slot, &value);
+            if (source >= 0) ++uses[c->output_base[source] + slot];
+        }
+    }
+
+    for (int k = 0; k < c->n; ++k)
+    {
+        int i = c->order[k], slot, source, *a = c->args + c->arg_base[i];
+        float x, y;
+
+        if (!(c->state[i] & NODE_LIVE) || (c->op[i] != OP_SUM && c->op[i] != OP_SUM3)) continue;
+
+        if (c->op[i] == OP_SUM3 && graph_compile_const_input(c, a[0], &x) && graph_compile_const_input(c, a[1], &y))
+        {
+            c->input_values[GRAPH_COMPILE_EXTRA_SLOT(c, i)] = x + y;
+            a[0] = GRAPH_COMPILE_EXTRA_SLOT(c, i);
+            a[1] = a[2];
+            c->arg_count[i] = 2;
+            c->op[i] = OP_SUM;
+        }
+
+        source = graph_compile_source(c, a[0], &slot, &x);
+        if (source >= 0 && uses[c->output_base[source]] == 1 && c->uniform[source] == c->uniform[i] &&
+            (c->op[source] == OP_SUM || c->op[source] == OP_SUM3 || c->op[source] == AIGC_OP_SUM_CHAIN) &&
+            c->arg_count[source] + c->arg_count[i] - 1 <= AIGC_CHAIN_MAX)
+        {
+            int *chain = c->args + c->arg_total;
+            memcpy(chain, c->args + c->arg_base[source], c->arg_count[source] * sizeof *chain);
+            memcpy(chain + c->arg_count[source], a + 1, (c->arg_count[i] - 1) * sizeof *chain);
+            c->arg_base[i] = c->arg_total;
+            c->arg_count[i] += c->arg_count[source] - 1;
+            c->arg_total += c->arg_count[i];
+            c->op[i] = c->arg_count[i] == 3 ? OP_SUM3 : AIGC_OP_SUM_CHAIN;
+            c->state[source] |= NODE_FUSED;
+            ++c->fused;
+            continue;
+        }
+
+        for (int side = 0; side < 2 && c->op[i] == OP_SUM; ++side)
+        {
+            source = graph_compile_source(c, a[side], &slot, &x);
+            if (source < 0 || uses[c->output_base[source]] != 1 || c->uniform[source] != c->uniform[i] ||
+                (c->op[source] != OP_NEGATE && c->op[source] != OP_INPUT))
+                continue;
+            a[0] = a[1 - side];
+            if (c->op[source] == OP_NEGATE)
+            {
+                a[1] = c->args[c->arg_base[source]];
+                c->op[i] = AIGC_OP_SUB;
+            }
+            else
+            {
+                c->arg_count[i] = 1;
+                c->prop_node[i] = source;
+                c->op[i] = AIGC_OP_ADD_INPUT;
+            }
+            c->state[source] |= NODE_FUSED;
+            ++c->fused;
+        }
+    }
+    free(uses);
+    return 1;
+}
+
+#define AIGC_PARALLEL_MIN 4096      /* instructions a program needs to be split into levels */
+#define AIGC_LEVEL_MIN_WIDTH 256    /* instructions a level needs to be worth a parallel segment */
+
+/*
+ * Wavefront scheduling of the emitted nodes into c->emit, after the
+ * uniform prologue, which comes first in topological order as a sequential
+ * segment of its own. An instruction's level is one past the highest level
+ * of the per-agent instructions it reads, so a level's instructions are
+ * independent. A program of at least AIGC_PARALLEL_MIN per-agent
+ * instructions, most of them in levels of at least AIGC_LEVEL_MIN_WIDTH,
+ * is ordered by level: every such wide level becomes a parallel segment
+ * and runs of narrow ones sequential segments. Any other program, or all
+ * of them with COMPILE_NO_LEVELS, keeps topological order in one
+ * sequential segment, the better order for one thread as values die
+ * sooner. Also numbers the register allocation groups. Returns 0 when out
+ * of memory.
+ */
+static int
+graph_compile_schedule(struct graph_compile *c, int flags)
+{
+    int *level = malloc((c->n + 1) * sizeof *level);
+    int *first = NULL, levels = 0, wide = 0, group = 0, agent_count;
+
+    if (!level) return 0;
+    c->emit_count = 0;
+    for (int k = 0; k < c->n; ++k)
+    {
+        int i = c->order[k];
+        if (graph_compile_emitted(c, i) && c->uniform[i]) c->emit[c->emit_count++] = i;
+    }
+    c->uniform_count = c->emit_count;
+    for (int k = 0; k < c->n; ++k)
+    {
+        int i = c->order[k];
+        if (!graph_compile_emitted(c, i) || c->uniform[i]) continue;
+        c->emit[c->emit_count++] = i;
+        level[i] = 0;
+        for (int j = c->arg_base[i]; j < c->arg_base[i] + c->arg_count[i]; ++j)
+        {
+            int slot;
+            float value;
+            int source = graph_compile_source(c, c->args[j], &slot, &value);
+            if (source >= 0 && !c->uniform[source] && level[source] >= level[i]) level[i] = level[source] + 1;
+        }
+        if (level[i] >= levels) levels = level[i] + 1;
+    }
+    agent_count = c->emit_count - c->uniform_count;
+
+    /* per-agent instructions per level, then where each level starts */
+    first = calloc(levels + 2, sizeof *first);
+    if (!first)
+    {
+        free(level);
+        return 0;
+    }
+    for (int e = c->uniform_count; e < c->emit_count; ++e) ++first[level[c->emit[e]] + 1];
+    first[0] = c->uniform_count;
+    for (int l = 0; l < levels; ++l)
+    {
+        if (first[l + 1] >= AIGC_LEVEL_MIN_WIDTH) wide += first[l + 1];
+        first[l + 1] += first[l];
+    }
+
+    c->segment_count = 0;
+    c->parallel_count = 0;
+    for (int e = 0; e < c->uniform_count; ++e) c->group[c->emit[e]] = group++;
+    if (c->uniform_count) c->segments[c->segment_count++] = (struct aigc_segment){ 0, c->uniform_count, 0 };
+    if ((flags & COMPILE_NO_LEVELS) || agent_count < AIGC_PARALLEL_MIN || wide * 2 < agent_count)
+    {
+        for (int e = c->uniform_count; e < c->emit_count; ++e) c->group[c->emit[e]] = group++;
+        if (agent_count) c->segments[c->segment_count++] = (struct aigc_segment){ c->uniform_count, agent_count, 0 };
+        free(level);
+        free(first);
+        return 1;
+    }
+
+    /* counting sort, stable so each level stays in topological order */
+    for (int k = 0; k < c->n; ++k)
+    {
+        int i = c->order[k];
+        if (graph_compile_emitted(c, i) && !c->uniform[i]) c->emit[first[level[i]]++] = i;
+    }
+    for (int l = 0, e = c->uniform_count; l < levels; ++l)
+    {
+        int width = first[l] - e;
+        struct aigc_segment *last = c->segment_count ? &c->segments[c->segment_count - 1] : NULL;
+        if (width >= AIGC_LEVEL_MIN_WIDTH)
+        {
+            c->segments[c->segment_count++] = (struct aigc_segment){ e, width, 1 };
+            c->parallel_count += width;
+            for (int k = e; k < e + width; ++k) c->group[c->emit[k]] = group;
+            ++group;
+        }
+        else
+        {
+            if (last && !last->parallel && last->first >= (uint32_t)c->uniform_count) last->count += width;
+            else c->segments[c->segment_count++] = (struct aigc_segment){ e, width, 0 };
+            for (int k = e; k < e + width; ++k) c->group[c->emit[k]] = group++;
+        }
+        e += width;
+    }
+    free(level);
+    free(first);
+    return 1;
+}
+
+/* registers holding live values while instructions are assigned them in order */
+struct register_alloc
+{
+    unsigned char *busy;    /* zero past `peak`, so a search always ends */
+    uint32_t lowest;        /* no free register below it */
+    uint32_t peak;          /* registers needed so far */
+};
+
+/* the lowest run of `count` free registers, outputs of one node must be adjacent */
+static uint32_t
+register_alloc_take(struct register_alloc *ra, uint32_t count)
+{
+    uint32_t start = ra->lowest;
+    for (uint32_t r = start; r - start < count; ++r)
+        if (ra->busy[r]) start = r + 1;
+    memset(ra->busy + start, 1, count);
+    while (ra->busy[ra->lowest]) ++ra->lowest;
+    if (start + count > ra->peak) ra->peak = start + count;
+    return start;
+}
+
+static void
+register_alloc_give(struct register_alloc *ra, uint32_t r)
+{
+    ra->busy[r] = 0;
+    if (r < ra->lowest) ra->lowest = r;
+}
+
+/*
+ * Register assignment by liveness over the program order. A value is live
+ * from the instruction computing it to the last one reading it. Its
+ * register is handed out again once that reader's group has been given its
+ * own, so no instruction writes a register any instruction of its group
+ * reads and kernels don't have to care about aliasing. Groups are single
+ * instructions, or whole levels of parallel segments, whose instructions
+ * then never share a register. Outputs nobody reads are freed at the end of
+ * their group, and uniform values read after the prologue never are, so
+ * every agent finds them where the prologue left them. Fills `reg` with the
+ * first output register of every emitted node and returns the peak
+ * register count, 0 when out of memory.
+ */
+static uint32_t
+graph_compile_allocate(struct graph_compile *c, uint32_t *reg, uint32_t const_count)
+{
+    struct register_alloc ra;
+    int *last_use = malloc((c->output_base[c->n] + 1) * sizeof *last_use);
+
+    ra.busy = calloc(const_count + c->output_base[c->n] + 1, 1);
+    if (!last_use || !ra.busy)
+    {
+        free(last_use);
+        free(ra.busy);
+        return 0;
+    }
+    memset(ra.busy, 1, const_count);
+    ra.lowest = ra.peak = const_count;
+
+    for (int e = 0; e < c->emit_count; ++e)
+    {
+        int i = c->emit[e];
+        for (int o = c->output_base[i]; o < c->output_base[i + 1]; ++o) last_use[o] = c->group[i];
+        for (int j = c->arg_base[i]; j < c->arg_base[i] + c->arg_count[i]; ++j)
+        {
+            int slot;
+            float value;
+            int source = graph_compile_source(c, c->args[j], &slot, &value);
+            if (source < 0 || last_use[c->output_base[source] + slot] < 0) continue;
+            /* -1 for never, groups count from 0 */
+            last_use[c->output_base[source] + slot] = c->uniform[source] && !c->uniform[i] ? -1 : c->group[i];
+        }
+    }
+
+    for (int e = 0, end; e < c->emit_count; e = end)
+    {
+        int group = c->group[c->emit[e]];
+        for (end = e; end < c->emit_count && c->group[c->emit[end]] == group; ++end)
+        {
+            int i = c->emit[end], outputs = c->output_base[i + 1] - c->output_base[i];
+            reg[i] = outputs ? register_alloc_take(&ra, outputs) : AIGC_NO_REGISTER;
+        }
+        for (int k = e; k < end; ++k)
+        {
+            int i = c->emit[k], outputs = c->output_base[i + 1] - c->output_base[i];
+            for (int j = c->arg_base[i]; j < c->arg_base[i] + c->arg_count[i]; ++j)
+            {
+                int slot;
+                float value;
+                int source = graph_compile_source(c, c->args[j], &slot, &value);
+                if (source >= 0 && last_use[c->output_base[source] + slot] == group)
+                    register_alloc_give(&ra, reg[source] + slot);
+            }
+            for (int o = 0; o < outputs; ++o)
+                if (last_use[c->output_base[i] + o] == group) register_alloc_give(&ra, reg[i] + o);
+        }
+    }
+
+    free(last_use);
+    free(ra.busy);
+    return ra.peak ? ra.peak : 1;
+}
+
+static void
+graph_compile_free(struct graph_compile *c)
+{
+    free(c->order);
+    free(c->input_base);
+    free(c->output_base);
+    free(c->prop_base);
+    free(c->prop_values);
+    free(c->link_of);
+    free(c->canon);
+    free(c->input_values);
+    free(c->output_values);
+    free(c->state);
+    free(c->scratch);
+    free(c->scratch_args);
+    free(c->op);
+    free(c->arg_base);
+    free(c->arg_count);
+    free(c->args);
+    free(c->prop_node);
+    free(c->emit);
+    free(c->group);
+    free(c->uniform);
+    free(c->segments);
+}
+
+/*
+ * Compiles a validated, host-order graph view: topological sort, constant
+ * folding, common subexpression elimination, dead node elimination,
+ * uniformity, superinstruction fusion, scheduling, constant pool
+ * construction, register assignment and instruction emission, written
+ * straight into one blob. The header tells how many nodes each pass
+ * eliminated. Returns 0 and sets the SDL error if the graph has a cycle, a
+ * node without a kernel or an input with a bad index.
+ */
+static int
+compile_graph_view_flags(struct compiled_graph *g, struct graph_view *view, struct config *conf, int flags)
+{
+    struct graph_compile c = {0};
+    int n = view->node_count, widest = 0;
+    uint32_t *source = NULL, *reg = NULL;
+    struct const_pool pool = {0};
+    uint32_t inputs = 0, outputs = 0, prop_total = 0, operand_total = 0, emitted_props = 0;
+    uint32_t input_count = 0, global_count = 0, event_count = 0, value_count = 0, register_count;
+    int instruction_count = 0, ok = 0;
+    uint64_t graph_hash;
+    size_t offsets[6], size;
+    struct aigc_header *h;
+
+    memset(g, 0, sizeof *g);
+    c.view = view;
+    c.conf = conf;
+    c.n = n;
+
+    c.input_base = malloc((n + 1) * sizeof *c.input_base);
+    c.output_base = malloc((n + 1) * sizeof *c.output_base);
+    c.prop_base = malloc((n + 1) * sizeof *c.prop_base);
+    c.order = malloc((n + 1) * sizeof *c.order);
+    c.state = calloc(n + 1, 1);
+    c.canon = malloc((n + 1) * sizeof *c.canon);
+    c.op = malloc((n + 1) * sizeof *c.op);
+    c.arg_base = malloc((n + 1) * sizeof *c.arg_base);
+    c.arg_count = malloc((n + 1) * sizeof *c.arg_count);
+    c.prop_node = malloc((n + 1) * sizeof *c.prop_node);
+    c.emit = malloc((n + 1) * sizeof *c.emit);
+    c.group = malloc((n + 1) * sizeof *c.group);
+    c.uniform = calloc(n + 1, 1);
+    c.segments = malloc((n + 1) * sizeof *c.segments);
+    reg = malloc((n + 1) * sizeof *reg);
+    if (!c.input_base || !c.output_base || !c.prop_base || !c.order || !c.state || !c.canon ||
+        !c.op || !c.arg_base || !c.arg_count || !c.prop_node || !c.emit || !c.group || !c.uniform || !c.segments || !reg)
+        goto oom;
+
+    for (int i = 0; i < n; ++i)
+    {
+        struct node_info *info = &conf->nodes[view->nodes[i].type];
+        const struct aigc_op_info *op = &aigc_ops[info->op];
+        const struct node_kernels *k = info->op == OP_KERNEL ? info->kernels : NULL;
+        if (info->op == OP_NONE || info->op >= OP_COUNT ||
+            (info->op == OP_KERNEL ? !k || !kernels_scalar(k, info->input_count) || !kernels_batch(k, info->input_count) :
+             op->inputs != info->input_count || op->outputs != info->output_count || op->props > info->prop_count))
+        {
+            SDL_SetError("node %d: type '%s' has no matching kernel", i, info->name);
+            goto cleanup;
+        }
+        c.canon[i] = i;
+        c.op[i] = info->op;
+        c.arg_base[i] = c.input_base[i] = inputs;
+        c.arg_count[i] = info->input_count;
+        c.prop_node[i] = i;
+        c.output_base[i] = outputs;
+        c.prop_base[i] = prop_total;
+        inputs += info->input_count;
+        outputs += info->output_count;
+        prop_total += info->prop_count;
+        if (info->input_count + info->output_count > widest) widest = info->input_count + info->output_count;
+    }
+    c.input_base[n] = inputs;
+    c.output_base[n] = outputs;
+    c.prop_base[n] = prop_total;
+
+    c.link_of = malloc((inputs + n + 1) * sizeof *c.link_of);
+    c.input_values = calloc(inputs + n + 1, sizeof *c.input_values);
+    c.output_values = calloc(outputs + 1, sizeof *c.output_values);
+    c.prop_values = calloc(prop_total + 1, sizeof *c.prop_values);
+    c.scratch = malloc((widest + 1) * sizeof *c.scratch);
+    c.scratch_args = malloc((widest + 1) * sizeof *c.scratch_args);
+    /* fused sum chains copy their operands after the nodes' own */
+    c.args = malloc((inputs + (size_t)n * AIGC_CHAIN_MAX + 1) * sizeof *c.args);
+    source = malloc((inputs + (size_t)n * AIGC_CHAIN_MAX + 1) * sizeof *source);
+    if (!c.link_of || !c.input_values || !c.output_values || !c.prop_values || !c.scratch || !c.scratch_args ||
+        !c.args || !source || !const_pool_init(&pool, inputs + n))
+        goto oom;
+    memset(c.link_of, 0xff, (inputs + n + 1) * sizeof *c.link_of);
+    for (int i = 0; i < widest; ++i) c.scratch_args[i] = i;
+    for (uint32_t j = 0; j < inputs; ++j) c.args[j] = j;
+    c.arg_total = inputs;
+
+    for (int i = 0; i < view->const_count; ++i)
+        c.input_values[c.input_base[view->consts[i].node_id] + view->consts[i].slot] = view->consts[i].value;
+    for (int i = 0; i < view->prop_count; ++i)
+        c.prop_values[c.prop_base[view->props[i].node_id] + view->props[i].slot] = view->props[i].value;
+    for (int i = 0; i < view->link_count; ++i)
+        c.link_of[c.input_base[view->links[i].out_id] + view->links[i].out_slot] = i;
+
+    if (!graph_view_sort(view, c.order) || !graph_view_hash(view, conf, c.order, NULL, &graph_hash))
+        goto cleanup;
+
+    graph_compile_fold(&c);
+    if (!graph_compile_merge(&c)) goto oom;
+    graph_compile_mark_live(&c);
+    graph_compile_classify(&c, flags);
+    if (!(flags & COMPILE_NO_FUSION) && !graph_compile_fuse(&c)) goto oom;
+    if (!graph_compile_schedule(&c, flags)) goto oom;
+
+    /* constants first, so node outputs can be numbered after them */
+    for (int i = 0; i < n; ++i)
+    {
+        if (!graph_compile_emitted(&c, i)) continue;
+        for (int j = c.arg_base[i]; j < c.arg_base[i] + c.arg_count[i]; ++j)
+        {
+            float value;
+            if (graph_compile_const_input(&c, c.args[j], &value)) source[j] = const_pool_add(&pool, value);
+        }
+    }
+
+    register_count = graph_compile_allocate(&c, reg, pool.count);
+    if (!register_count) goto oom;
+    for (int e = 0; e < c.emit_count; ++e)
+    {
+        int i = c.emit[e];
+        value_count += c.output_base[i + 1] - c.output_base[i];
+        operand_total += c.arg_count[i];
+        emitted_props += c.prop_base[c.prop_node[i] + 1] - c.prop_base[c.prop_node[i]];
+        if (aigc_ops[c.op[i]].side_effect) ++event_count;
+        ++instruction_count;
+    }
+    for (int i = 0; i < n; ++i)
+    {
+        if (!graph_compile_emitted(&c, i)) continue;
+        for (int j = c.arg_base[i]; j < c.arg_base[i] + c.arg_count[i]; ++j)
+        {
+            int slot;
+            float value;
+            int node = graph_compile_source(&c, c.args[j], &slot, &value);
+            if (node >= 0) source[j] = reg[node] + slot;
+        }
+    }
+
+    offsets[0] = AIGC_ALIGN_UP(sizeof *h);
+    offsets[1] = AIGC_ALIGN_UP(offsets[0] + instruction_count * sizeof(struct aigc_instruction));
+    offsets[2] = AIGC_ALIGN_UP(offsets[1] + operand_total * sizeof(uint32_t));
+    offsets[3] = AIGC_ALIGN_UP(offsets[2] + pool.count * sizeof(float));
+    offsets[4] = AIGC_ALIGN_UP(offsets[3] + emitted_props * sizeof(int32_t));
+    offsets[5] = AIGC_ALIGN_UP(offsets[4] + c.segment_count * sizeof(struct aigc_segment));
+    size = offsets[5];
+    if (size > UINT32_MAX)
+    {
+        SDL_SetError("graph is too large to compile");
+        goto cleanup;
+    }
+
+    g->storage = calloc(1, size);
+    if (!g->storage) goto oom;
+    h = g->storage;
+    memcpy(h->magic, AIGC_MAGIC, sizeof h->magic);
+    h->version = AIGC_VERSION;
+    h->size = (uint32_t)size;
+    h->config_hash = config_hash(conf);
+    h->graph_hash = graph_hash;
+    h->register_count = register_count;
+    h->value_count = value_count;
+    h->event_count = event_count;
+    h->instruction_count = instruction_count;
+    h->instruction_offset = (uint32_t)offsets[0];
+    h->operand_count = operand_total;
+    h->operand_offset = (uint32_t)offsets[1];
+    h->const_count = pool.count;
+    h->const_offset = (uint32_t)offsets[2];
+    h->prop_count = emitted_props;
+    h->prop_offset = (uint32_t)offsets[3];
+    h->segment_count = c.segment_count;
+    h->segment_offset = (uint32_t)offsets[4];
+    h->parallel_count = c.parallel_count;
+    h->uniform_count = c.uniform_count;
+    h->node_count = n;
+    h->folded_count = c.folded;
+    h->merged_count = c.merged;
+    h->dead_count = c.dead;
+    h->fused_count = c.fused;
+
+    g->instructions = (struct aigc_instruction*)((char*)h + h->instruction_offset);
+    g->operands = (uint32_t*)((char*)h + h->operand_offset);
+    g->consts = (float*)((char*)h + h->const_offset);
+    g->props = (int32_t*)((char*)h + h->prop_offset);
+    g->segments = (struct aigc_segment*)((char*)h + h->segment_offset);
+    g->header = h;
+    memcpy(g->consts, pool.values, pool.count * sizeof *g->consts);
+    memcpy(g->segments, c.segments, c.segment_count * sizeof *g->segments);
+
+    operand_total = emitted_props = 0;
+    for (int e = 0; e < c.emit_count; ++e)
+    {
+        int i = c.emit[e], p = c.prop_node[i];
+        uint32_t prop_count = c.prop_base[p + 1] - c.prop_base[p];
+        struct aigc_instruction *in = &g->instructions[e];
+        in->op = c.op[i];
+        in->node = i;
+        in->dst = reg[i];
+        in->props = emitted_props;
+        in->args = operand_total;
+        in->arg_count = c.arg_count[i];
+        in->type = view->nodes[i].type;
+        memcpy(g->operands + in->args, source + c.arg_base[i], c.arg_count[i] * sizeof *g->operands);
+        memcpy(g->props + in->props, c.prop_values + c.prop_base[p], prop_count * sizeof *g->props);
+        operand_total += c.arg_count[i];
+        emitted_props += prop_count;
+        if (in->op == OP_INPUT || in->op == AIGC_OP_ADD_INPUT)
+        {
+            int32_t index = g->props[in->props];
+            if (index < 0 || index >= 1 << 16)
+            {
+                SDL_SetError("node %d: input index %d is out of range", p, index);
+                goto cleanup;
+            }
+            if ((uint32_t)index >= input_count) input_count = index + 1;
+        }
+        if (in->op == OP_GLOBAL)
+        {
+            int32_t index = g->props[in->props];
+            if (index < 0 || index >= 1 << 16)
+            {
+                SDL_SetError("node %d: global index %d is out of range", p, index);
+                goto cleanup;
+            }
+            if ((uint32_t)index >= global_count) global_count = index + 1;
+        }
+    }
+    h->input_count = input_count;
+    h->global_count = global_count;
+    ok = compiled_graph_link(g, conf);
+    goto cleanup;
+
+oom:
+    SDL_SetError("out of memory");
+cleanup:
+    if (!ok) compiled_graph_free(g);
+    graph_compile_free(&c);
+    free(reg);
+    free(source);
+    const_pool_free(&pool);
+    return ok;
+}
+
+/* compile_graph_view_flags with every pass */
+static int
+compile_graph_view(struct compiled_graph *g, struct graph_view *view, struct config *conf)
+{
+    return compile_graph_view_flags(g, view, conf, 0);
+}
+
+#endif
@@ -0,0 +1,417 @@
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_error.h>
+#include "graph_file.h"
+#include "compiler.h"
+#include "compile_cache.h"
+#include "jobs.h"
+
+/*
+ * Splitting graphs into their weakly connected components, e.g. control
+ * branches ending in different play_anim nodes, which share nothing and
+ * compile into independent programs. Each program goes through the compile
+ * cache under its own hash, so an edit recompiles only the component it
+ * touched; the misses compile in parallel on a job pool and the programs
+ * run in parallel too, a job per program.
+ */
+
+struct graph_components
+{
+    int count;
+    int *component;     /* per node */
+    int *local;         /* per node, its index in its component */
+    int *first;         /* per component and one past, where its nodes start in `nodes` */
+    int *nodes;         /* nodes by component, each component's in node order */
+};
+
+static void
+graph_components_free(struct graph_components *gc)
+{
+    free(gc->component);
+    free(gc->local);
+    free(gc->first);
+    free(gc->nodes);
+    memset(gc, 0, sizeof *gc);
+}
+
+static int
+components_find(int *parent, int i)
+{
+    /* path halving */
+    while (parent[i] != i) i = parent[i] = parent[parent[i]];
+    return i;
+}
+
+static int
+graph_components_alloc(struct graph_components *gc, int n)
+{
+    memset(gc, 0, sizeof *gc);
+    gc->component = malloc((n + 1) * sizeof *gc->component);
+    gc->local = malloc((n + 1) * sizeof *gc->local);
+    gc->first = malloc((n + 2) * sizeof *gc->first);
+    gc->nodes = malloc((n + 1) * sizeof *gc->nodes);
+    if (gc->component && gc->local && gc->first && gc->nodes) return 1;
+    graph_components_free(gc);
+    SDL_SetError("out of memory");
+    return 0;
+}
+
+/*
+ * Fills in the rest of `gc` from gc->component, which holds a component
+ * below gc->count for each of the `n` nodes, or -1 for nodes in none.
+ */
+static void
+graph_components_index(struct graph_components *gc, int n)
+{
+    memset(gc->first, 0, (gc->count + 2) * sizeof *gc->first);
+    for (int i = 0; i < n; ++i)
+        if (gc->component[i] >= 0) gc->local[i] = gc->first[gc->component[i] + 1]++;
+    for (int k = 0; k < gc->count; ++k) gc->first[k + 1] += gc->first[k];
+    for (int i = 0; i < n; ++i)
+        if (gc->component[i] >= 0) gc->nodes[gc->first[gc->component[i]] + gc->local[i]] = i;
+}
+
+/*
+ * Weakly connected components of a validated view, by union-find over its
+ * links. Components are numbered in the order of their lowest node.
+ * Returns 0 and sets the SDL error when out of memory.
+ */
+static int
+graph_view_components(struct graph_components *gc, struct graph_view *view)
+{
+    int n = view->node_count;
+    int *parent = malloc((n + 1) * sizeof *parent);
+
+    memset(gc, 0, sizeof *gc);
+    if (!parent || !graph_components_alloc(gc, n))
+    {
+        free(parent);
+        SDL_SetError("out of memory");
+        return 0;
+    }
+
+    for (int i = 0; i < n; ++i) parent[i] = i;
+    for (int i = 0; i < view->link_count; ++i)
+    {
+        int a = components_find(parent, view->links[i].in_id);
+        int b = components_find(parent, view->links[i].out_id);
+        /* the lower node stays the root */
+        if (a < b) parent[b] = a;
+        else if (b < a) parent[a] = b;
+    }
+    /* roots come before the rest of their component, so they are numbered first */
+    for (int i = 0; i < n; ++i)
+    {
+        int root = components_find(parent, i);
+        gc->component[i] = root == i ? gc->count++ : gc->component[root];
+    }
+    graph_components_index(gc, n);
+    free(parent);
+    return 1;
+}
+
+/*
+ * Copies the nodes of component `k` of `view` into `sub`, a validated view
+ * of its own with nodes renumbered by gc->local; free it with
+ * graph_view_free. The nodes can be any set closed under links, e.g. a few
+ * whole components.
+ * Returns 0 and sets the SDL error when out of memory.
+ */
+static int
+graph_view_component(struct graph_view *sub, struct graph_view *view, struct graph_components *gc, int k)
+{
+    int node_count = gc->first[k + 1] - gc->first[k], link_count = 0, const_count = 0, prop_count = 0;
+    char *storage;
+
+    for (int i = 0; i < view->link_count; ++i) link_count += gc->component[view->links[i].in_id] == k;
+    for (int i = 0; i < view->const_count; ++i) const_count += gc->component[view->consts[i].node_id] == k;
+    for (int i = 0; i < view->prop_count; ++i) prop_count += gc->component[view->props[i].node_id] == k;
+
+    memset(sub, 0, sizeof *sub);
+    sub->storage_size = node_count * sizeof *sub->nodes + link_count * sizeof *sub->links +
+        const_count * sizeof *sub->consts + prop_count * sizeof *sub->props;
+    storage = sub->storage = malloc(sub->storage_size + 1);
+    if (!storage)
+    {
+        SDL_SetError("out of memory");
+        return 0;
+    }
+    sub->nodes = (struct aig_node*)storage;
+    sub->links = (struct aig_link*)(sub->nodes + node_count);
+    sub->consts = (struct aig_const*)(sub->links + link_count);
+    sub->props = (struct aig_prop*)(sub->consts + const_count);
+
+    for (int j = gc->first[k]; j < gc->first[k + 1]; ++j) sub->nodes[sub->node_count++] = view->nodes[gc->nodes[j]];
+    for (int i = 0; i < view->link_count; ++i)
+    {
+        struct aig_link l = view->links[i];
+        if (gc->component[l.in_id] != k) continue;
+        l.in_id = gc->local[l.in_id];
+        l.out_id = gc->local[l.out_id];
+        sub->links[sub->link_count++] = l;
+    }
+    for (int i = 0; i < view->const_count; ++i)
+    {
+        struct aig_const c = view->consts[i];
+        if (gc->component[c.node_id] != k) continue;
+        c.node_id = gc->local[c.node_id];
+        sub->consts[sub->const_count++] = c;
+    }
+    for (int i = 0; i < view->prop_count; ++i)
+    {
+        struct aig_prop p = view->props[i];
+        if (gc->component[p.node_id] != k) continue;
+        p.node_id = gc->local[p.node_id];
+        sub->props[sub->prop_count++] = p;
+    }
+    return 1;
+}
+
+#define SPLIT_MAX_PROGRAMS (COMPILE_CACHE_CAPACITY / 2)
+
+/*
+ * A graph compiled component by component: a program for every component
+ * with a side effect, the others can't do anything. Past SPLIT_MAX_PROGRAMS
+ * of them, components are dealt out to that many programs in turn, so the
+ * split's programs and the whole graph's still fit in the compile cache,
+ * which they belong to.
+ */
+struct compiled_split
+{
+    int component_count;
+    struct graph_components programs;   /* the nodes of each program */
+    int count;
+    struct compiled_graph **graphs;     /* per program */
+    uint32_t *event_base;               /* per program and one past, its first event per agent */
+    uint32_t input_count;               /* agent input slots read, highest index + 1 */
+    uint32_t global_count;              /* global slots read, highest index + 1 */
+    int unchanged;                      /* programs the cache had */
+    /* per program, register rows of `stride` floats, kept between runs */
+    float **registers;
+    size_t stride;
+    float **uniform;                    /* per program, the register file its uniform prologue runs on */
+    /* the batch run in progress */
+    size_t count_run;
+    const float *inputs;
+    const float *globals;
+    struct aigc_event *events;
+    int *event_count;
+};
+
+static void
+compiled_split_free(struct compiled_split *s)
+{
+    for (int k = 0; s->registers && k < s->count; ++k) free(s->registers[k]);
+    for (int k = 0; s->uniform && k < s->count; ++k) free(s->uniform[k]);
+    graph_components_free(&s->programs);
+    free(s->graphs);
+    free(s->event_base);
+    free(s->registers);
+    free(s->uniform);
+    free(s->event_count);
+    memset(s, 0, sizeof *s);
+}
+
+/* compile state of one program of a split */
+struct split_compile
+{
+    struct graph_view view;
+    uint64_t hash;
+    struct compiled_graph graph;
+    int ok;
+    char error[256];
+};
+
+struct split_compile_job
+{
+    struct split_compile *programs;
+    int *misses;
+    struct config *conf;
+};
+
+static void
+split_compile_job(void *user, int index, int worker)
+{
+    struct split_compile_job *job = user;
+    struct split_compile *p = &job->programs[job->misses[index]];
+
+    (void)worker;
+    p->ok = compile_graph_view(&p->graph, &p->view, job->conf);
+    if (!p->ok) snprintf(p->error, sizeof p->error, "%s", SDL_GetError());
+}
+
+/*
+ * Compiles a validated, host-order view component by component through
+ * `cache`, the programs it doesn't have in parallel on `pool`. The
+ * programs stay valid until the next lookup. Returns 0 and sets the SDL
+ * error on failure.
+ */
+static int
+compile_cache_split(struct compile_cache *cache, struct job_pool *pool, struct graph_view *view,
+    struct compiled_split *s)
+{
+    struct graph_components components;
+    struct split_compile_job job = {0};
+    struct split_compile *programs = NULL;
+    int *program = NULL, miss_count = 0, effects = 0, ok = 0;
+
+    memset(s, 0, sizeof *s);
+    if (!graph_view_components(&components, view)) return 0;
+    s->component_count = components.count;
+    program = malloc((components.count + 1) * sizeof *program);
+    if (!program || !graph_components_alloc(&s->programs, view->node_count)) goto oom;
+
+    /* the program of each component, -1 for those without side effects */
+    for (int k = 0; k < components.count; ++k) program[k] = -1;
+    for (int i = 0; i < view->node_count; ++i)
+        if (aigc_ops[cache->conf->nodes[view->nodes[i].type].op].side_effect) program[components.component[i]] = 0;
+    for (int k = 0; k < components.count; ++k) effects += program[k] == 0;
+    s->count = SDL_min(effects, SPLIT_MAX_PROGRAMS);
+    for (int k = 0, j = 0; k < components.count; ++k)
+        if (program[k] == 0) program[k] = j++ % SPLIT_MAX_PROGRAMS;
+    for (int i = 0; i < view->node_count; ++i) s->programs.component[i] = program[components.component[i]];
+    s->programs.count = s->count;
+    graph_components_index(&s->programs, view->node_count);
+
+    s->graphs = calloc(s->count + 1, sizeof *s->graphs);
+    s->event_base = calloc(s->count + 1, sizeof *s->event_base);
+    s->registers = calloc(s->count + 1, sizeof *s->registers);
+    s->uniform = calloc(s->count + 1, sizeof *s->uniform);
+    s->event_count = calloc(s->count + 1, sizeof *s->event_count);
+    programs = calloc(s->count + 1, sizeof *programs);
+    job.misses = malloc((s->count + 1) * sizeof *job.misses);
+    if (!s->graphs || !s->event_base || !s->registers || !s->uniform || !s->event_count || !programs || !job.misses)
+        goto oom;
+
+    /* cache lookups first, so a hit can't be evicted by storing a miss */
+    for (int j = 0; j < s->count; ++j)
+    {
+        if (!graph_view_component(&programs[j].view, view, &s->programs, j) ||
+            !graph_view_hash(&programs[j].view, cache->conf, NULL, NULL, &programs[j].hash))
+            goto cleanup;
+        s->graphs[j] = compile_cache_find(cache, programs[j].hash);
+        if (s->graphs[j]) ++s->unchanged;
+        else job.misses[miss_count++] = j;
+    }
+
+    job.programs = programs;
+    job.conf = cache->conf;
+    jobs_run(pool, miss_count, split_compile_job, &job);
+    for (int m = 0; m < miss_count; ++m)
+    {
+        struct split_compile *p = &programs[job.misses[m]];
+        if (!p->ok)
+        {
+            SDL_SetError("%s", p->error);
+            goto cleanup;
+        }
+    }
+    for (int m = 0; m < miss_count; ++m)
+    {
+        int j = job.misses[m];
+        s->graphs[j] = compile_cache_store(cache, programs[j].hash, &programs[j].graph);
+    }
+
+    for (int j = 0; j < s->count; ++j)
+    {
+        struct aigc_header *h = s->graphs[j]->header;
+        s->event_base[j + 1] = s->event_base[j] + h->event_count;
+        if (h->input_count > s->input_count) s->input_count = h->input_count;
+        if (h->global_count > s->global_count) s->global_count = h->global_count;
+        s->uniform[j] = malloc((h->register_count + 1) * sizeof **s->uniform);
+        if (!s->uniform[j]) goto oom;
+        compiled_graph_init_registers(s->graphs[j], s->uniform[j]);
+    }
+    ok = 1;
+    goto cleanup;
+
+oom:
+    SDL_SetError("out of memory");
+cleanup:
+    for (int j = 0; programs && j < s->count; ++j)
+    {
+        graph_view_free(&programs[j].view);
+        compiled_graph_free(&programs[j].graph);
+    }
+    free(programs);
+    free(job.misses);
+    free(program);
+    graph_components_free(&components);
+    if (!ok) compiled_split_free(s);
+    return ok;
+}
+
+/* events all programs of a split can emit for one agent */
+static uint32_t
+compiled_split_event_count(struct compiled_split *s)
+{
+    return s->event_base[s->count];
+}
+
+static void
+compiled_split_job(void *user, int index, int worker)
+{
+    struct compiled_split *s = user;
+    struct compiled_graph *g = s->graphs[index];
+
+    (void)worker;
+    compiled_graph_run_uniform(g, s->uniform[index], s->globals);
+    compiled_graph_init_batch(g, s->registers[index], s->stride, s->count_run, s->uniform[index]);
+    s->event_count[index] = compiled_graph_run_batch(g, s->registers[index], s->stride, s->count_run, s->inputs,
+        s->events + (size_t)s->event_base[index] * s->count_run);
+}
+
+/*
+ * compiled_graph_run_batch for a split, a job per program on `pool`, each
+ * running its uniform prologue first. `globals` holds global_count global
+ * slots, `inputs` input_count rows of `stride` floats and `events` room for
+ * compiled_split_event_count * count events, which come grouped by program,
+ * then by instruction, with node indices of the whole graph. Returns the
+ * number of events, -1 and the SDL error when out of memory.
+ */
+static int
+compiled_split_run_batch(struct compiled_split *s, struct job_pool *pool, const float *globals, size_t stride,
+    size_t count, const float *inputs, struct aigc_event *events)
+{
+    int event_count = 0;
+
+    if (stride != s->stride)
+    {
+        s->stride = 0;
+        for (int k = 0; k < s->count; ++k)
+        {
+            free(s->registers[k]);
+            s->registers[k] = malloc(((size_t)s->graphs[k]->header->register_count * stride + 1) * sizeof **s->registers);
+            if (!s->registers[k])
+            {
+                SDL_SetError("out of memory");
+                return -1;
+            }
+        }
+        s->stride = stride;
+    }
+    s->count_run = count;
+    s->inputs = inputs;
+    s->globals = globals;
+    s->events = events;
+    jobs_run(pool, s->count, compiled_split_job, s);
+
+    /* compact in program order, moving each program's events down */
+    for (int k = 0; k < s->count; ++k)
+    {
+        struct aigc_event *e = events + (size_t)s->event_base[k] * count;
+        const int *nodes = s->programs.nodes + s->programs.first[k];
+        for (int i = 0; i < s->event_count[k]; ++i)
+        {
+            events[event_count] = e[i];
+            events[event_count++].node = nodes[e[i].node];
+        }
+    }
+    return event_count;
+}
+
+#endif
@@ -0,0 +1,891 @@
+#ifndef CONFIG_FILE_H
+#define CONFIG_FILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <SDL2/SDL_endian.h>
+#include <SDL2/SDL_error.h>
+#include "aigraph.h"
+#include "file_map.h"
+#include "save_job.h"
+#include "text_format.h"
+#include "compiler.h"
+#include "dir_walk.h"
+#include "symbols.h"
+
+/*
+ * Node type definitions loaded from data instead of default_nodes. The
+ * source is a JSON subset (.aigdef) parsed with the text_format.h
+ * tokenizer:
+ *
+ *   {
+ *   "format": "aigraph-config", "version": 1,
+ *   "enums": [
+ *   {"name": "animation", "values": ["idle", "wave_hand"]}
+ *   ],
+ *   "nodes": [
+ *   {"name": "sum", "category": "math", "op": "sum", "inputs": ["in0", "in1"], "outputs": ["out"]},
+ *   {"name": "play_anim", "category": "control", "op": "play_anim", "inputs": ["in"],
+ *    "props": [{"name": "animation", "type": "enum", "enum": "animation"}]}
+ *   ]
+ *   }
+ *
+ * Parsing produces a binary blob (.aigcfg) with every name interned into
+ * one string table, which is saved next to the source. Later startups map
+ * the blob and only fix up pointers; names are used straight from the
+ * mapping. The blob remembers the source's mtime and size and is rebuilt
+ * when they change.
+ *
+ * Blob layout (little-endian, sections 4-byte aligned):
+ *   struct aicf_header
+ *   struct aicf_node[node_count]
+ *   struct aicf_prop[prop_count]
+ *   u32 input names[input_count], u32 output names[output_count]
+ *   struct aicf_enum[enum_count]
+ *   u32 enum value names[value_count]
+ *   strings, NUL-terminated, offset 0 is ""
+ * Names are string table offsets; nodes and enums address their ports,
+ * properties and values as runs of the section arrays.
+ */
+
+#define AICF_MAGIC "AIGCONF"
+#define AICF_VERSION 1
+#define CONFIG_TEXT_VERSION 1
+#define CONFIG_BLOB_EXTENSION ".aigcfg"
+
+struct aicf_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t size;              /* whole file */
+    uint64_t config_hash;       /* of the bound config, see config_hash */
+    uint64_t source_mtime, source_size;
+    uint32_t node_count, node_offset;
+    uint32_t prop_count, prop_offset;
+    uint32_t input_count, input_offset;
+    uint32_t output_count, output_offset;
+    uint32_t enum_count, enum_offset;
+    uint32_t value_count, value_offset;
+    uint32_t string_size, string_offset;
+};
+
+struct aicf_node
+{
+    uint32_t name, category, op;
+    uint32_t input_count, inputs;
+    uint32_t output_count, outputs;
+    uint32_t prop_count, props;
+};
+
+struct aicf_prop
+{
+    uint32_t name, type, enum_type;
+};
+
+struct aicf_enum
+{
+    uint32_t name, value_count, values;
+};
+
+/* one allocation: this, then the tables of struct config */
+struct config_storage
+{
+    struct file_map map;    /* blob the names point into when it was mapped */
+    void *image;            /* or the blob built in memory */
+};
+
+static void
+config_file_release(struct config *conf)
+{
+    struct config_storage *s = conf->storage;
+    file_map_close(&s->map);
+    free(s->image);
+    free(s);
+    conf->storage = NULL;
+    conf->release = NULL;
+}
+
+static void
+aicf_swap_words(void *records, size_t count)
+{
+    uint32_t *w = records;
+    for (size_t i = 0; i < count; ++i) w[i] = SDL_SwapLE32(w[i]);
+}
+
+static void
+aicf_swap_header(struct aicf_header *h)
+{
+    h->source_mtime = SDL_SwapLE64(h->source_mtime);
+    h->source_size = SDL_SwapLE64(h->source_size);
+    h->config_hash = SDL_SwapLE64(h->config_hash);
+    h->version = SDL_SwapLE32(h->version);
+    h->size = SDL_SwapLE32(h->size);
+    aicf_swap_words(&h->node_count, (sizeof *h - offsetof(struct aicf_header, node_count)) / sizeof(uint32_t));
+}
+
+/* section [offset, offset + count * record_size) lies inside the blob and is aligned */
+static int
+aicf_section_ok(const struct aicf_header *h, uint32_t offset, uint32_t count, size_t record_size)
+{
+    return !(offset & 3) && offset >= sizeof *h && offset <= h->size &&
+        count <= (h->size - offset) / record_size;
+}
+
+static int
+aicf_run_ok(uint32_t first, uint32_t count, uint32_t total)
+{
+    return first <= total && count <= total - first;
+}
+
+/*
+ * Points `conf` at the tables of a host-order blob image. Everything is
+ * range-checked first; `storage` is the caller's struct config_storage
+ * block, which gets the tables appended. Returns 0 and sets the SDL error
+ * on failure.
+ */
+static int
+config_bind(struct config *conf, const char *data, size_t size, struct config_storage **storage)
+{
+    const struct aicf_header *h = (const struct aicf_header*)data;
+    const struct aicf_node *nodes;
+    const struct aicf_prop *props;
+    const struct aicf_enum *enums;
+    const uint32_t *inputs, *outputs, *values;
+    const char *strings;
+    struct config_storage *s;
+    struct property_info *prop_info;
+    struct input_info *input_info;
+    struct output_info *output_info;
+    char **value_names;
+    size_t tables;
+
+    if (size < sizeof *h || memcmp(h->magic, AICF_MAGIC, sizeof h->magic))
+    {
+        SDL_SetError("not a config blob");
+        return 0;
+    }
+    if (h->version != AICF_VERSION)
+    {
+        SDL_SetError("config blob version %u is not supported", h->version);
+        return 0;
+    }
+    if (h->size != size ||
+        !aicf_section_ok(h, h->node_offset, h->node_count, sizeof *nodes) ||
+        !aicf_section_ok(h, h->prop_offset, h->prop_count, sizeof *props) ||
+        !aicf_section_ok(h, h->input_offset, h->input_count, sizeof *inputs) ||
+        !aicf_section_ok(h, h->output_offset, h->output_count, sizeof *outputs) ||
+        !aicf_section_ok(h, h->enum_offset, h->enum_count, sizeof *enums) ||
+        !aicf_section_ok(h, h->value_offset, h->value_count, sizeof *values) ||
+        !aicf_section_ok(h, h->string_offset, h->string_size, 1) ||
+        !h->string_size || data[h->string_offset + h->string_size - 1] != '\0' ||
+        h->node_count > SHRT_MAX || h->enum_count > SHRT_MAX)
+    {
+        SDL_SetError("config blob is truncated or corrupt");
+        return 0;
+    }
+
+    nodes = (const struct aicf_node*)(data + h->node_offset);
+    props = (const struct aicf_prop*)(data + h->prop_offset);
+    inputs = (const uint32_t*)(data + h->input_offset);
+    outputs = (const uint32_t*)(data + h->output_offset);
+    enums = (const struct aicf_enum*)(data + h->enum_offset);
+    values = (const uint32_t*)(data + h->value_offset);
+    strings = data + h->string_offset;
+
+#define NAME_OK(offset) ((offset) < h->string_size)
+    for (uint32_t i = 0; i < h->node_count; ++i)
+    {
+        const struct aicf_node *n = &nodes[i];
+        if (!NAME_OK(n->name) || !NAME_OK(n->category) || n->op >= OP_COUNT || n->op == OP_KERNEL ||
+            !aicf_run_ok(n->inputs, n->input_count, h->input_count) ||
+            !aicf_run_ok(n->outputs, n->output_count, h->output_count) ||
+            !aicf_run_ok(n->props, n->prop_count, h->prop_count))
+        {
+            SDL_SetError("config blob: node type %u is out of range", i);
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < h->prop_count; ++i)
+    {
+        if (!NAME_OK(props[i].name) || props[i].type > FIELD_ENUM ||
+            (props[i].type == FIELD_ENUM && props[i].enum_type >= h->enum_count))
+        {
+            SDL_SetError("config blob: property %u is out of range", i);
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < h->input_count; ++i) if (!NAME_OK(inputs[i])) goto bad_name;
+    for (uint32_t i = 0; i < h->output_count; ++i) if (!NAME_OK(outputs[i])) goto bad_name;
+    for (uint32_t i = 0; i < h->value_count; ++i) if (!NAME_OK(values[i])) goto bad_name;
+    for (uint32_t i = 0; i < h->enum_count; ++i)
+    {
+        if (!NAME_OK(enums[i].name) || !aicf_run_ok(enums[i].values, enums[i].value_count, h->value_count))
+        {
+            SDL_SetError("config blob: enum %u is out of range", i);
+            return 0;
+        }
+    }
+#undef NAME_OK
+
+    tables = sizeof *s + h->node_count * sizeof *conf->nodes + h->prop_count * sizeof *prop_info +
+        h->input_count * sizeof *input_info + h->output_count * sizeof *output_info +
+        h->enum_count * sizeof *conf->enums + h->value_count * sizeof *value_names;
+    s = realloc(*storage, tables);
+    if (!s)
+    {
+        SDL_SetError("out of memory");
+        return 0;
+    }
+    *storage = s;
+
+    conf->nodes = (struct node_info*)(s + 1);
+    prop_info = (struct property_info*)(conf->nodes + h->node_count);
+    input_info = (struct input_info*)(prop_info + h->prop_count);
+    output_info = (struct output_info*)(input_info + h->input_count);
+    conf->enums = (struct enum_info*)(output_info + h->output_count);
+    value_names = (char**)(conf->enums + h->enum_count);
+    conf->node_count = h->node_count;
+    conf->enum_count = h->enum_count;
+
+    for (uint32_t i = 0; i < h->prop_count; ++i)
+    {
+        prop_info[i].name = (char*)strings + props[i].name;
+        prop_info[i].type = (property_type)props[i].type;
+        prop_info[i].enum_type = props[i].type == FIELD_ENUM ? (short)props[i].enum_type : 0;
+    }
+    for (uint32_t i = 0; i < h->input_count; ++i) input_info[i].name = (char*)strings + inputs[i];
+    for (uint32_t i = 0; i < h->output_count; ++i) output_info[i].name = (char*)strings + outputs[i];
+    for (uint32_t i = 0; i < h->value_count; ++i) value_names[i] = (char*)strings + values[i];
+    for (uint32_t i = 0; i < h->node_count; ++i)
+    {
+        const struct aicf_node *n = &nodes[i];
+        struct node_info *info = &conf->nodes[i];
+        info->name = (char*)strings + n->name;
+        info->category = (char*)strings + n->category;
+        info->op = (node_op)n->op;
+        info->input_count = n->input_count;
+        info->output_count = n->output_count;
+        info->prop_count = n->prop_count;
+        info->inputs = input_info + n->inputs;
+        info->outputs = output_info + n->outputs;
+        info->props = prop_info + n->props;
+        info->kernels = NULL;
+    }
+    for (uint32_t i = 0; i < h->enum_count; ++i)
+    {
+        conf->enums[i].name = (char*)strings + enums[i].name;
+        conf->enums[i].count = enums[i].value_count;
+        conf->enums[i].values = value_names + enums[i].values;
+    }
+    return 1;
+
+bad_name:
+    SDL_SetError("config blob: name is out of range");
+    return 0;
+}
+
+/* swaps a blob image between little-endian and host order; `to_host` tells which way it goes */
+static void
+aicf_swap(char *data, int to_host)
+{
+    struct aicf_header *h = (struct aicf_header*)data;
+    uint32_t *first, words;
+
+    if (SDL_BYTEORDER == SDL_LIL_ENDIAN) return;
+    if (to_host) aicf_swap_header(h);
+    /* every section but the strings is made of 32-bit words and they are contiguous */
+    first = (uint32_t*)(data + h->node_offset);
+    words = (h->string_offset - h->node_offset) / sizeof(uint32_t);
+    aicf_swap_words(first, words);
+    if (!to_host) aicf_swap_header(h);
+}
+
+/*
+ * Opens a config blob, mapping it and pointing `conf` at it. With
+ * `source_mtime` and `source_size` given, a blob built from a different
+ * source version fails. Returns 0 and sets the SDL error on failure.
+ */
+static int
+config_blob_open(struct config *conf, const char *path, const uint64_t *source_mtime, const uint64_t *source_size)
+{
+    struct config_storage *s = calloc(1, sizeof *s);
+    struct aicf_header *h;
+
+    if (!s)
+    {
+        SDL_SetError("out of memory");
+        return 0;
+    }
+    if (!file_map_open(&s->map, path)) goto fail;
+    h = s->map.data;
+    if (s->map.size < sizeof *h || memcmp(h->magic, AICF_MAGIC, sizeof h->magic))
+    {
+        SDL_SetError("'%s' is not a config blob", path);
+        goto fail;
+    }
+    if (SDL_SwapLE32(h->size) != s->map.size || SDL_SwapLE32(h->string_offset) < SDL_SwapLE32(h->node_offset) ||
+        SDL_SwapLE32(h->string_offset) > s->map.size)
+    {
+        SDL_SetError("'%s' is truncated or corrupt", path);
+        goto fail;
+    }
+    aicf_swap(s->map.data, 1);
+    if (source_mtime && (h->source_mtime != *source_mtime || h->source_size != *source_size))
+    {
+        SDL_SetError("'%s' is out of date", path);
+        goto fail;
+    }
+    if (!config_bind(conf, s->map.data, s->map.size, &s)) goto fail;
+    if (config_hash(conf) != h->config_hash)
+    {
+        SDL_SetError("'%s' is corrupt", path);
+        goto fail;
+    }
+    conf->storage = s;
+    conf->release = config_file_release;
+    return 1;
+
+fail:
+    file_map_close(&s->map);
+    free(s);
+    return 0;
+}
+
+/* strings interned into one table, found again through an open-addressing index */
+struct string_pool
+{
+    char *data;
+    uint32_t size, capacity;
+    uint32_t *slots;        /* offsets, UINT32_MAX when empty */
+    uint32_t slot_count, used;
+};
+
+static uint32_t
+string_pool_hash(const char *s, int len)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; ++i) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+static void
+string_pool_free(struct string_pool *pool)
+{
+    free(pool->data);
+    free(pool->slots);
+    memset(pool, 0, sizeof *pool);
+}
+
+static int
+string_pool_rehash(struct string_pool *pool, uint32_t slot_count)
+{
+    uint32_t *slots = malloc(slot_count * sizeof *slots);
+    if (!slots) return 0;
+    memset(slots, 0xff, slot_count * sizeof *slots);
+    for (uint32_t i = 0; i < pool->slot_count; ++i)
+    {
+        uint32_t offset = pool->slots[i], j;
+        if (offset == UINT32_MAX) continue;
+        j = string_pool_hash(pool->data + offset, (int)strlen(pool->data + offset)) & (slot_count - 1);
+        while (slots[j] != UINT32_MAX) j = (j + 1) & (slot_count - 1);
+        slots[j] = offset;
+    }
+    free(pool->slots);
+    pool->slots = slots;
+    pool->slot_count = slot_count;
+    return 1;
+}
+
+/* offset of the string in the table, adding it if needed; UINT32_MAX when out of memory */
+static uint32_t
+string_pool_intern(struct string_pool *pool, const char *s, int len)
+{
+    uint32_t j, offset;
+
+    if (pool->used * 2 >= pool->slot_count && !string_pool_rehash(pool, pool->slot_count ? pool->slot_count * 2 : 256))
+        return UINT32_MAX;
+    j = string_pool_hash(s, len) & (pool->slot_count - 1);
+    for (; pool->slots[j] != UINT32_MAX; j = (j + 1) & (pool->slot_count - 1))
+    {
+        const char *t = pool->data + pool->slots[j];
+        if (!memcmp(t, s, len) && t[len] == '\0') return pool->slots[j];
+    }
+
+    if (pool->size + len + 1 > pool->capacity)
+    {
+        uint32_t capacity = pool->capacity ? pool->capacity : 4096;
+        char *data;
+        while (pool->size + len + 1 > capacity) capacity *= 2;
+        data = realloc(pool->data, capacity);
+        if (!data) return UINT32_MAX;
+        pool->data = data;
+        pool->capacity = capacity;
+    }
+    offset = pool->size;
+    memcpy(pool->data + offset, s, len);
+    pool->data[offset + len] = '\0';
+    pool->size += len + 1;
+    pool->slots[j] = offset;
+    ++pool->used;
+    return offset;
+}
+
+struct config_parser
+{
+    struct text_parser tp;  /* first, record callbacks get a pointer to it */
+    struct string_pool strings;
+    struct aicf_node *nodes;
+    struct aicf_prop *props;
+    struct aicf_enum *enums;
+    uint32_t *inputs, *outputs, *values;
+    int node_count, prop_count, enum_count, input_count, output_count, value_count;
+    int node_capacity, prop_capacity, enum_capacity, input_capacity, output_capacity, value_capacity;
+};
+
+static void
+config_parser_free(struct config_parser *cp)
+{
+    string_pool_free(&cp->strings);
+    free(cp->nodes);
+    free(cp->props);
+    free(cp->enums);
+    free(cp->inputs);
+    free(cp->outputs);
+    free(cp->values);
+}
+
+/* parses a string and interns it */
+static int
+config_parse_name(struct config_parser *cp, uint32_t *name)
+{
+    const char *s;
+    int len;
+
+    if (!text_parse_string(&cp->tp, &s, &len)) return 0;
+    if (memchr(s, '\\', len)) return text_error(&cp->tp, "escapes are not supported in names");
+    *name = string_pool_intern(&cp->strings, s, len);
+    if (*name == UINT32_MAX) return text_error(&cp->tp, "out of memory");
+    return 1;
+}
+
+/* ["a", "b", ...] appended to a name section */
+static int
+config_parse_names(struct config_parser *cp, uint32_t **names, int *count, int *capacity)
+{
+    struct text_parser *tp = &cp->tp;
+
+    if (!text_expect(tp, '[')) return 0;
+    if (text_accept(tp, ']')) return 1;
+    do
+    {
+        if (!text_grow(tp, (void**)names, capacity, *count, sizeof **names) ||
+            !config_parse_name(cp, &(*names)[*count]))
+            return 0;
+        ++*count;
+    } while (text_accept(tp, ','));
+    return text_expect(tp, ']');
+}
+
+static int
+config_parse_prop(struct text_parser *tp)
+{
+    struct config_parser *cp = (struct config_parser*)tp;
+    struct aicf_prop *prop;
+    const char *key;
+    int len, has_name = 0, has_enum = 0;
+
+    if (!text_grow(tp, (void**)&cp->props, &cp->prop_capacity, cp->prop_count, sizeof *cp->props)) return 0;
+    prop = &cp->props[cp->prop_count];
+    memset(prop, 0, sizeof *prop);
+
+    if (!text_expect(tp, '{')) return 0;
+    if (!text_accept(tp, '}')) do
+    {
+        if (!text_parse_string(tp, &key, &len) || !text_expect(tp, ':')) return 0;
+        if (text_key_is(key, len, "name"))
+        {
+            if (!config_parse_name(cp, &prop->name)) return 0;
+            has_name = 1;
+        }
+        else if (text_key_is(key, len, "type"))
+        {
+            static const char *types[] = { "int", "float", "enum" };
+            const char *s;
+            int slen, t;
+            if (!text_parse_string(tp, &s, &slen)) return 0;
+            for (t = 0; t < (int)LEN(types) && !text_key_is(s, slen, types[t]); ++t);
+            if (t == (int)LEN(types)) return text_error(tp, "unknown property type '%.*s'", slen, s);
+            prop->type = t;
+        }
+        else if (text_key_is(key, len, "enum"))
+        {
+            /* the enum's name for now, resolved once all enums are known */
+            if (!config_parse_name(cp, &prop->enum_type)) return 0;
+            has_enum = 1;
+        }
+        else if (!text_skip_value(tp, 1)) return 0;
+    } while (text_accept(tp, ','));
+    if (!text_expect(tp, '}')) return 0;
+
+    if (!has_name) return text_error(tp, "property without a name");
+    if ((prop->type == FIELD_ENUM) != has_enum)
+        return text_error(tp, "property '%s' needs \"enum\" exactly when its type is enum",
+            cp->strings.data + prop->name);
+    ++cp->prop_count;
+    return 1;
+}
+
+static int
+config_parse_node(struct text_parser *tp)
+{
+    struct config_parser *cp = (struct config_parser*)tp;
+    struct aicf_node node;
+    const struct aigc_op_info *op;
+    const char *key;
+    int len, has_name = 0;
+
+    memset(&node, 0, sizeof node);
+    node.inputs = cp->input_count;
+    node.outputs = cp->output_count;
+    node.props = cp->prop_count;
+
+    if (!text_expect(tp, '{')) return 0;
+    if (!text_accept(tp, '}')) do
+    {
+        if (!text_parse_string(tp, &key, &len) || !text_expect(tp, ':')) return 0;
+        if (text_key_is(key, len, "name"))
+        {
+            if (!config_parse_name(cp, &node.name)) return 0;
+            has_name = 1;
+        }
+        else if (text_key_is(key, len, "category"))
+        {
+            if (!config_parse_name(cp, &node.category)) return 0;
+        }
+        else if (text_key_is(key, len, "op"))
+        {
+            const char *s;
+            int slen, o;
+            if (!text_parse_string(tp, &s, &slen)) return 0;
+            for (o = 0; o < OP_COUNT && !text_key_is(s, slen, aigc_ops[o].name); ++o);
+            if (o == OP_COUNT) return text_error(tp, "unknown op '%.*s'", slen, s);
+            if (o == OP_KERNEL) return text_error(tp, "node types with native kernels come from plugins");
+            node.op = o;
+        }
+        else if (text_key_is(key, len, "inputs"))
+        {
+            if (node.input_count) return text_error(tp, "duplicate \"inputs\"");
+            if (!config_parse_names(cp, &cp->inputs, &cp->input_count, &cp->input_capacity)) return 0;
+            node.input_count = cp->input_count - node.inputs;
+        }
+        else if (text_key_is(key, len, "outputs"))
+        {
+            if (node.output_count) return text_error(tp, "duplicate \"outputs\"");
+            if (!config_parse_names(cp, &cp->outputs, &cp->output_count, &cp->output_capacity)) return 0;
+            node.output_count = cp->output_count - node.outputs;
+        }
+        else if (text_key_is(key, len, "props"))
+        {
+            if (node.prop_count) return text_error(tp, "duplicate \"props\"");
+            if (!text_parse_array(tp, config_parse_prop)) return 0;
+            node.prop_count = cp->prop_count - node.props;
+        }
+        else if (!text_skip_value(tp, 1)) return 0;
+    } while (text_accept(tp, ','));
+    if (!text_expect(tp, '}')) return 0;
+
+    if (!has_name) return text_error(tp, "node type without a name");
+    op = &aigc_ops[node.op];
+    if (node.op != OP_NONE &&
+        (node.input_count != (uint32_t)op->inputs || node.output_count != (uint32_t)op->outputs ||
+         node.prop_count != (uint32_t)op->props))
+        return text_error(tp, "node type '%s' doesn't have the ports and properties of op '%s'",
+            cp->strings.data + node.name, op->name);
+    if (!text_grow(tp, (void**)&cp->nodes, &cp->node_capacity, cp->node_count, sizeof *cp->nodes)) return 0;
+    cp->nodes[cp->node_count++] = node;
+    return 1;
+}
+
+static int
+config_parse_enum(struct text_parser *tp)
+{
+    struct config_parser *cp = (struct config_parser*)tp;
+    struct aicf_enum e;
+    const char *key;
+    int len, has_name = 0;
+
+    memset(&e, 0, sizeof e);
+    e.values = cp->value_count;
+    if (!text_expect(tp, '{')) return 0;
+    if (!text_accept(tp, '}')) do
+    {
+        if (!text_parse_string(tp, &key, &len) || !text_expect(tp, ':')) return 0;
+        if (text_key_is(key, len, "name"))
+        {
+            if (!config_parse_name(cp, &e.name)) return 0;
+            has_name = 1;
+        }
+        else if (text_key_is(key, len, "values"))
+        {
+            if (e.value_count) return text_error(tp, "duplicate \"values\"");
+            if (!config_parse_names(cp, &cp->values, &cp->value_count, &cp->value_capacity)) return 0;
+            e.value_count = cp->value_count - e.values;
+        }
+        else if (!text_skip_value(tp, 1)) return 0;
+    } while (text_accept(tp, ','));
+    if (!text_expect(tp, '}')) return 0;
+
+    if (!has_name) return text_error(tp, "enum without a name");
+    if (e.value_count > SHRT_MAX) return text_error(tp, "enum '%s' has too many values", cp->strings.data + e.name);
+    if (!text_grow(tp, (void**)&cp->enums, &cp->enum_capacity, cp->enum_count, sizeof *cp->enums)) return 0;
+    cp->enums[cp->enum_count++] = e;
+    return 1;
+}
+
+static int
+config_parse_document(struct config_parser *cp)
+{
+    struct text_parser *tp = &cp->tp;
+    const char *key;
+    int len;
+
+    if (!text_expect(tp, '{')) return 0;
+    if (!text_accept(tp, '}')) do
+    {
+        if (!text_parse_string(tp, &key, &len) || !text_expect(tp, ':')) return 0;
+        if (text_key_is(key, len, "version"))
+        {
+            int32_t version;
+            if (!text_parse_int(tp, &version)) return 0;
+            if (version != CONFIG_TEXT_VERSION) return text_error(tp, "unsupported version %d", version);
+        }
+        else if (text_key_is(key, len, "enums"))
+        {
+            if (!text_parse_array(tp, config_parse_enum)) return 0;
+        }
+        else if (text_key_is(key, len, "nodes"))
+        {
+            if (!text_parse_array(tp, config_parse_node)) return 0;
+        }
+        else if (!text_skip_value(tp, 1)) return 0;
+    } while (text_accept(tp, ','));
+    if (!text_expect(tp, '}')) return 0;
+
+    text_skip_ws(tp);
+    if (tp->p != tp->end) return text_error(tp, "trailing data after the config");
+    if (!cp->node_count) return text_error(tp, "no node types");
+    if (cp->node_count > SHRT_MAX || cp->enum_count > SHRT_MAX) return text_error(tp, "too many node types or enums");
+    return 1;
+}
+
+/*
+ * Checks names across the whole config and turns enum names into indices.
+ * Interned names are equal exactly when their offsets are, so these are
+ * integer compares.
+ */
+static int
+config_parser_resolve(struct config_parser *cp, const char *path)
+{
+    uint32_t *owner = malloc(cp->strings.size * sizeof *owner);
+    int ok = 0;
+
+    if (!owner)
+    {
+        SDL_SetError("out of memory");
+        return 0;
+    }
+    memset(owner, 0xff, cp->strings.size * sizeof *owner);
+
+    for (int i = 0; i < cp->node_count; ++i)
+    {
+        uint32_t name = cp->nodes[i].name;
+        if (owner[name] != UINT32_MAX)
+        {
+            SDL_SetError("%s: node type '%s' is defined twice", path, cp->strings.data + name);
+            goto done;
+        }
+        owner[name] = i;
+    }
+    memset(owner, 0xff, cp->strings.size * sizeof *owner);
+    for (int i = 0; i < cp->enum_count; ++i)
+    {
+        uint32_t name = cp->enums[i].name;
+        if (owner[name] != UINT32_MAX)
+        {
+            SDL_SetError("%s: enum '%s' is defined twice", path, cp->strings.data + name);
+            goto done;
+        }
+        owner[name] = i;
+    }
+    for (int i = 0; i < cp->node_count; ++i)
+    {
+        struct aicf_node *n = &cp->nodes[i];
+        for (uint32_t j = 0; j < n->prop_count; ++j)
+        {
+            struct aicf_prop *p = &cp->props[n->props + j];
+            if (p->type != FIELD_ENUM) continue;
+            if (owner[p->enum_type] == UINT32_MAX)
+            {
+                SDL_SetError("%s: property '%s' of node type '%s' uses unknown enum '%s'", path,
+                    cp->strings.data + p->name, cp->strings.data + n->name, cp->strings.data + p->enum_type);
+                goto done;
+            }
+            p->enum_type = owner[p->enum_type];
+        }
+    }
+    ok = 1;
+
+done:
+    free(owner);
+    return ok;
+}
+
+/* lays the parsed tables out as a host-order blob image */
+static char*
+config_parser_image(struct config_parser *cp, uint64_t source_mtime, uint64_t source_size, size_t *size)
+{
+    struct aicf_header h;
+    char *data;
+    size_t offset = sizeof h;
+
+    memset(&h, 0, sizeof h);
+    memcpy(h.magic, AICF_MAGIC, sizeof h.magic);
+    h.version = AICF_VERSION;
+    h.source_mtime = source_mtime;
+    h.source_size = source_size;
+#define SECTION(count_field, offset_field, count, bytes) \
+    h.count_field = (uint32_t)(count); h.offset_field = (uint32_t)offset; offset += (bytes)
+    SECTION(node_count, node_offset, cp->node_count, cp->node_count * sizeof *cp->nodes);
+    SECTION(prop_count, prop_offset, cp->prop_count, cp->prop_count * sizeof *cp->props);
+    SECTION(input_count, input_offset, cp->input_count, cp->input_count * sizeof *cp->inputs);
+    SECTION(output_count, output_offset, cp->output_count, cp->output_count * sizeof *cp->outputs);
+    SECTION(enum_count, enum_offset, cp->enum_count, cp->enum_count * sizeof *cp->enums);
+    SECTION(value_count, value_offset, cp->value_count, cp->value_count * sizeof *cp->values);
+    SECTION(string_size, string_offset, cp->strings.size, (cp->strings.size + 3) & ~(size_t)3);
+#undef SECTION
+    if (offset > UINT32_MAX)
+    {
+        SDL_SetError("config is too large");
+        return NULL;
+    }
+    h.size = (uint32_t)offset;
+
+    data = calloc(1, offset);
+    if (!data)
+    {
+        SDL_SetError("out of memory");
+        return NULL;
+    }
+    memcpy(data, &h, sizeof h);
+    /* empty sections may have no array at all */
+#define COPY(offset, records, count) if (count) memcpy(data + (offset), records, (count) * sizeof *(records))
+    COPY(h.node_offset, cp->nodes, cp->node_count);
+    COPY(h.prop_offset, cp->props, cp->prop_count);
+    COPY(h.input_offset, cp->inputs, cp->input_count);
+    COPY(h.output_offset, cp->outputs, cp->output_count);
+    COPY(h.enum_offset, cp->enums, cp->enum_count);
+    COPY(h.value_offset, cp->values, cp->value_count);
+#undef COPY
+    memcpy(data + h.string_offset, cp->strings.data, cp->strings.size);
+    *size = offset;
+    return data;
+}
+
+/*
+ * Parses a config source into `conf` and, if `blob_path` is given, saves
+ * the blob there (a blob that can't be written is only a slower next
+ * startup). Returns 0 and sets the SDL error on failure.
+ */
+static int
+config_text_read(struct config *conf, const char *path, const char *blob_path)
+{
+    struct config_parser cp;
+    struct config_storage *s = NULL;
+    struct file_map map;
+    struct aicf_header *h;
+    uint64_t mtime = 0, size = 0;
+    size_t image_size;
+    char *image = NULL, error[256];
+    int ok;
+
+    if (!file_map_open(&map, path)) return 0;
+    file_stat(path, &mtime, &size);
+
+    memset(&cp, 0, sizeof cp);
+    cp.tp.begin = cp.tp.p = map.data;
+    cp.tp.end = cp.tp.begin + map.size;
+    cp.tp.path = path;
+    /* offset 0 is the empty string, used by missing categories */
+    ok = string_pool_intern(&cp.strings, "", 0) != UINT32_MAX;
+    ok = ok && config_parse_document(&cp) && config_parser_resolve(&cp, path);
+    file_map_close(&map);
+    if (ok) image = config_parser_image(&cp, mtime, size, &image_size);
+    config_parser_free(&cp);
+    if (!image) return 0;
+
+    s = calloc(1, sizeof *s);
+    if (!s || !config_bind(conf, image, image_size, &s))
+    {
+        if (!s) SDL_SetError("out of memory");
+        free(s);
+        free(image);
+        return 0;
+    }
+    s->image = image;
+    conf->storage = s;
+    conf->release = config_file_release;
+
+    h = (struct aicf_header*)image;
+    h->config_hash = config_hash(conf);
+    if (blob_path)
+    {
+        aicf_swap(image, 0);
+        if (!file_write_durable(blob_path, image, image_size, error, sizeof error)) SDL_ClearError();
+        aicf_swap(image, 1);
+    }
+    return 1;
+}
+
+/*
+ * Loads node type definitions into `conf`: a .aigcfg is opened directly,
+ * anything else is a source whose blob is kept next to it ('nodes.aigdef'
+ * -> 'nodes.aigcfg') and used while it is current. The name lookups of
+ * symbols.h are built right away. Returns 0 and sets the SDL error on
+ * failure; release with config_cleanup.
+ */
+static int
+config_load(struct config *conf, const char *path)
+{
+    char blob[1024];
+    const char *dot = strrchr(path, '.');
+    uint64_t mtime, size;
+    size_t base = dot && !strpbrk(dot, "/\\") ? (size_t)(dot - path) : strlen(path);
+
+    memset(conf, 0, sizeof *conf);
+    if (path_has_extension(path, CONFIG_BLOB_EXTENSION))
+    {
+        if (!config_blob_open(conf, path, NULL, NULL)) return 0;
+    }
+    else
+    {
+        snprintf(blob, sizeof blob, "%.*s%s", (int)base, path, CONFIG_BLOB_EXTENSION);
+        if (!file_stat(path, &mtime, &size))
+        {
+            SDL_SetError("couldn't open '%s'", path);
+            return 0;
+        }
+        if (!config_blob_open(conf, blob, &mtime, &size) && !config_text_read(conf, path, blob)) return 0;
+    }
+    /* names that can't be told apart are load errors, not lookup surprises */
+    if (!config_symbols_build(conf))
+    {
+        config_cleanup(conf);
+        return 0;
+    }
+    return 1;
+}
+
+#endif
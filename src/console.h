@@ -90,7 +90,7 @@ console_printf(struct console *console, char *fmt, ...)
 static void 
 console_execute(struct console *console, struct node_editor *editor, char *string)
 {
-#define ARGCHECK(cmd, cond) do { if (!(cond)) { console_print(console, "error: wrong number of arguments for '%s' command", cmd); return; } } while(0)
+#define ARGCHECK(cmd, cond) do { if (!(cond)) { console_printf(console, "error: wrong number of arguments for '%s' command", cmd); return; } } while(0)
 
     char buf[INPUT_SIZE];
     char *p = string;
@@ -108,9 +108,17 @@ console_execute(struct console *console, struct node_editor *editor, char *strin
 
     if (!strcmp(buf, "save"))
     {
-        ARGCHECK("save", argc == 1);
-        sprintf_s(buf, NK_LEN(buf), "%s.aig", p);
-        node_editor_save(editor, buf);
+        char name[INPUT_SIZE], option[INPUT_SIZE];
+        ARGCHECK("save", argc == 1 || argc == 2);
+        p = read_word(p, name, NK_LEN(name));
+        read_word(p, option, NK_LEN(option));
+        if (argc == 2 && strcmp(option, "lz"))
+        {
+            console_printf(console, "error: unknown option '%s', expected 'lz'", option);
+            return;
+        }
+        sprintf_s(buf, NK_LEN(buf), "%s.aig", name);
+        node_editor_save(editor, buf, argc == 2);
     }
     else if (!strcmp(buf, "load"))
     {
@@ -118,6 +126,86 @@ console_execute(struct console *console, struct node_editor *editor, char *strin
         sprintf_s(buf, NK_LEN(buf), "%s.aig", p);
         node_editor_load(editor, buf);
     }
+    else if (!strcmp(buf, "export"))
+    {
+        ARGCHECK("export", argc == 1);
+        sprintf_s(buf, NK_LEN(buf), "%s.aigt", p);
+        node_editor_export(editor, buf);
+    }
+    else if (!strcmp(buf, "import"))
+    {
+        ARGCHECK("import", argc == 1);
+        sprintf_s(buf, NK_LEN(buf), "%s.aigt", p);
+        node_editor_import(editor, buf);
+    }
+    else if (!strcmp(buf, "compile"))
+    {
+        ARGCHECK("compile", argc == 1);
+        sprintf_s(buf, NK_LEN(buf), "%s.aigc", p);
+        node_editor_compile_file(editor, buf);
+    }
+    else if (!strcmp(buf, "bench"))
+    {
+        int agents;
+        ARGCHECK("bench", argc <= 1);
+        agents = argc ? atoi(p) : 10000;
+        if (agents <= 0)
+        {
+            console_printf(console, "error: expected a number of agents, got '%s'", p);
+            return;
+        }
+        node_editor_bench(editor, agents);
+    }
+    else if (!strcmp(buf, "split"))
+    {
+        int agents;
+        ARGCHECK("split", argc <= 1);
+        agents = argc ? atoi(p) : 10000;
+        if (agents <= 0)
+        {
+            console_printf(console, "error: expected a number of agents, got '%s'", p);
+            return;
+        }
+        node_editor_split(editor, agents);
+    }
+    else if (!strcmp(buf, "incremental"))
+    {
+        char count[INPUT_SIZE];
+        int agents = 10000, percent = 10;
+        ARGCHECK("incremental", argc <= 2);
+        if (argc)
+        {
+            p = read_word(p, count, NK_LEN(count));
+            agents = atoi(count);
+        }
+        if (argc == 2) percent = atoi(skip_whitespace(p));
+        if (agents <= 0 || percent < 0 || percent > 100)
+        {
+            console_print(console, "error: expected a number of agents and a percentage changing per tick");
+            return;
+        }
+        node_editor_incremental(editor, agents, percent);
+    }
+    else if (!strcmp(buf, "native"))
+    {
+        ARGCHECK("native", argc == 1);
+        node_editor_native(editor, p, 10000);
+    }
+    else if (!strcmp(buf, "add"))
+    {
+        char name[INPUT_SIZE];
+        int type;
+        ARGCHECK("add", argc == 1);
+        read_word(p, name, NK_LEN(name));
+        type = config_find_type(editor->conf, name, (int)strlen(name));
+        if (type < 0) console_printf(console, "error: unknown node type '%s'", name);
+        else node_editor_add(editor, (node_type)type, editor->scrolling.x + 100, editor->scrolling.y + 100);
+    }
+    else if (!strcmp(buf, "library"))
+    {
+        ARGCHECK("library", argc <= 1);
+        node_editor_open_library(editor, argc ? p : ".");
+    }
     else
     {
         console_print(console, "error: invalid command");
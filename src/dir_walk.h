@@ -0,0 +1,152 @@
+#ifndef DIR_WALK_H
+#define DIR_WALK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <SDL2/SDL_error.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+/* growing list of malloc'ed paths */
+struct path_list
+{
+    char **paths;
+    int count, capacity;
+};
+
+static int
+path_list_add(struct path_list *list, const char *path)
+{
+    if (list->count == list->capacity)
+    {
+        int capacity = list->capacity ? list->capacity * 2 : 64;
+        char **paths = realloc(list->paths, capacity * sizeof *paths);
+        if (!paths) { SDL_SetError("out of memory"); return 0; }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    list->paths[list->count] = _strdup(path);
+    if (!list->paths[list->count]) { SDL_SetError("out of memory"); return 0; }
+    ++list->count;
+    return 1;
+}
+
+static void
+path_list_free(struct path_list *list)
+{
+    for (int i = 0; i < list->count; ++i) free(list->paths[i]);
+    free(list->paths);
+    memset(list, 0, sizeof *list);
+}
+
+static int
+path_has_extension(const char *path, const char *ext)
+{
+    size_t len = strlen(path), ext_len = strlen(ext);
+    return len > ext_len && !strcmp(path + len - ext_len, ext);
+}
+
+/* modification time (seconds) and size of a file; returns 0 if it doesn't exist */
+static int
+file_stat(const char *path, uint64_t *mtime, uint64_t *size)
+{
+#ifdef _WIN32
+    struct __stat64 st;
+    if (_stat64(path, &st)) return 0;
+#else
+    struct stat st;
+    if (stat(path, &st)) return 0;
+#endif
+    *mtime = (uint64_t)st.st_mtime;
+    *size = (uint64_t)st.st_size;
+    return 1;
+}
+
+static int
+path_compare(const void *a, const void *b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static int
+dir_walk_recursive(const char *dir, const char *ext, struct path_list *list)
+{
+    char path[1024];
+    int ok = 1;
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find;
+
+    snprintf(path, sizeof path, "%s\\*", dir);
+    find = FindFirstFileA(path, &data);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        SDL_SetError("couldn't open directory '%s'", dir);
+        return 0;
+    }
+    do
+    {
+        if (!strcmp(data.cFileName, ".") || !strcmp(data.cFileName, "..")) continue;
+        snprintf(path, sizeof path, "%s\\%s", dir, data.cFileName);
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            ok = dir_walk_recursive(path, ext, list);
+        else if (path_has_extension(path, ext))
+            ok = path_list_add(list, path);
+    } while (ok && FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+    struct stat st;
+
+    if (!d)
+    {
+        SDL_SetError("couldn't open directory '%s'", dir);
+        return 0;
+    }
+    while (ok && (entry = readdir(d)))
+    {
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+        snprintf(path, sizeof path, "%s/%s", dir, entry->d_name);
+        if (stat(path, &st)) continue;
+        if (S_ISDIR(st.st_mode))
+            ok = dir_walk_recursive(path, ext, list);
+        else if (path_has_extension(path, ext))
+            ok = path_list_add(list, path);
+    }
+    closedir(d);
+#endif
+    return ok;
+}
+
+/*
+ * Collects every file under `dir` (recursively) whose name ends in `ext`,
+ * sorted so runs are reproducible. Returns 0 and sets the SDL error on
+ * failure.
+ */
+static int
+dir_walk(const char *dir, const char *ext, struct path_list *list)
+{
+    memset(list, 0, sizeof *list);
+    if (!dir_walk_recursive(dir, ext, list))
+    {
+        path_list_free(list);
+        return 0;
+    }
+    qsort(list->paths, list->count, sizeof *list->paths, path_compare);
+    return 1;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef FILE_MAP_H
+#define FILE_MAP_H
+
+#include <stddef.h>
+#include <SDL2/SDL_error.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Private (copy-on-write) read mapping of a whole file. Pages are faulted in
+ * only when touched, and writes never reach the file.
+ */
+struct file_map
+{
+    void *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+};
+
+static void
+file_map_close(struct file_map *map)
+{
+#ifdef _WIN32
+    if (map->data) UnmapViewOfFile(map->data);
+    if (map->mapping) CloseHandle(map->mapping);
+    if (map->file && map->file != INVALID_HANDLE_VALUE) CloseHandle(map->file);
+#else
+    if (map->data) munmap(map->data, map->size);
+#endif
+    memset(map, 0, sizeof *map);
+}
+
+/* returns 0 and sets the SDL error on failure; empty files fail to map */
+static int
+file_map_open(struct file_map *map, const char *path)
+{
+    memset(map, 0, sizeof *map);
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (map->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(map->file, &size) || !size.QuadPart)
+        goto error;
+    map->size = (size_t)size.QuadPart;
+    map->mapping = CreateFileMappingA(map->file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if (!map->mapping) goto error;
+    map->data = MapViewOfFile(map->mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (!map->data) goto error;
+    return 1;
+#else
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) goto error;
+    if (fstat(fd, &st) == -1 || !st.st_size) { close(fd); goto error; }
+    map->size = (size_t)st.st_size;
+    map->data = mmap(NULL, map->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map->data == MAP_FAILED) { map->data = NULL; goto error; }
+    return 1;
+#endif
+
+error:
+    file_map_close(map);
+    SDL_SetError("couldn't map file '%s'", path);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,642 @@
+#ifndef GRAPH_FILE_H
+#define GRAPH_FILE_H
+
+#include <stdint.h>
+#include <limits.h>
+#include <SDL2/SDL_endian.h>
+#include <SDL2/SDL_error.h>
+#include "aigraph.h"
+#include "file_map.h"
+#include "lz.h"
+
+/*
+ * .aig v2 layout, all values little-endian:
+ *
+ *   struct aig_header
+ *   struct aig_section[section_count]
+ *   section payloads, each aligned to AIG_ALIGN bytes
+ *
+ * Every section is an array of fixed-size records, so a whole graph can be
+ * produced in one staging buffer and consumed in place after validation.
+ * Readers skip sections they don't know about.
+ *
+ * A compressed file (AIG_FLAG_LZ) stores a copy of the header followed by
+ * struct aig_packed and an LZ block that expands to the full uncompressed
+ * image above, with each section byte-shuffled by its record size.
+ */
+
+#define AIG_MAGIC "AIGRAPH"
+#define AIG_LEGACY_MAGIC "aigraph"
+#define AIG_VERSION 2
+#define AIG_ALIGN 16
+
+enum aig_flags
+{
+    AIG_FLAG_LZ = 1 << 0
+};
+
+enum aig_section_id
+{
+    AIG_SECTION_NODES = 1,
+    AIG_SECTION_LINKS,
+    AIG_SECTION_CONSTS,
+    AIG_SECTION_PROPS
+};
+
+struct aig_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    float scroll_x, scroll_y;
+    uint32_t section_count;
+    uint32_t generation;  /* edit journal generation, see journal.h */
+};
+
+struct aig_section
+{
+    uint32_t id;
+    uint32_t record_size;
+    uint64_t count;
+    uint64_t offset;
+};
+
+struct aig_packed
+{
+    uint64_t raw_size;
+    uint64_t packed_size;
+};
+
+struct aig_node
+{
+    int32_t type;
+    float x, y;
+};
+
+/* same naming as the editor: `in` is the node providing the value (its
+ * output slot), `out` is the node consuming it (its input slot) */
+struct aig_link
+{
+    int32_t in_id, in_slot;
+    int32_t out_id, out_slot;
+};
+
+struct aig_const
+{
+    int32_t node_id, slot;
+    float value;
+};
+
+struct aig_prop
+{
+    int32_t node_id, slot;
+    int32_t value;
+};
+
+/* flat, pointer-free view of a graph; records may live in a staging buffer,
+ * a file image or a file mapping */
+struct graph_view
+{
+    float scroll_x, scroll_y;
+    uint32_t generation;
+    int compressed;     /* opened from an AIG_FLAG_LZ file */
+    struct aig_node *nodes;
+    struct aig_link *links;
+    struct aig_const *consts;
+    struct aig_prop *props;
+    int node_count, link_count, const_count, prop_count;
+    void *storage;  /* owned memory the records point into, if any */
+    size_t storage_size;
+    struct file_map map;  /* owned mapping the records point into, if any */
+};
+
+#define AIG_SECTION_COUNT 4
+#define AIG_ALIGN_UP(x) (((x) + AIG_ALIGN - 1) & ~(size_t)(AIG_ALIGN - 1))
+
+/* all header and record fields are 32-bit words */
+static void
+aig_swap_words(void *data, size_t bytes)
+{
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    uint32_t *w = data;
+    for (size_t i = 0; i < bytes / 4; ++i) w[i] = SDL_SwapLE32(w[i]);
+#else
+    (void)data; (void)bytes;
+#endif
+}
+
+static void
+aig_swap_section(struct aig_section *s)
+{
+    s->id = SDL_SwapLE32(s->id);
+    s->record_size = SDL_SwapLE32(s->record_size);
+    s->count = SDL_SwapLE64(s->count);
+    s->offset = SDL_SwapLE64(s->offset);
+}
+
+static void
+aig_swap_records(struct graph_view *view)
+{
+    aig_swap_words(view->nodes, view->node_count * sizeof *view->nodes);
+    aig_swap_words(view->links, view->link_count * sizeof *view->links);
+    aig_swap_words(view->consts, view->const_count * sizeof *view->consts);
+    aig_swap_words(view->props, view->prop_count * sizeof *view->props);
+}
+
+static void
+graph_view_free(struct graph_view *view)
+{
+    free(view->storage);
+    file_map_close(&view->map);
+    memset(view, 0, sizeof *view);
+}
+
+/*
+ * Allocates a staging buffer holding header, section table and room for the
+ * given number of records, and points `view` at the record arrays. Fill them
+ * in, then call graph_file_end before writing `view->storage` out.
+ */
+static int
+graph_file_begin(struct graph_view *view, int node_count, int link_count,
+    int const_count, int prop_count)
+{
+    struct aig_header *header;
+    struct aig_section *table;
+    size_t offset, sizes[AIG_SECTION_COUNT], offsets[AIG_SECTION_COUNT];
+    uint32_t record_sizes[AIG_SECTION_COUNT] = { sizeof(struct aig_node),
+        sizeof(struct aig_link), sizeof(struct aig_const), sizeof(struct aig_prop) };
+    int counts[AIG_SECTION_COUNT] = { node_count, link_count, const_count, prop_count };
+    char *data;
+
+    memset(view, 0, sizeof *view);
+
+    offset = AIG_ALIGN_UP(sizeof *header + AIG_SECTION_COUNT * sizeof *table);
+    for (int i = 0; i < AIG_SECTION_COUNT; ++i)
+    {
+        offsets[i] = offset;
+        sizes[i] = (size_t)counts[i] * record_sizes[i];
+        offset = AIG_ALIGN_UP(offset + sizes[i]);
+    }
+
+    data = calloc(1, offset);
+    if (!data) { SDL_SetError("out of memory"); return 0; }
+
+    header = (struct aig_header*)data;
+    memcpy(header->magic, AIG_MAGIC, sizeof AIG_MAGIC);
+    header->version = AIG_VERSION;
+    header->section_count = AIG_SECTION_COUNT;
+
+    table = (struct aig_section*)(header + 1);
+    for (int i = 0; i < AIG_SECTION_COUNT; ++i)
+    {
+        table[i].id = AIG_SECTION_NODES + i;
+        table[i].record_size = record_sizes[i];
+        table[i].count = counts[i];
+        table[i].offset = offsets[i];
+    }
+
+    view->nodes = (struct aig_node*)(data + offsets[0]);
+    view->links = (struct aig_link*)(data + offsets[1]);
+    view->consts = (struct aig_const*)(data + offsets[2]);
+    view->props = (struct aig_prop*)(data + offsets[3]);
+    view->node_count = node_count;
+    view->link_count = link_count;
+    view->const_count = const_count;
+    view->prop_count = prop_count;
+    view->storage = data;
+    view->storage_size = offset;
+    return 1;
+}
+
+/* stores scroll and generation into the header and converts the image to little-endian */
+static void
+graph_file_end(struct graph_view *view)
+{
+    struct aig_header *header = view->storage;
+    struct aig_section *table = (struct aig_section*)(header + 1);
+    header->scroll_x = view->scroll_x;
+    header->scroll_y = view->scroll_y;
+    header->generation = view->generation;
+    aig_swap_records(view);
+    for (int i = 0; i < AIG_SECTION_COUNT; ++i) aig_swap_section(&table[i]);
+    aig_swap_words(&header->version, sizeof *header - sizeof header->magic);
+}
+
+/*
+ * Points `view` into a v2 file image of `size` bytes. The image is used in
+ * place (and byte-swapped in place on big-endian hosts), so it must be
+ * writable, AIG_ALIGN-aligned and outlive the view. Returns 0 and sets the
+ * SDL error on malformed input.
+ */
+static int
+graph_file_parse(void *data, size_t size, struct graph_view *view)
+{
+    struct aig_header header;
+    char *bytes = data;
+
+    memset(view, 0, sizeof *view);
+
+    if (size < sizeof header) goto invalid;
+    memcpy(&header, data, sizeof header);
+    if (memcmp(header.magic, AIG_MAGIC, sizeof AIG_MAGIC)) goto invalid;
+    aig_swap_words(&header.version, sizeof header - sizeof header.magic);
+    if (header.version != AIG_VERSION)
+    {
+        SDL_SetError("unsupported file version %u", header.version);
+        return 0;
+    }
+    if (header.flags & AIG_FLAG_LZ) goto invalid;
+    if (header.section_count > (size - sizeof header) / sizeof(struct aig_section)) goto invalid;
+
+    view->scroll_x = header.scroll_x;
+    view->scroll_y = header.scroll_y;
+    view->generation = header.generation;
+
+    for (uint32_t i = 0; i < header.section_count; ++i)
+    {
+        struct aig_section s;
+        void *records;
+        memcpy(&s, bytes + sizeof header + i * sizeof s, sizeof s);
+        aig_swap_section(&s);
+
+        if (s.offset % AIG_ALIGN || s.offset > size) goto invalid;
+        if (s.record_size && s.count > (size - s.offset) / s.record_size) goto invalid;
+        records = bytes + s.offset;
+
+#define SECTION(ptr, cnt) do { \
+            if (s.record_size != sizeof *(ptr) || s.count > INT_MAX) goto invalid; \
+            ptr = records; cnt = (int)s.count; } while (0)
+        switch (s.id)
+        {
+            case AIG_SECTION_NODES: SECTION(view->nodes, view->node_count); break;
+            case AIG_SECTION_LINKS: SECTION(view->links, view->link_count); break;
+            case AIG_SECTION_CONSTS: SECTION(view->consts, view->const_count); break;
+            case AIG_SECTION_PROPS: SECTION(view->props, view->prop_count); break;
+            default: break;
+        }
+#undef SECTION
+    }
+
+    aig_swap_records(view);
+    return 1;
+
+invalid:
+    memset(view, 0, sizeof *view);
+    SDL_SetError("invalid file");
+    return 0;
+}
+
+/*
+ * Decodes the original field-by-field format (magic "aigraph", u8 slots) into
+ * freshly allocated records owned by the view.
+ */
+static int
+graph_file_parse_legacy(char *data, size_t size, struct graph_view *view)
+{
+#define NEED(n) do { if ((size_t)(end - p) < (size_t)(n)) goto invalid; } while (0)
+#define U8() (*p++)
+#define LE32() (p += 4, SDL_SwapLE32(*(uint32_t*)memcpy(&word, p - 4, 4)))
+
+    char *p = data, *end = data + size;
+    uint32_t word;
+    uint32_t counts[AIG_SECTION_COUNT];
+    char *sections[AIG_SECTION_COUNT];
+    size_t record_sizes[AIG_SECTION_COUNT] = { 10, 10, 9, 9 };
+
+    memset(view, 0, sizeof *view);
+
+#ifdef _WIN32
+    /* v1 files were written in text mode, undo the newline translation */
+    {
+        char *w = data;
+        for (char *r = data; r < end; ++r)
+            if (!(r[0] == '\r' && r + 1 < end && r[1] == '\n')) *w++ = *r;
+        end = w;
+        size = end - data;
+    }
+#endif
+
+    NEED(sizeof AIG_LEGACY_MAGIC + 8);
+    if (memcmp(p, AIG_LEGACY_MAGIC, sizeof AIG_LEGACY_MAGIC)) goto invalid;
+    p += sizeof AIG_LEGACY_MAGIC;
+    {uint32_t x = LE32(), y = LE32();
+    memcpy(&view->scroll_x, &x, 4);
+    memcpy(&view->scroll_y, &y, 4);}
+
+    /* locate sections first, so records can go into a single allocation */
+    for (int i = 0; i < AIG_SECTION_COUNT; ++i)
+    {
+        NEED(4);
+        counts[i] = LE32();
+        if (counts[i] > INT_MAX || counts[i] > (size_t)(end - p) / record_sizes[i]) goto invalid;
+        sections[i] = p;
+        p += counts[i] * record_sizes[i];
+    }
+
+    view->node_count = counts[0];
+    view->link_count = counts[1];
+    view->const_count = counts[2];
+    view->prop_count = counts[3];
+    view->storage_size = view->node_count * sizeof *view->nodes +
+        view->link_count * sizeof *view->links +
+        view->const_count * sizeof *view->consts +
+        view->prop_count * sizeof *view->props;
+    view->storage = malloc(view->storage_size ? view->storage_size : 1);
+    if (!view->storage) { SDL_SetError("out of memory"); return 0; }
+    view->nodes = view->storage;
+    view->links = (struct aig_link*)(view->nodes + view->node_count);
+    view->consts = (struct aig_const*)(view->links + view->link_count);
+    view->props = (struct aig_prop*)(view->consts + view->const_count);
+
+    p = sections[0];
+    for (int i = 0; i < view->node_count; ++i)
+    {
+        uint32_t x, y;
+        view->nodes[i].type = (int16_t)((p[0] & 0xff) | (p[1] & 0xff) << 8);
+        p += 2;
+        x = LE32(); y = LE32();
+        memcpy(&view->nodes[i].x, &x, 4);
+        memcpy(&view->nodes[i].y, &y, 4);
+    }
+    p = sections[1];
+    for (int i = 0; i < view->link_count; ++i)
+    {
+        struct aig_link *l = &view->links[i];
+        l->in_id = (int32_t)LE32();
+        l->out_id = (int32_t)LE32();
+        l->in_slot = (uint8_t)U8();
+        l->out_slot = (uint8_t)U8();
+    }
+    p = sections[2];
+    for (int i = 0; i < view->const_count; ++i)
+    {
+        struct aig_const *c = &view->consts[i];
+        uint32_t value;
+        c->node_id = (int32_t)LE32();
+        value = LE32();
+        memcpy(&c->value, &value, 4);
+        c->slot = (uint8_t)U8();
+    }
+    p = sections[3];
+    for (int i = 0; i < view->prop_count; ++i)
+    {
+        struct aig_prop *pr = &view->props[i];
+        pr->node_id = (int32_t)LE32();
+        pr->value = (int32_t)LE32();
+        pr->slot = (uint8_t)U8();
+    }
+    return 1;
+
+invalid:
+    graph_view_free(view);
+    SDL_SetError("invalid file");
+    return 0;
+
+#undef NEED
+#undef U8
+#undef LE32
+}
+
+/* applies lz_shuffle or lz_unshuffle to every section of a v2 image; `dst`
+ * must be zeroed, only header, table and section bytes are written */
+static int
+aig_shuffle_sections(const char *src, char *dst, size_t size, int unshuffle)
+{
+    struct aig_header header;
+    memcpy(&header, src, sizeof header);
+    aig_swap_words(&header.version, sizeof header - sizeof header.magic);
+    if (header.section_count > (size - sizeof header) / sizeof(struct aig_section)) return 0;
+
+    memcpy(dst, src, sizeof header + header.section_count * sizeof(struct aig_section));
+    for (uint32_t i = 0; i < header.section_count; ++i)
+    {
+        struct aig_section s;
+        memcpy(&s, src + sizeof header + i * sizeof s, sizeof s);
+        aig_swap_section(&s);
+        if (s.offset > size || !s.record_size || s.count > (size - s.offset) / s.record_size)
+            return 0;
+        if (unshuffle) lz_unshuffle(src + s.offset, dst + s.offset, s.count, s.record_size);
+        else lz_shuffle(src + s.offset, dst + s.offset, s.count, s.record_size);
+    }
+    return 1;
+}
+
+/*
+ * Compresses a v2 image produced by graph_file_end. Returns a new buffer
+ * holding the whole compressed file, or NULL with the SDL error set.
+ */
+static void*
+graph_file_pack(const void *image, size_t size, size_t *packed_size)
+{
+    struct aig_header header;
+    struct aig_packed packed;
+    char *shuffled = calloc(1, size), *out = NULL;
+    size_t offset = sizeof header + sizeof packed;
+
+    if (!shuffled) goto oom;
+    if (!aig_shuffle_sections(image, shuffled, size, 0))
+    {
+        free(shuffled);
+        SDL_SetError("invalid image");
+        return NULL;
+    }
+
+    out = malloc(offset + LZ_BOUND(size));
+    if (!out) goto oom;
+
+    packed.raw_size = size;
+    packed.packed_size = lz_compress(shuffled, size, out + offset);
+    if (!packed.packed_size && size) goto oom;
+    free(shuffled);
+
+    memcpy(&header, image, sizeof header);
+    header.flags |= SDL_SwapLE32(AIG_FLAG_LZ);
+    *packed_size = offset + packed.packed_size;
+    packed.raw_size = SDL_SwapLE64(packed.raw_size);
+    packed.packed_size = SDL_SwapLE64(packed.packed_size);
+    memcpy(out, &header, sizeof header);
+    memcpy(out + sizeof header, &packed, sizeof packed);
+    return out;
+
+oom:
+    free(shuffled);
+    free(out);
+    SDL_SetError("out of memory");
+    return NULL;
+}
+
+/*
+ * Expands a compressed file into a fresh v2 image. Returns NULL with the SDL
+ * error set if the data is corrupt.
+ */
+static void*
+graph_file_unpack(const void *data, size_t size, size_t *raw_size)
+{
+    struct aig_packed packed;
+    const char *bytes = data;
+    char *shuffled = NULL, *image = NULL;
+
+    if (size < sizeof(struct aig_header) + sizeof packed) goto invalid;
+    memcpy(&packed, bytes + sizeof(struct aig_header), sizeof packed);
+    packed.raw_size = SDL_SwapLE64(packed.raw_size);
+    packed.packed_size = SDL_SwapLE64(packed.packed_size);
+    if (packed.packed_size > size - sizeof(struct aig_header) - sizeof packed ||
+        packed.raw_size < sizeof(struct aig_header) || packed.raw_size > SIZE_MAX / 2)
+        goto invalid;
+
+    shuffled = malloc(packed.raw_size);
+    image = calloc(1, packed.raw_size);
+    if (!shuffled || !image)
+    {
+        free(shuffled);
+        free(image);
+        SDL_SetError("out of memory");
+        return NULL;
+    }
+
+    if (!lz_decompress(bytes + sizeof(struct aig_header) + sizeof packed, packed.packed_size,
+            shuffled, packed.raw_size) ||
+        !aig_shuffle_sections(shuffled, image, packed.raw_size, 1))
+        goto invalid;
+
+    free(shuffled);
+    *raw_size = packed.raw_size;
+    return image;
+
+invalid:
+    free(shuffled);
+    free(image);
+    SDL_SetError("invalid file");
+    return NULL;
+}
+
+/*
+ * Opens a graph file for reading. v2 files are mapped and their records used
+ * in place, so only the pages actually touched get read; compressed and
+ * legacy files are decoded into memory. Release the view with graph_view_free.
+ */
+static int
+graph_view_open(struct graph_view *view, const char *path)
+{
+    struct file_map map;
+    int ok;
+
+    memset(view, 0, sizeof *view);
+    if (!file_map_open(&map, path)) return 0;
+
+    if (map.size >= sizeof AIG_LEGACY_MAGIC &&
+        !memcmp(map.data, AIG_LEGACY_MAGIC, sizeof AIG_LEGACY_MAGIC))
+    {
+        ok = graph_file_parse_legacy(map.data, map.size, view);
+        file_map_close(&map);
+        return ok;
+    }
+
+    if (map.size >= sizeof(struct aig_header) &&
+        !memcmp(map.data, AIG_MAGIC, sizeof AIG_MAGIC) &&
+        (SDL_SwapLE32(((struct aig_header*)map.data)->flags) & AIG_FLAG_LZ))
+    {
+        size_t size;
+        void *image = graph_file_unpack(map.data, map.size, &size);
+        file_map_close(&map);
+        if (!image) return 0;
+        if (!graph_file_parse(image, size, view)) { free(image); return 0; }
+        view->storage = image;
+        view->storage_size = size;
+        view->compressed = 1;
+        return 1;
+    }
+
+    if (!graph_file_parse(map.data, map.size, view))
+    {
+        file_map_close(&map);
+        return 0;
+    }
+    view->map = map;
+    return 1;
+}
+
+/*
+ * Checks every record against the node config: type indices, node ids and
+ * slots in range, at most one link per input. Returns 0 and sets the SDL error
+ * on the first violation.
+ */
+static int
+graph_view_validate(struct graph_view *view, struct config *conf)
+{
+    int *input_base = NULL;
+    char *linked = NULL;
+    int inputs = 0, result = 0;
+
+    input_base = malloc((view->node_count + 1) * sizeof *input_base);
+    if (!input_base) { SDL_SetError("out of memory"); return 0; }
+
+    for (int i = 0; i < view->node_count; ++i)
+    {
+        int type = view->nodes[i].type;
+        if (type < 0 || type >= conf->node_count)
+        {
+            SDL_SetError("node %d: unknown type %d", i, type);
+            goto cleanup;
+        }
+        input_base[i] = inputs;
+        inputs += conf->nodes[type].input_count;
+    }
+    input_base[view->node_count] = inputs;
+
+    linked = calloc(inputs ? inputs : 1, 1);
+    if (!linked) { SDL_SetError("out of memory"); goto cleanup; }
+
+    for (int i = 0; i < view->link_count; ++i)
+    {
+        struct aig_link *l = &view->links[i];
+        if (l->in_id < 0 || l->in_id >= view->node_count ||
+            l->out_id < 0 || l->out_id >= view->node_count || l->in_id == l->out_id ||
+            l->in_slot < 0 || l->in_slot >= conf->nodes[view->nodes[l->in_id].type].output_count ||
+            l->out_slot < 0 || l->out_slot >= conf->nodes[view->nodes[l->out_id].type].input_count ||
+            linked[input_base[l->out_id] + l->out_slot]++)
+        {
+            SDL_SetError("link %d is invalid", i);
+            goto cleanup;
+        }
+    }
+
+    for (int i = 0; i < view->const_count; ++i)
+    {
+        struct aig_const *c = &view->consts[i];
+        if (c->node_id < 0 || c->node_id >= view->node_count ||
+            c->slot < 0 || c->slot >= conf->nodes[view->nodes[c->node_id].type].input_count)
+        {
+            SDL_SetError("const %d is invalid", i);
+            goto cleanup;
+        }
+    }
+
+    for (int i = 0; i < view->prop_count; ++i)
+    {
+        struct aig_prop *p = &view->props[i];
+        struct property_info *info;
+        if (p->node_id < 0 || p->node_id >= view->node_count ||
+            p->slot < 0 || p->slot >= conf->nodes[view->nodes[p->node_id].type].prop_count)
+        {
+            SDL_SetError("property %d is invalid", i);
+            goto cleanup;
+        }
+        /* the editor indexes the enum's value names with it */
+        info = &conf->nodes[view->nodes[p->node_id].type].props[p->slot];
+        if (info->type == FIELD_ENUM && (p->value < 0 || p->value >= conf->enums[info->enum_type].count))
+        {
+            SDL_SetError("property %d is invalid", i);
+            goto cleanup;
+        }
+    }
+
+    result = 1;
+
+cleanup:
+    free(linked);
+    free(input_base);
+    return result;
+}
+
+#endif
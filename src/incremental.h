@@ -0,0 +1,387 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_error.h>
+#include "compiler.h"
+
+/*
+ * Change-driven evaluation of compiled graphs, for crowds whose inputs
+ * mostly stay the same from tick to tick. Every agent keeps its values
+ * from the last tick, so the program is renamed once into slots, one per
+ * value where it shares registers: the constants, the uniform prologue's
+ * results, then every output of the per-agent instructions. Those
+ * instructions are cut into blocks of INCREMENTAL_BLOCK in program order;
+ * a block runs only if a slot or agent input it reads from outside
+ * changed since the agent's last tick, and its outputs only count as
+ * changed when their bits differ. Side effects are replayed from the
+ * slots afterwards, in instruction order, so the events are exactly
+ * compiled_graph_run's. An agent whose inputs and globals haven't changed
+ * costs their comparison and its events. Kernels not marked KERNEL_PURE
+ * read a pseudo-slot that changes every tick, so they always run and an
+ * agent that has one is never idle.
+ *
+ * Tracking changes costs a few times what running an instruction does, so
+ * when changes have lately reached more than 1/INCREMENTAL_DENSE of the
+ * program, changed agents run all of it untracked instead, and only every
+ * INCREMENTAL_PROBE-th of them is tracked, to notice when that stops.
+ *
+ * Change marks are stamps of the run that made them, kept in the struct
+ * incremental so nothing needs clearing between agents; use one per
+ * thread.
+ */
+
+#define INCREMENTAL_BLOCK 16    /* instructions per block */
+#define INCREMENTAL_DENSE 4
+#define INCREMENTAL_PROBE 16
+
+struct incremental
+{
+    struct compiled_graph *g;
+    uint32_t slot_count;        /* per agent, followed by its input_count inputs */
+    uint32_t first;             /* first per-agent instruction */
+    uint32_t *arg_base;         /* per per-agent instruction and one past, its run of `args` */
+    uint32_t *args;             /* operands renamed to slots */
+    uint32_t *dst;              /* per per-agent instruction, its first output slot */
+    uint32_t *output_count;     /* per per-agent instruction */
+    uint32_t block_count;
+    uint32_t *read_base;        /* per block and one past, its run of `reads` */
+    uint32_t *reads;            /* slots, and inputs as slot_count + index, blocks read from outside */
+    uint32_t *effects;          /* side-effect instructions in program order */
+    uint32_t effect_count;
+    char *impure;               /* per per-agent instruction, a kernel without KERNEL_PURE */
+    uint32_t impure_count;
+    /* scratch */
+    uint32_t *stamps;           /* per slot and input, the run that last changed it */
+    uint32_t run;
+    float *saved;               /* the outputs of the instruction being run, from before */
+    int dense;                  /* whether the last tracked change reached much of the program */
+    uint32_t untracked;         /* changed agents run untracked since the last tracked one */
+    /* counters */
+    uint64_t ticks, idle_ticks, blocks_run, blocks_skipped, instructions_run, instructions_skipped;
+};
+
+/* an agent's state between ticks */
+struct incremental_agent
+{
+    float *values;      /* slot_count slots, then input_count inputs */
+    int primed;         /* whether it has run, until then everything counts as changed */
+};
+
+static void
+incremental_free(struct incremental *inc)
+{
+    free(inc->arg_base);
+    free(inc->args);
+    free(inc->dst);
+    free(inc->output_count);
+    free(inc->read_base);
+    free(inc->reads);
+    free(inc->effects);
+    free(inc->impure);
+    free(inc->stamps);
+    free(inc->saved);
+    memset(inc, 0, sizeof *inc);
+}
+
+/*
+ * Renames the per-agent instructions of linked program `g` into slots and
+ * finds what each block reads. Returns 0 and sets the SDL error when out
+ * of memory.
+ */
+static int
+incremental_init(struct incremental *inc, struct compiled_graph *g, struct config *conf)
+{
+    struct aigc_header *h = g->header;
+    uint32_t m = h->instruction_count - h->uniform_count, next, max_outputs = 0, read_count = 0;
+    uint32_t *current = malloc((h->register_count + 1) * sizeof *current);
+    uint32_t *owner = NULL;
+
+    memset(inc, 0, sizeof *inc);
+    inc->g = g;
+    inc->first = h->uniform_count;
+    inc->block_count = (m + INCREMENTAL_BLOCK - 1) / INCREMENTAL_BLOCK;
+    inc->arg_base = malloc((m + 1) * sizeof *inc->arg_base);
+    inc->dst = malloc((m + 1) * sizeof *inc->dst);
+    inc->output_count = malloc((m + 1) * sizeof *inc->output_count);
+    inc->read_base = malloc((inc->block_count + 1) * sizeof *inc->read_base);
+    inc->effects = malloc((m + 1) * sizeof *inc->effects);
+    inc->impure = calloc(m + 1, 1);
+    if (!current || !inc->arg_base || !inc->dst || !inc->output_count || !inc->read_base || !inc->effects ||
+        !inc->impure)
+        goto oom;
+
+    inc->arg_base[0] = 0;
+    inc->slot_count = h->const_count + g->uniform_register_count;
+    for (uint32_t k = 0; k < m; ++k)
+    {
+        struct aigc_instruction *in = &g->instructions[inc->first + k];
+        int outputs = in->op == OP_KERNEL ? conf->nodes[in->type].output_count : aigc_ops[in->op].outputs;
+        inc->arg_base[k + 1] = inc->arg_base[k] + in->arg_count;
+        inc->output_count[k] = (uint32_t)outputs;
+        inc->slot_count += (uint32_t)outputs;
+        if ((uint32_t)outputs > max_outputs) max_outputs = (uint32_t)outputs;
+        if (aigc_ops[in->op].side_effect) inc->effects[inc->effect_count++] = inc->first + k;
+        if (in->op == OP_KERNEL && !(conf->nodes[in->type].kernels->flags & KERNEL_PURE))
+        {
+            inc->impure[k] = 1;
+            ++inc->impure_count;
+        }
+        /* inputs and the impure pseudo-slot are reads too */
+        read_count += in->arg_count + (in->op == OP_INPUT || in->op == AIGC_OP_ADD_INPUT) + inc->impure[k];
+    }
+    inc->args = malloc((inc->arg_base[m] + 1) * sizeof *inc->args);
+    inc->reads = malloc((read_count + 1) * sizeof *inc->reads);
+    inc->stamps = calloc(inc->slot_count + h->input_count + 1, sizeof *inc->stamps);
+    inc->saved = malloc((max_outputs + 1) * sizeof *inc->saved);
+    owner = malloc((inc->slot_count + h->input_count + 1) * sizeof *owner);
+    if (!inc->args || !inc->reads || !inc->stamps || !inc->saved || !owner) goto oom;
+
+    /* constants keep their registers, the prologue's results follow */
+    for (uint32_t r = 0; r < h->register_count; ++r) current[r] = r < h->const_count ? r : AIGC_NO_REGISTER;
+    for (uint32_t j = 0; j < g->uniform_register_count; ++j) current[g->uniform_registers[j]] = h->const_count + j;
+    next = h->const_count + g->uniform_register_count;
+    for (uint32_t k = 0; k < m; ++k)
+    {
+        struct aigc_instruction *in = &g->instructions[inc->first + k];
+        for (uint32_t j = 0; j < in->arg_count; ++j) inc->args[inc->arg_base[k] + j] = current[g->operands[in->args + j]];
+        inc->dst[k] = inc->output_count[k] ? next : AIGC_NO_REGISTER;
+        for (uint32_t o = 0; o < inc->output_count[k]; ++o) current[in->dst + o] = next++;
+    }
+
+    /* per block, what it reads from outside: not constants, nor its own outputs, each once */
+    for (uint32_t s = 0; s <= inc->slot_count + h->input_count; ++s) owner[s] = UINT32_MAX;
+    read_count = 0;
+    for (uint32_t b = 0; b < inc->block_count; ++b)
+    {
+        uint32_t end = SDL_min((b + 1) * INCREMENTAL_BLOCK, m);
+        inc->read_base[b] = read_count;
+        for (uint32_t k = b * INCREMENTAL_BLOCK; k < end; ++k)
+        {
+            struct aigc_instruction *in = &g->instructions[inc->first + k];
+            for (uint32_t j = 0; j <= in->arg_count; ++j)
+            {
+                uint32_t s;
+                if (j < in->arg_count) s = inc->args[inc->arg_base[k] + j];
+                else if (in->op == OP_INPUT || in->op == AIGC_OP_ADD_INPUT) s = inc->slot_count + g->props[in->props];
+                else if (inc->impure[k]) s = inc->slot_count + h->input_count;
+                else break;
+                if (s < h->const_count || owner[s] == b) continue;
+                /* marks reads and outputs alike, outputs are only ever read after */
+                owner[s] = b;
+                inc->reads[read_count++] = s;
+            }
+            for (uint32_t o = 0; o < inc->output_count[k]; ++o) owner[inc->dst[k] + o] = b;
+        }
+    }
+    inc->read_base[inc->block_count] = read_count;
+    free(current);
+    free(owner);
+    return 1;
+
+oom:
+    SDL_SetError("out of memory");
+    free(current);
+    free(owner);
+    incremental_free(inc);
+    return 0;
+}
+
+/* sets up an agent that hasn't run yet; returns 0 when out of memory */
+static int
+incremental_agent_init(struct incremental *inc, struct incremental_agent *agent)
+{
+    agent->primed = 0;
+    agent->values = calloc(inc->slot_count + inc->g->header->input_count + 1, sizeof *agent->values);
+    if (!agent->values) return 0;
+    memcpy(agent->values, inc->g->consts, inc->g->header->const_count * sizeof *agent->values);
+    return 1;
+}
+
+static void
+incremental_agent_free(struct incremental_agent *agent)
+{
+    free(agent->values);
+    agent->values = NULL;
+}
+
+/* copies `value` into slot `s` and stamps it if its bits differ; returns whether they did */
+static int
+incremental_update(struct incremental *inc, float *values, uint32_t s, const float *value)
+{
+    if (!memcmp(&values[s], value, sizeof *value)) return 0;
+    values[s] = *value;
+    inc->stamps[s] = inc->run;
+    return 1;
+}
+
+/* whether a slot or input per-agent instruction `k` reads changed in this run */
+static int
+incremental_changed(struct incremental *inc, uint32_t k)
+{
+    struct aigc_instruction *in = &inc->g->instructions[inc->first + k];
+    const uint32_t *a = inc->args + inc->arg_base[k];
+
+    if (inc->impure[k]) return 1;
+    if (in->op == OP_INPUT || in->op == AIGC_OP_ADD_INPUT)
+        if (inc->stamps[inc->slot_count + inc->g->props[in->props]] == inc->run) return 1;
+    for (uint32_t j = 0; j < in->arg_count; ++j)
+        if (inc->stamps[a[j]] == inc->run) return 1;
+    return 0;
+}
+
+/* runs per-agent instruction `k` on the agent's slots, if `track` stamping the outputs that changed */
+static void
+incremental_step(struct incremental *inc, float *v, uint32_t k, int track)
+{
+    struct compiled_graph *g = inc->g;
+    struct aigc_instruction *in = &g->instructions[inc->first + k];
+    const uint32_t *a = inc->args + inc->arg_base[k];
+    const float *inputs = v + inc->slot_count;
+    const int32_t *props = g->props;
+    uint32_t d = inc->dst[k];
+    float x;
+
+    switch (in->op)
+    {
+        case OP_INPUT:
+            x = inputs[props[in->props]];
+            break;
+        case OP_SUM:
+            x = v[a[0]] + v[a[1]];
+            break;
+        case OP_SUM3:
+            x = v[a[0]] + v[a[1]] + v[a[2]];
+            break;
+        case OP_NEGATE:
+            x = -v[a[0]];
+            break;
+        case AIGC_OP_SUB:
+            x = v[a[0]] - v[a[1]];
+            break;
+        case AIGC_OP_ADD_INPUT:
+            x = v[a[0]] + inputs[props[in->props]];
+            break;
+        case OP_KERNEL:
+        case AIGC_OP_SUM_CHAIN:
+        {
+            uint32_t n = track ? inc->output_count[k] : 0;
+            for (uint32_t o = 0; o < n; ++o) inc->saved[o] = v[d + o];
+            g->calls[inc->first + k](v, a, in->arg_count, d, props + in->props);
+            for (uint32_t o = 0; o < n; ++o)
+                if (memcmp(&inc->saved[o], &v[d + o], sizeof *v)) inc->stamps[d + o] = inc->run;
+            return;
+        }
+        default:
+            /* side effects are replayed after the blocks */
+            return;
+    }
+    if (track) incremental_update(inc, v, d, &x);
+    else v[d] = x;
+}
+
+/* runs the blocks and instructions whose reads changed in this run, returns how many instructions ran */
+static uint32_t
+incremental_run_blocks(struct incremental *inc, float *v)
+{
+    uint32_t m = inc->g->header->instruction_count - inc->first, run = 0;
+
+    for (uint32_t b = 0; b < inc->block_count; ++b)
+    {
+        uint32_t first = b * INCREMENTAL_BLOCK, end = SDL_min(first + INCREMENTAL_BLOCK, m);
+        int dirty = 0;
+        for (uint32_t r = inc->read_base[b]; r < inc->read_base[b + 1] && !dirty; ++r)
+            dirty = inc->stamps[inc->reads[r]] == inc->run;
+        if (!dirty)
+        {
+            ++inc->blocks_skipped;
+            continue;
+        }
+        ++inc->blocks_run;
+        /* within the block, instructions whose own reads didn't change are skipped too */
+        for (uint32_t k = first; k < end; ++k)
+        {
+            if (!incremental_changed(inc, k)) continue;
+            incremental_step(inc, v, k, 1);
+            ++run;
+        }
+    }
+    inc->instructions_run += run;
+    inc->instructions_skipped += m - run;
+    return run;
+}
+
+/*
+ * compiled_graph_run for one agent, running only the blocks whose reads
+ * changed since its last tick. `uniform` is the register file
+ * compiled_graph_run_uniform ran on this tick, NULL if there's no prologue.
+ */
+static int
+incremental_run(struct incremental *inc, struct incremental_agent *agent, const float *uniform, const float *inputs,
+    struct aigc_event *events)
+{
+    struct compiled_graph *g = inc->g;
+    struct aigc_header *h = g->header;
+    const int32_t *props = g->props;
+    float *v = agent->values;
+    uint32_t m = h->instruction_count - inc->first;
+    int changed = !agent->primed || inc->impure_count, event_count = 0;
+
+    if (++inc->run == 0)
+    {
+        memset(inc->stamps, 0, (inc->slot_count + h->input_count + 1) * sizeof *inc->stamps);
+        inc->run = 1;
+    }
+    inc->stamps[inc->slot_count + h->input_count] = inc->run;
+    for (uint32_t j = 0; uniform && j < g->uniform_register_count; ++j)
+        changed |= incremental_update(inc, v, h->const_count + j, &uniform[g->uniform_registers[j]]);
+    for (uint32_t i = 0; i < h->input_count; ++i) changed |= incremental_update(inc, v, inc->slot_count + i, &inputs[i]);
+
+    ++inc->ticks;
+    if (!changed)
+    {
+        ++inc->idle_ticks;
+        inc->blocks_skipped += inc->block_count;
+        inc->instructions_skipped += m;
+    }
+    else if (!agent->primed || (inc->dense && ++inc->untracked < INCREMENTAL_PROBE))
+    {
+        /* everything is recomputed, so nothing downstream needs to know what changed */
+        for (uint32_t k = 0; k < m; ++k) incremental_step(inc, v, k, 0);
+        inc->blocks_run += inc->block_count;
+        inc->instructions_run += m;
+    }
+    else
+    {
+        inc->untracked = 0;
+        inc->dense = (uint64_t)incremental_run_blocks(inc, v) * INCREMENTAL_DENSE > m;
+    }
+    agent->primed = 1;
+
+    for (uint32_t e = 0; e < inc->effect_count; ++e)
+    {
+        struct aigc_instruction *in = &g->instructions[inc->effects[e]];
+        float value = v[inc->args[inc->arg_base[inc->effects[e] - inc->first]]];
+        if (value > 0) AIGC_PLAY_ANIM(value, 0);
+    }
+    return event_count;
+}
+
+static void
+incremental_clear_counters(struct incremental *inc)
+{
+    inc->ticks = inc->idle_ticks = 0;
+    inc->blocks_run = inc->blocks_skipped = 0;
+    inc->instructions_run = inc->instructions_skipped = 0;
+}
+
+/* share of per-agent instructions skipped since the counters were cleared, 0 to 1 */
+static double
+incremental_skip_rate(struct incremental *inc)
+{
+    uint64_t total = inc->instructions_run + inc->instructions_skipped;
+    return total ? (double)inc->instructions_skipped / total : 0;
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_cpuinfo.h>
+
+/*
+ * Fixed pool of worker threads running parallel loops. jobs_run hands out
+ * loop indices through an atomic counter, so uneven items balance
+ * themselves, and the calling thread works on the loop too. Workers sleep
+ * on a condition variable between loops.
+ */
+
+/* `worker` is in [0, jobs_worker_count(pool)) and can index per-thread scratch */
+typedef void (*job_func)(void *user, int index, int worker);
+
+struct job_pool
+{
+    SDL_Thread **threads;
+    int thread_count;
+    SDL_mutex *lock;
+    SDL_cond *wake, *finished;
+    job_func func;
+    void *user;
+    int count;
+    SDL_atomic_t next;
+    int generation;     /* bumped for every loop, workers wait for a change */
+    int busy;           /* workers still on the current loop */
+    int quit;
+};
+
+struct job_worker
+{
+    struct job_pool *pool;
+    int index;
+};
+
+static void
+jobs_work(struct job_pool *pool, int worker)
+{
+    int i;
+    while ((i = SDL_AtomicAdd(&pool->next, 1)) < pool->count)
+        pool->func(pool->user, i, worker);
+}
+
+static int SDLCALL
+jobs_thread(void *data)
+{
+    struct job_worker *w = data;
+    struct job_pool *pool = w->pool;
+    int seen = 0;
+
+    SDL_LockMutex(pool->lock);
+    for (;;)
+    {
+        while (pool->generation == seen && !pool->quit) SDL_CondWait(pool->wake, pool->lock);
+        if (pool->quit) break;
+        seen = pool->generation;
+        SDL_UnlockMutex(pool->lock);
+
+        jobs_work(pool, w->index);
+
+        SDL_LockMutex(pool->lock);
+        if (--pool->busy == 0) SDL_CondSignal(pool->finished);
+    }
+    SDL_UnlockMutex(pool->lock);
+    free(w);
+    return 0;
+}
+
+/* starts `thread_count` workers, or one per extra core when it is negative */
+static int
+jobs_init(struct job_pool *pool, int thread_count)
+{
+    memset(pool, 0, sizeof *pool);
+    if (thread_count < 0) thread_count = SDL_GetCPUCount() - 1;
+    pool->lock = SDL_CreateMutex();
+    pool->wake = SDL_CreateCond();
+    pool->finished = SDL_CreateCond();
+    pool->threads = calloc(thread_count > 0 ? thread_count : 1, sizeof *pool->threads);
+    if (!pool->lock || !pool->wake || !pool->finished || !pool->threads) return 0;
+
+    for (int i = 0; i < thread_count; ++i)
+    {
+        struct job_worker *w = malloc(sizeof *w);
+        if (!w) break;
+        w->pool = pool;
+        w->index = i;
+        pool->threads[i] = SDL_CreateThread(jobs_thread, "worker", w);
+        if (!pool->threads[i]) { free(w); break; }
+        ++pool->thread_count;
+    }
+    return 1;
+}
+
+/* workers plus the calling thread */
+static int
+jobs_worker_count(struct job_pool *pool)
+{
+    return pool->thread_count + 1;
+}
+
+/* calls `func` for every index in [0, count) across the pool and waits for all of them */
+static void
+jobs_run(struct job_pool *pool, int count, job_func func, void *user)
+{
+    if (count <= 0) return;
+    if (!pool->thread_count || count == 1)
+    {
+        for (int i = 0; i < count; ++i) func(user, i, pool->thread_count);
+        return;
+    }
+
+    SDL_LockMutex(pool->lock);
+    pool->func = func;
+    pool->user = user;
+    pool->count = count;
+    SDL_AtomicSet(&pool->next, 0);
+    pool->busy = pool->thread_count;
+    ++pool->generation;
+    SDL_CondBroadcast(pool->wake);
+    SDL_UnlockMutex(pool->lock);
+
+    jobs_work(pool, pool->thread_count);
+
+    SDL_LockMutex(pool->lock);
+    while (pool->busy) SDL_CondWait(pool->finished, pool->lock);
+    SDL_UnlockMutex(pool->lock);
+}
+
+static void
+jobs_cleanup(struct job_pool *pool)
+{
+    if (pool->lock)
+    {
+        SDL_LockMutex(pool->lock);
+        pool->quit = 1;
+        SDL_CondBroadcast(pool->wake);
+        SDL_UnlockMutex(pool->lock);
+    }
+    for (int i = 0; i < pool->thread_count; ++i) SDL_WaitThread(pool->threads[i], NULL);
+    free(pool->threads);
+    if (pool->finished) SDL_DestroyCond(pool->finished);
+    if (pool->wake) SDL_DestroyCond(pool->wake);
+    if (pool->lock) SDL_DestroyMutex(pool->lock);
+    memset(pool, 0, sizeof *pool);
+}
+
+#endif
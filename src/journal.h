@@ -0,0 +1,322 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <SDL2/SDL_endian.h>
+#include <SDL2/SDL_timer.h>
+#include "save_job.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/*
+ * Append-only edit journal. Every edit made after a snapshot is appended as a
+ * fixed-size record to '<base>.<generation % 2>.aij'; loading the snapshot
+ * with the same generation and replaying the journal restores the graph.
+ *
+ * Compaction writes a new snapshot with generation + 1 while edits keep going
+ * to both the current and the next journal, so whichever snapshot survives a
+ * crash always has a matching journal on disk.
+ *
+ * File layout (little-endian): magic "aigjrnl\0", u32 version, u32 generation,
+ * then struct journal_record until the end of the file. A torn last record
+ * is ignored.
+ */
+
+#define JOURNAL_MAGIC "aigjrnl"
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 16
+#define JOURNAL_FLUSH_INTERVAL 1000 /* ms */
+#define JOURNAL_COMPACT_MIN_BYTES (1 << 20)
+
+enum journal_op
+{
+    JOURNAL_ADD = 1,    /* type, x, y */
+    JOURNAL_DELETE,     /* node id */
+    JOURNAL_LINK,       /* in_id, in_slot, out_id, out_slot */
+    JOURNAL_UNLINK,     /* in_id, in_slot, out_id, out_slot */
+    JOURNAL_CONST,      /* node id, slot, value */
+    JOURNAL_PROP,       /* node id, slot, value */
+    JOURNAL_MOVE        /* node id, x, y */
+};
+
+struct journal_record
+{
+    uint32_t op;
+    int32_t args[4];
+};
+
+struct journal_file
+{
+    FILE *file;
+    char *path;
+    size_t size;
+};
+
+struct journal
+{
+    char *base;             /* snapshot path without the .aig extension */
+    uint32_t generation;    /* generation of the snapshot `current` applies to */
+    int compress;           /* compaction snapshots are LZ-compressed */
+    struct journal_file current, next;
+    struct journal_record *pending;
+    int pending_count, pending_capacity;
+    int last_move;          /* index of a pending MOVE that can be coalesced, or -1 */
+    Uint32 last_flush;
+};
+
+static inline int32_t
+journal_float(float f)
+{
+    int32_t i;
+    memcpy(&i, &f, sizeof i);
+    return i;
+}
+
+static inline float
+journal_to_float(int32_t i)
+{
+    float f;
+    memcpy(&f, &i, sizeof f);
+    return f;
+}
+
+static char*
+journal_path(const char *base, uint32_t generation)
+{
+    size_t size = strlen(base) + 16;
+    char *path = malloc(size);
+    snprintf(path, size, "%s.%u.aij", base, generation % 2);
+    return path;
+}
+
+static void
+journal_swap_records(struct journal_record *records, int count)
+{
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    uint32_t *w = (uint32_t*)records;
+    for (size_t i = 0; i < count * sizeof *records / 4; ++i) w[i] = SDL_SwapLE32(w[i]);
+#else
+    (void)records; (void)count;
+#endif
+}
+
+static int
+journal_sync(FILE *f)
+{
+    if (fflush(f)) return 0;
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+/*
+ * (Re)creates a journal file holding `count` records and keeps it open for
+ * appending. The file is written durably beside the old one and renamed
+ * over it, so until then the old journal, which may hold the only copy of
+ * recovered edits, stays intact.
+ */
+static int
+journal_file_create(struct journal_file *jf, const char *base, uint32_t generation,
+    const struct journal_record *records, int count)
+{
+    size_t size = JOURNAL_HEADER_SIZE + count * sizeof *records;
+    char *data = malloc(size), error[256];
+    uint32_t version = SDL_SwapLE32(JOURNAL_VERSION), gen = SDL_SwapLE32(generation);
+    int ok;
+
+    memset(jf, 0, sizeof *jf);
+    jf->path = journal_path(base, generation);
+    if (!data || !jf->path)
+    {
+        free(data);
+        free(jf->path);
+        jf->path = NULL;
+        return 0;
+    }
+
+    memcpy(data, JOURNAL_MAGIC, 8);
+    memcpy(data + 8, &version, 4);
+    memcpy(data + 12, &gen, 4);
+    if (count) memcpy(data + JOURNAL_HEADER_SIZE, records, count * sizeof *records);
+    journal_swap_records((struct journal_record*)(data + JOURNAL_HEADER_SIZE), count);
+    ok = file_write_durable(jf->path, data, size, error, sizeof error);
+    free(data);
+
+    if (ok) jf->file = fopen(jf->path, "ab");
+    if (!jf->file)
+    {
+        free(jf->path);
+        jf->path = NULL;
+        return 0;
+    }
+    jf->size = count * sizeof *records;
+    return 1;
+}
+
+static void
+journal_file_close(struct journal_file *jf, int remove_file)
+{
+    if (jf->file) fclose(jf->file);
+    if (remove_file && jf->path) remove(jf->path);
+    free(jf->path);
+    memset(jf, 0, sizeof *jf);
+}
+
+/*
+ * Reads the journal for the snapshot `base` at `generation`. A missing file or
+ * one belonging to another generation yields zero records. Returns 0 only on
+ * allocation failure.
+ */
+static int
+journal_read(const char *base, uint32_t generation, struct journal_record **records, int *count)
+{
+    char *path = journal_path(base, generation);
+    FILE *f = fopen(path, "rb");
+    char header[JOURNAL_HEADER_SIZE];
+    uint32_t version, gen;
+    long size;
+
+    *records = NULL;
+    *count = 0;
+    free(path);
+    if (!f) return 1;
+
+    if (fread(header, sizeof header, 1, f) != 1 || memcmp(header, JOURNAL_MAGIC, 8))
+    {
+        fclose(f);
+        return 1;
+    }
+    memcpy(&version, header + 8, 4);
+    memcpy(&gen, header + 12, 4);
+    if (SDL_SwapLE32(version) != JOURNAL_VERSION || SDL_SwapLE32(gen) != generation)
+    {
+        fclose(f);
+        return 1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f) - (long)sizeof header;
+    fseek(f, sizeof header, SEEK_SET);
+    *count = (int)(size / sizeof **records);
+    *records = malloc((*count ? *count : 1) * sizeof **records);
+    if (!*records) { fclose(f); *count = 0; return 0; }
+    *count = (int)fread(*records, sizeof **records, *count, f);
+    journal_swap_records(*records, *count);
+    fclose(f);
+    return 1;
+}
+
+static void
+journal_init(struct journal *j, const char *base, uint32_t generation, int compress)
+{
+    memset(j, 0, sizeof *j);
+    j->base = _strdup(base);
+    j->generation = generation;
+    j->compress = compress;
+    j->last_move = -1;
+    j->last_flush = SDL_GetTicks();
+}
+
+static void
+journal_append(struct journal *j, enum journal_op op, int32_t a, int32_t b, int32_t c, int32_t d)
+{
+    struct journal_record *r;
+
+    /* a drag produces a move every frame, only the last position matters */
+    if (op == JOURNAL_MOVE && j->last_move >= 0 && j->pending[j->last_move].args[0] == a)
+    {
+        j->pending[j->last_move].args[1] = b;
+        j->pending[j->last_move].args[2] = c;
+        return;
+    }
+
+    if (j->pending_count == j->pending_capacity)
+    {
+        int new_capacity = j->pending_capacity ? 2 * j->pending_capacity : 64;
+        j->pending = realloc(j->pending, new_capacity * sizeof *j->pending);
+        j->pending_capacity = new_capacity;
+    }
+    r = &j->pending[j->pending_count];
+    r->op = op;
+    r->args[0] = a;
+    r->args[1] = b;
+    r->args[2] = c;
+    r->args[3] = d;
+    j->last_move = op == JOURNAL_MOVE ? j->pending_count : -1;
+    ++j->pending_count;
+}
+
+static int
+journal_file_append(struct journal_file *jf, struct journal_record *records, int count)
+{
+    if (!jf->file) return 1;
+    if (fwrite(records, sizeof *records, count, jf->file) != (size_t)count) return 0;
+    jf->size += count * sizeof *records;
+    return journal_sync(jf->file);
+}
+
+/* writes pending records to the open journal files and syncs them */
+static int
+journal_flush(struct journal *j)
+{
+    int ok = 1;
+    j->last_flush = SDL_GetTicks();
+    if (!j->pending_count) return 1;
+    journal_swap_records(j->pending, j->pending_count);
+    ok = journal_file_append(&j->current, j->pending, j->pending_count) && ok;
+    ok = journal_file_append(&j->next, j->pending, j->pending_count) && ok;
+    j->pending_count = 0;
+    j->last_move = -1;
+    return ok;
+}
+
+static int
+journal_should_flush(struct journal *j)
+{
+    return j->pending_count && SDL_GetTicks() - j->last_flush >= JOURNAL_FLUSH_INTERVAL;
+}
+
+/* starts journaling into the next generation, called when its snapshot is taken */
+static int
+journal_begin_rotation(struct journal *j)
+{
+    journal_flush(j);
+    return journal_file_create(&j->next, j->base, j->generation + 1, NULL, 0);
+}
+
+/* the next generation's snapshot is on disk: retire the current journal */
+static void
+journal_commit_rotation(struct journal *j)
+{
+    journal_file_close(&j->current, 1);
+    j->current = j->next;
+    memset(&j->next, 0, sizeof j->next);
+    ++j->generation;
+}
+
+/* the snapshot failed: drop the next journal, the current one is still complete */
+static void
+journal_abort_rotation(struct journal *j)
+{
+    journal_file_close(&j->next, 1);
+}
+
+static void
+journal_cleanup(struct journal *j)
+{
+    journal_flush(j);
+    journal_file_close(&j->current, 0);
+    journal_file_close(&j->next, 0);
+    free(j->pending);
+    free(j->base);
+    memset(j, 0, sizeof *j);
+}
+
+#endif
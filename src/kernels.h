@@ -0,0 +1,213 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "aigraph.h"
+
+/*
+ * Native node kernels, and the interface plugin libraries register node
+ * types through. This header is the plugin ABI: it needs nothing but
+ * aigraph.h, so a plugin includes these two and nothing else.
+ *
+ * A kernel works on a compiled graph's register file. `args` holds the
+ * registers of the node's inputs, its outputs go to registers dst, dst + 1,
+ * ... and `props` are the node's property values. The scalar kernel
+ * evaluates one agent; the batch kernel evaluates `count` agents whose
+ * register files are laid out SoA, register k of agent i at
+ * r[k * stride + i], so each input and output is a contiguous row the
+ * compiler can vectorize over.
+ *
+ * A kernel set can serve node types of different arity (sum and sum3 share
+ * one); the arity slots hold optional specializations for a given input
+ * count and the generic kernels handle any other.
+ *
+ * Kernels marked KERNEL_PURE promise their outputs depend on nothing but
+ * their inputs and properties, and that they have no other effect. Only
+ * those are run by the compiler to fold constant inputs (and then only
+ * with at least one input), shared between duplicate nodes, hoisted into
+ * the uniform prologue or skipped when their inputs didn't change; any
+ * other kernel, a random number or a clock, runs for every agent on every
+ * tick.
+ */
+
+#define KERNEL_MAX_ARITY 8
+
+enum kernel_flags { KERNEL_PURE = 1 };
+
+typedef void (*node_kernel)(float *r, const uint32_t *args, uint32_t arg_count, uint32_t dst,
+    const int32_t *props);
+typedef void (*node_batch_kernel)(float *r, size_t stride, size_t count, const uint32_t *args,
+    uint32_t arg_count, uint32_t dst, const int32_t *props);
+
+struct node_kernels
+{
+    node_kernel scalar;
+    node_batch_kernel batch;
+    node_kernel scalar_arity[KERNEL_MAX_ARITY + 1];
+    node_batch_kernel batch_arity[KERNEL_MAX_ARITY + 1];
+    uint32_t flags;     /* enum kernel_flags */
+};
+
+static node_kernel
+kernels_scalar(const struct node_kernels *k, uint32_t arity)
+{
+    if (arity <= KERNEL_MAX_ARITY && k->scalar_arity[arity]) return k->scalar_arity[arity];
+    return k->scalar;
+}
+
+static node_batch_kernel
+kernels_batch(const struct node_kernels *k, uint32_t arity)
+{
+    if (arity <= KERNEL_MAX_ARITY && k->batch_arity[arity]) return k->batch_arity[arity];
+    return k->batch;
+}
+
+/*
+ * Plugins export AIGRAPH_PLUGIN_ENTRY, a plugin_register_func, which is
+ * called once with the host's registry. add_enum returns the index a
+ * property_info's enum_type refers to; add_node takes a type whose op is
+ * OP_KERNEL and whose kernels are set. Both return -1 when the host refuses
+ * the type, and everything passed in must stay valid while the plugin is
+ * loaded. A plugin returns 0 to fail its load, and should when the
+ * registry's version isn't the AIGRAPH_PLUGIN_VERSION it was built with.
+ */
+
+#define AIGRAPH_PLUGIN_VERSION 2
+#define AIGRAPH_PLUGIN_ENTRY "aigraph_plugin_register"
+
+struct plugin_registry
+{
+    int version;
+    void *host;
+    int (*add_enum)(struct plugin_registry *reg, const struct enum_info *info);
+    int (*add_node)(struct plugin_registry *reg, const struct node_info *info);
+};
+
+typedef int (*plugin_register_func)(struct plugin_registry *reg);
+
+/*
+ * Kernels of the built-in arithmetic ops, so batches run them like any
+ * other. Sums add left to right, starting from the first input rather than
+ * 0 so -0 stays -0; that is what lets the compiler fuse sum chains without
+ * changing a result.
+ */
+
+static void
+kernel_sum(float *r, const uint32_t *a, uint32_t n, uint32_t dst, const int32_t *props)
+{
+    float sum = r[a[0]];
+    (void)props;
+    for (uint32_t k = 1; k < n; ++k) sum += r[a[k]];
+    r[dst] = sum;
+}
+
+static void
+kernel_sum2(float *r, const uint32_t *a, uint32_t n, uint32_t dst, const int32_t *props)
+{
+    (void)n; (void)props;
+    r[dst] = r[a[0]] + r[a[1]];
+}
+
+static void
+kernel_sum3(float *r, const uint32_t *a, uint32_t n, uint32_t dst, const int32_t *props)
+{
+    (void)n; (void)props;
+    r[dst] = r[a[0]] + r[a[1]] + r[a[2]];
+}
+
+static void
+kernel_negate(float *r, const uint32_t *a, uint32_t n, uint32_t dst, const int32_t *props)
+{
+    (void)n; (void)props;
+    r[dst] = -r[a[0]];
+}
+
+static void
+kernel_sub(float *r, const uint32_t *a, uint32_t n, uint32_t dst, const int32_t *props)
+{
+    (void)n; (void)props;
+    r[dst] = r[a[0]] - r[a[1]];
+}
+
+#define KERNEL_ROW(k) (r + (size_t)(k) * stride)
+
+static void
+kernel_sum_batch(float *r, size_t stride, size_t count, const uint32_t *a, uint32_t n, uint32_t dst,
+    const int32_t *props)
+{
+    float *out = KERNEL_ROW(dst);
+    const float *first = KERNEL_ROW(a[0]);
+    (void)props;
+    for (size_t i = 0; i < count; ++i) out[i] = first[i];
+    for (uint32_t k = 1; k < n; ++k)
+    {
+        const float *in = KERNEL_ROW(a[k]);
+        for (size_t i = 0; i < count; ++i) out[i] += in[i];
+    }
+}
+
+static void
+kernel_sum2_batch(float *r, size_t stride, size_t count, const uint32_t *a, uint32_t n, uint32_t dst,
+    const int32_t *props)
+{
+    float *out = KERNEL_ROW(dst);
+    const float *x = KERNEL_ROW(a[0]), *y = KERNEL_ROW(a[1]);
+    (void)n; (void)props;
+    for (size_t i = 0; i < count; ++i) out[i] = x[i] + y[i];
+}
+
+static void
+kernel_sum3_batch(float *r, size_t stride, size_t count, const uint32_t *a, uint32_t n, uint32_t dst,
+    const int32_t *props)
+{
+    float *out = KERNEL_ROW(dst);
+    const float *x = KERNEL_ROW(a[0]), *y = KERNEL_ROW(a[1]), *z = KERNEL_ROW(a[2]);
+    (void)n; (void)props;
+    for (size_t i = 0; i < count; ++i) out[i] = x[i] + y[i] + z[i];
+}
+
+static void
+kernel_negate_batch(float *r, size_t stride, size_t count, const uint32_t *a, uint32_t n, uint32_t dst,
+    const int32_t *props)
+{
+    float *out = KERNEL_ROW(dst);
+    const float *x = KERNEL_ROW(a[0]);
+    (void)n; (void)props;
+    for (size_t i = 0; i < count; ++i) out[i] = -x[i];
+}
+
+static void
+kernel_sub_batch(float *r, size_t stride, size_t count, const uint32_t *a, uint32_t n, uint32_t dst,
+    const int32_t *props)
+{
+    float *out = KERNEL_ROW(dst);
+    const float *x = KERNEL_ROW(a[0]), *y = KERNEL_ROW(a[1]);
+    (void)n; (void)props;
+    for (size_t i = 0; i < count; ++i) out[i] = x[i] - y[i];
+}
+
+static const struct node_kernels sum_kernels =
+{
+    .scalar = kernel_sum, .batch = kernel_sum_batch,
+    .scalar_arity = { [2] = kernel_sum2, [3] = kernel_sum3 },
+    .batch_arity = { [2] = kernel_sum2_batch, [3] = kernel_sum3_batch },
+    .flags = KERNEL_PURE,
+};
+
+static const struct node_kernels negate_kernels = { .scalar = kernel_negate, .batch = kernel_negate_batch, .flags = KERNEL_PURE };
+static const struct node_kernels sub_kernels = { .scalar = kernel_sub, .batch = kernel_sub_batch, .flags = KERNEL_PURE };
+
+/* kernels of a built-in op, NULL for ops that touch more than registers (agent inputs, events) */
+static const struct node_kernels*
+builtin_kernels(node_op op)
+{
+    switch (op)
+    {
+        case OP_SUM: case OP_SUM3: return &sum_kernels;
+        case OP_NEGATE: return &negate_kernels;
+        default: return NULL;
+    }
+}
+
+#endif
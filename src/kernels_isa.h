@@ -0,0 +1,182 @@
+#ifndef KERNELS_ISA_H
+#define KERNELS_ISA_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_cpuinfo.h>
+#include "kernels.h"
+
+/*
+ * Instruction set variants of the built-in batch kernels. The binary is
+ * built for the lowest ISA we ship to, and on x86 the kernels are also
+ * compiled for AVX2 and AVX-512 through intrinsics (with per-function
+ * target attributes where the compiler needs them). The best variant the
+ * CPU supports is chosen once, on first use; the AIGRAPH_ISA environment
+ * variable ("base", "avx2" or "avx512") asks for a lower one, e.g. to
+ * benchmark. compiled_graph_link binds graphs to the chosen variant.
+ *
+ * Every variant computes the same floats: one add or subtract per element,
+ * negation by flipping the sign bit.
+ */
+
+typedef enum { KERNEL_ISA_BASE, KERNEL_ISA_AVX2, KERNEL_ISA_AVX512, KERNEL_ISA_COUNT } kernel_isa;
+
+static const char *kernel_isa_names[KERNEL_ISA_COUNT] = { "base", "avx2", "avx512" };
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KERNELS_X86 1
+#include <immintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define KERNEL_TARGET_AVX2 __attribute__((target("avx2")))
+#define KERNEL_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define KERNEL_TARGET_AVX2
+#define KERNEL_TARGET_AVX512
+#endif
+
+/*
+ * Defines the batch kernels of one ISA, `W` floats per vector, and their
+ * kernel sets: sum_kernels_<isa>, negate_kernels_<isa>, sub_kernels_<isa>.
+ * The scalar kernels are shared, one agent has nothing to vectorize.
+ */
+#define KERNEL_ISA_DEFINE(isa, TARGET, V, W, LOAD, STORE, ADD, SUB, NEG) \
+    static TARGET void \
+    kernel_sum2_batch_##isa(float *r, size_t stride, size_t count, const uint32_t *a, uint32_t n, uint32_t dst, \
+        const int32_t *props) \
+    { \
+        float *out = KERNEL_ROW(dst); \
+        const float *x = KERNEL_ROW(a[0]), *y = KERNEL_ROW(a[1]); \
+        size_t i = 0; \
+        (void)n; (void)props; \
+        for (; i + W <= count; i += W) STORE(out + i, ADD(LOAD(x + i), LOAD(y + i))); \
+        for (; i < count; ++i) out[i] = x[i] + y[i]; \
+    } \
+    static TARGET void \
+    kernel_sum3_batch_##isa(float *r, size_t stride, size_t count, const uint32_t *a, uint32_t n, uint32_t dst, \
+        const int32_t *props) \
+    { \
+        float *out = KERNEL_ROW(dst); \
+        const float *x = KERNEL_ROW(a[0]), *y = KERNEL_ROW(a[1]), *z = KERNEL_ROW(a[2]); \
+        size_t i = 0; \
+        (void)n; (void)props; \
+        for (; i + W <= count; i += W) STORE(out + i, ADD(ADD(LOAD(x + i), LOAD(y + i)), LOAD(z + i))); \
+        for (; i < count; ++i) out[i] = x[i] + y[i] + z[i]; \
+    } \
+    static TARGET void \
+    kernel_sum_batch_##isa(float *r, size_t stride, size_t count, const uint32_t *a, uint32_t n, uint32_t dst, \
+        const int32_t *props) \
+    { \
+        float *out = KERNEL_ROW(dst); \
+        size_t i = 0; \
+        (void)props; \
+        for (; i + W <= count; i += W) \
+        { \
+            V sum = LOAD(KERNEL_ROW(a[0]) + i); \
+            for (uint32_t k = 1; k < n; ++k) sum = ADD(sum, LOAD(KERNEL_ROW(a[k]) + i)); \
+            STORE(out + i, sum); \
+        } \
+        for (; i < count; ++i) \
+        { \
+            float sum = KERNEL_ROW(a[0])[i]; \
+            for (uint32_t k = 1; k < n; ++k) sum += KERNEL_ROW(a[k])[i]; \
+            out[i] = sum; \
+        } \
+    } \
+    static TARGET void \
+    kernel_negate_batch_##isa(float *r, size_t stride, size_t count, const uint32_t *a, uint32_t n, uint32_t dst, \
+        const int32_t *props) \
+    { \
+        float *out = KERNEL_ROW(dst); \
+        const float *x = KERNEL_ROW(a[0]); \
+        size_t i = 0; \
+        (void)n; (void)props; \
+        for (; i + W <= count; i += W) STORE(out + i, NEG(LOAD(x + i))); \
+        for (; i < count; ++i) out[i] = -x[i]; \
+    } \
+    static TARGET void \
+    kernel_sub_batch_##isa(float *r, size_t stride, size_t count, const uint32_t *a, uint32_t n, uint32_t dst, \
+        const int32_t *props) \
+    { \
+        float *out = KERNEL_ROW(dst); \
+        const float *x = KERNEL_ROW(a[0]), *y = KERNEL_ROW(a[1]); \
+        size_t i = 0; \
+        (void)n; (void)props; \
+        for (; i + W <= count; i += W) STORE(out + i, SUB(LOAD(x + i), LOAD(y + i))); \
+        for (; i < count; ++i) out[i] = x[i] - y[i]; \
+    } \
+    static const struct node_kernels sum_kernels_##isa = \
+    { \
+        .scalar = kernel_sum, .batch = kernel_sum_batch_##isa, \
+        .scalar_arity = { [2] = kernel_sum2, [3] = kernel_sum3 }, \
+        .batch_arity = { [2] = kernel_sum2_batch_##isa, [3] = kernel_sum3_batch_##isa }, \
+        .flags = KERNEL_PURE, \
+    }; \
+    static const struct node_kernels negate_kernels_##isa = { .scalar = kernel_negate, .batch = kernel_negate_batch_##isa, .flags = KERNEL_PURE }; \
+    static const struct node_kernels sub_kernels_##isa = { .scalar = kernel_sub, .batch = kernel_sub_batch_##isa, .flags = KERNEL_PURE };
+
+#define KERNEL_NEG_AVX2(x) _mm256_xor_ps((x), _mm256_set1_ps(-0.0f))
+/* _mm512_xor_ps needs AVX512DQ, flip the sign bit as an integer */
+#define KERNEL_NEG_AVX512(x) _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(x), _mm512_set1_epi32((int)0x80000000u)))
+
+KERNEL_ISA_DEFINE(avx2, KERNEL_TARGET_AVX2, __m256, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps, _mm256_sub_ps,
+    KERNEL_NEG_AVX2)
+KERNEL_ISA_DEFINE(avx512, KERNEL_TARGET_AVX512, __m512, 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps,
+    _mm512_sub_ps, KERNEL_NEG_AVX512)
+#endif
+
+/* the best ISA the CPU has */
+static kernel_isa
+kernel_isa_supported(void)
+{
+#ifdef KERNELS_X86
+    if (SDL_HasAVX512F()) return KERNEL_ISA_AVX512;
+    if (SDL_HasAVX2()) return KERNEL_ISA_AVX2;
+#endif
+    return KERNEL_ISA_BASE;
+}
+
+/*
+ * The ISA batch kernels run with: the best supported, or AIGRAPH_ISA if
+ * that names a supported one. Decided on the first call; make it before
+ * starting threads.
+ */
+static kernel_isa
+kernel_isa_active(void)
+{
+    static int active = -1;
+    if (active < 0)
+    {
+        const char *name = getenv("AIGRAPH_ISA");
+        active = kernel_isa_supported();
+        for (int isa = 0; name && isa < active; ++isa)
+            if (!strcmp(name, kernel_isa_names[isa])) active = isa;
+    }
+    return (kernel_isa)active;
+}
+
+/* the variant of built-in kernels `k` for the active ISA, `k` itself if there is none */
+static const struct node_kernels*
+kernels_for_isa(const struct node_kernels *k)
+{
+#ifdef KERNELS_X86
+    switch (kernel_isa_active())
+    {
+        case KERNEL_ISA_AVX512:
+            if (k == &sum_kernels) return &sum_kernels_avx512;
+            if (k == &negate_kernels) return &negate_kernels_avx512;
+            if (k == &sub_kernels) return &sub_kernels_avx512;
+            break;
+        case KERNEL_ISA_AVX2:
+            if (k == &sum_kernels) return &sum_kernels_avx2;
+            if (k == &negate_kernels) return &negate_kernels_avx2;
+            if (k == &sub_kernels) return &sub_kernels_avx2;
+            break;
+        default:
+            break;
+    }
+#endif
+    return k;
+}
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_timer.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_atomic.h>
+#include "aigraph.h"
+#include "asset_index.h"
+#include "jobs.h"
+
+/*
+ * Browser over an asset directory. Everything shown comes from the asset
+ * index, so filtering thousands of graphs never touches them; the
+ * directory is rescanned every few seconds and only changed graphs are
+ * read again. Rescans run on a worker thread while the current entries stay
+ * on screen, and their result is swapped in once it's done.
+ */
+
+#define LIBRARY_RESCAN_MS 5000
+#define LIBRARY_FILTER_SIZE 128
+
+struct library
+{
+    struct asset_index index;
+    struct job_pool pool;
+    Uint32 last_scan;
+    char filter[LIBRARY_FILTER_SIZE];
+    int filter_len;
+    int type_filter;        /* 0 for any, otherwise node type + 1 */
+    int *shown;             /* entries matching the filters */
+    int shown_count;
+    int dirty;              /* filters or entries changed since `shown` was built */
+    const char **type_names;
+
+    SDL_Thread *scan;       /* rescan in progress, if any */
+    SDL_atomic_t scan_done;
+    struct asset_entry *scanned;
+    int scanned_count, scan_changed;
+    char scan_error[256];
+};
+
+/* waits for a rescan in progress and drops its result */
+static void
+library_cancel_scan(struct library *lib)
+{
+    if (!lib->scan) return;
+    SDL_WaitThread(lib->scan, NULL);
+    lib->scan = NULL;
+    asset_entries_free(lib->scanned, lib->scanned ? lib->scanned_count : 0);
+    lib->scanned = NULL;
+}
+
+static void
+library_cleanup(struct library *lib)
+{
+    library_cancel_scan(lib);
+    jobs_cleanup(&lib->pool);
+    asset_index_cleanup(&lib->index);
+    free(lib->shown);
+    free((void*)lib->type_names);
+    memset(lib, 0, sizeof *lib);
+}
+
+/* rescans now; returns 0 and sets the SDL error on failure */
+static int
+library_refresh(struct library *lib)
+{
+    int changed = asset_index_refresh(&lib->index, &lib->pool);
+    lib->last_scan = SDL_GetTicks();
+    if (changed) lib->dirty = 1;
+    return changed >= 0;
+}
+
+/* opens the index of `dir` and brings it up to date */
+static int
+library_init(struct library *lib, const char *dir, struct config *conf)
+{
+    memset(lib, 0, sizeof *lib);
+    if (!jobs_init(&lib->pool, -1))
+    {
+        jobs_cleanup(&lib->pool);
+        SDL_SetError("couldn't start the library workers");
+        return 0;
+    }
+    if (!asset_index_init(&lib->index, dir, conf)) return 0;
+    lib->type_names = malloc((conf->node_count + 1) * sizeof *lib->type_names);
+    if (!lib->type_names)
+    {
+        SDL_SetError("out of memory");
+        return 0;
+    }
+    lib->type_names[0] = "any type";
+    for (int i = 0; i < conf->node_count; ++i) lib->type_names[i + 1] = conf->nodes[i].name;
+    lib->dirty = 1;
+    return library_refresh(lib);
+}
+
+static int SDLCALL
+library_scan_run(void *data)
+{
+    struct library *lib = data;
+
+    lib->scan_changed = asset_index_rescan(&lib->index, &lib->pool, &lib->scanned, &lib->scanned_count);
+    if (lib->scan_changed < 0) snprintf(lib->scan_error, sizeof lib->scan_error, "%s", SDL_GetError());
+    SDL_AtomicSet(&lib->scan_done, 1);
+    return 0;
+}
+
+/*
+ * Starts a rescan every few seconds and swaps in the entries of a finished
+ * one; returns 0 and sets the SDL error if it failed.
+ */
+static int
+library_update(struct library *lib)
+{
+    int changed;
+
+    if (!lib->scan)
+    {
+        if (SDL_GetTicks() - lib->last_scan < LIBRARY_RESCAN_MS) return 1;
+        lib->scanned = NULL;
+        SDL_AtomicSet(&lib->scan_done, 0);
+        lib->scan = SDL_CreateThread(library_scan_run, "library scan", lib);
+        /* without a thread, the rescan is just done here */
+        if (!lib->scan) return library_refresh(lib);
+        return 1;
+    }
+    if (!SDL_AtomicGet(&lib->scan_done)) return 1;
+
+    SDL_WaitThread(lib->scan, NULL);
+    lib->scan = NULL;
+    lib->last_scan = SDL_GetTicks();
+    changed = lib->scan_changed;
+    /* a failed index write still leaves a current listing */
+    if (lib->scanned) asset_index_replace(&lib->index, lib->scanned, lib->scanned_count);
+    lib->scanned = NULL;
+    if (changed) lib->dirty = 1;
+    if (changed < 0) SDL_SetError("%s", lib->scan_error);
+    return changed >= 0;
+}
+
+static void
+library_filter(struct library *lib)
+{
+    struct asset_index *index = &lib->index;
+    char filter[LIBRARY_FILTER_SIZE];
+
+    memcpy(filter, lib->filter, lib->filter_len);
+    filter[lib->filter_len] = '\0';
+
+    free(lib->shown);
+    lib->shown = malloc((index->entry_count ? index->entry_count : 1) * sizeof *lib->shown);
+    lib->shown_count = 0;
+    for (int i = 0; lib->shown && i < index->entry_count; ++i)
+    {
+        struct asset_entry *e = &index->entries[i];
+        if (filter[0] && !strstr(e->path, filter)) continue;
+        if (lib->type_filter && !e->counts[lib->type_filter - 1]) continue;
+        lib->shown[lib->shown_count++] = i;
+    }
+    lib->dirty = 0;
+}
+
+/*
+ * Draws the library window. Returns the full path of a graph the user asked
+ * to open, valid until the next call, or NULL.
+ */
+static const char*
+library_gui(struct nk_context *ctx, struct library *lib, struct nk_rect window)
+{
+    static char picked[1024];
+    const char *result = NULL;
+    struct config *conf = lib->index.conf;
+
+    window.x += window.w * 0.65f;
+    window.w *= 0.35f;
+    if (nk_begin(ctx, "Library", window, NK_WINDOW_TITLE | NK_WINDOW_BORDER | NK_WINDOW_NO_SCROLLBAR))
+    {
+        struct nk_list_view view;
+        char old[LIBRARY_FILTER_SIZE];
+        int len = lib->filter_len, type = lib->type_filter;
+
+        memcpy(old, lib->filter, len);
+
+        nk_layout_row_dynamic(ctx, 25, 2);
+        nk_edit_string(ctx, NK_EDIT_FIELD, lib->filter, &lib->filter_len, LIBRARY_FILTER_SIZE - 1, nk_filter_default);
+        lib->type_filter = nk_combo(ctx, lib->type_names, conf->node_count + 1, lib->type_filter, 25, nk_vec2(200, 200));
+        if (len != lib->filter_len || type != lib->type_filter ||
+            memcmp(old, lib->filter, len)) lib->dirty = 1;
+        if (lib->dirty) library_filter(lib);
+
+        nk_layout_row_dynamic(ctx, 20, 1);
+        nk_labelf(ctx, NK_TEXT_LEFT, "%d of %d graphs", lib->shown_count, lib->index.entry_count);
+
+        nk_layout_row_dynamic(ctx, nk_window_get_content_region(ctx).h - 60, 1);
+        if (nk_list_view_begin(ctx, &view, "library list", NK_WINDOW_BORDER, 25, lib->shown_count))
+        {
+            nk_layout_row_template_begin(ctx, 25);
+            nk_layout_row_template_push_dynamic(ctx);
+            nk_layout_row_template_push_static(ctx, 120);
+            nk_layout_row_template_push_static(ctx, 50);
+            nk_layout_row_template_end(ctx);
+            for (int i = view.begin; i < view.end; ++i)
+            {
+                struct asset_entry *e = &lib->index.entries[lib->shown[i]];
+                nk_label(ctx, e->path, NK_TEXT_LEFT);
+                if (e->flags & ASSET_INVALID) nk_label(ctx, "invalid", NK_TEXT_LEFT);
+                else nk_labelf(ctx, NK_TEXT_LEFT, "%u nodes %u links", e->node_count, e->link_count);
+                if (nk_button_label(ctx, "open"))
+                {
+                    snprintf(picked, sizeof picked, "%s/%s", lib->index.dir, e->path);
+                    result = picked;
+                }
+            }
+            nk_list_view_end(&view);
+        }
+    }
+    nk_end(ctx);
+    return result;
+}
+
+#endif
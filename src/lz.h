@@ -0,0 +1,232 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <SDL2/SDL_endian.h>
+
+/*
+ * Small LZ77 block codec in the spirit of LZ4: greedy matching through a
+ * hash table of 4-byte sequences, byte-aligned output, no entropy coding, so
+ * decompression is a tight copy loop.
+ *
+ * A block is a series of sequences:
+ *   token        high nibble = literal count, low nibble = match length - 4
+ *   [lengths]    a nibble of 15 continues with bytes added until one is < 255
+ *   literals
+ *   offset       u16 little-endian, distance back to the match start
+ *   [lengths]    match length continuation
+ * The last sequence holds only literals and has no offset.
+ */
+
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 16
+#define LZ_MAX_OFFSET 65535
+
+/* worst case output size for `size` input bytes */
+#define LZ_BOUND(size) ((size) + (size) / 255 + 16)
+
+static inline uint32_t
+lz_read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint32_t
+lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static inline uint8_t*
+lz_put_length(uint8_t *op, size_t len)
+{
+    while (len >= 255) { *op++ = 255; len -= 255; }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+static uint8_t*
+lz_put_sequence(uint8_t *op, const uint8_t *literals, size_t literal_len,
+    size_t offset, size_t match_len)
+{
+    uint8_t *token = op++;
+    size_t ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+
+    *token = (uint8_t)((literal_len < 15 ? literal_len : 15) << 4);
+    if (literal_len >= 15) op = lz_put_length(op, literal_len - 15);
+    memcpy(op, literals, literal_len);
+    op += literal_len;
+
+    if (!match_len) return op;
+
+    *token |= (uint8_t)(ml < 15 ? ml : 15);
+    *op++ = (uint8_t)(offset & 0xff);
+    *op++ = (uint8_t)(offset >> 8);
+    if (ml >= 15) op = lz_put_length(op, ml - 15);
+    return op;
+}
+
+/*
+ * Compresses `size` bytes into `dst`, which must hold LZ_BOUND(size) bytes.
+ * Returns the compressed size.
+ */
+static size_t
+lz_compress(const void *src, size_t size, void *dst)
+{
+    const uint8_t *base = src, *ip = base, *anchor = base;
+    const uint8_t *end = base + size;
+    const uint8_t *match_limit = size > 12 ? end - 12 : base;
+    uint8_t *op = dst;
+    uint32_t *table = calloc(1 << LZ_HASH_BITS, sizeof *table);
+
+    if (!table) return 0;
+
+    while (ip < match_limit)
+    {
+        uint32_t seq = lz_read32(ip);
+        uint32_t h = lz_hash(seq);
+        const uint8_t *ref = base + table[h];
+        table[h] = (uint32_t)(ip - base);
+
+        if (ref >= ip || ip - ref > LZ_MAX_OFFSET || lz_read32(ref) != seq)
+        {
+            ++ip;
+            continue;
+        }
+
+        /* extend the match forward, and backward into pending literals */
+        {const uint8_t *mp = ip + LZ_MIN_MATCH, *rp = ref + LZ_MIN_MATCH;
+        while (mp < end && *mp == *rp) ++mp, ++rp;
+        while (ip > anchor && ref > base && ip[-1] == ref[-1]) --ip, --ref;
+
+        op = lz_put_sequence(op, anchor, ip - anchor, ip - ref, mp - ip);
+        ip = anchor = mp;}
+
+        /* seed the table with the position just before the new anchor */
+        if (ip - 2 >= base && ip < match_limit)
+            table[lz_hash(lz_read32(ip - 2))] = (uint32_t)(ip - 2 - base);
+    }
+
+    op = lz_put_sequence(op, anchor, end - anchor, 0, 0);
+    free(table);
+    return op - (uint8_t*)dst;
+}
+
+/*
+ * Decompresses a block into exactly `size` bytes at `dst`. Every length and
+ * offset is bounds-checked, so corrupt input fails instead of overrunning.
+ * Returns 1 on success.
+ */
+static int
+lz_decompress(const void *src, size_t src_size, void *dst, size_t size)
+{
+    const uint8_t *ip = src, *ip_end = ip + src_size;
+    uint8_t *base = dst, *op = base, *op_end = base + size;
+
+#define LENGTH(len) do { uint8_t b; do { \
+        if (ip >= ip_end) return 0; \
+        b = *ip++; len += b; } while (b == 255); } while (0)
+
+    while (ip < ip_end)
+    {
+        uint8_t token = *ip++;
+        size_t literal_len = token >> 4, match_len = token & 15, offset;
+        const uint8_t *ref;
+
+        if (literal_len == 15) LENGTH(literal_len);
+        if (literal_len > (size_t)(ip_end - ip) || literal_len > (size_t)(op_end - op)) return 0;
+        /* short copies are done as one fixed 16-byte move when there is slack */
+        if (literal_len <= 16 && ip_end - ip >= 16 && op_end - op >= 16) memcpy(op, ip, 16);
+        else memcpy(op, ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+
+        if (ip == ip_end) break;  /* last sequence */
+
+        if (ip_end - ip < 2) return 0;
+        offset = ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        if (match_len == 15) LENGTH(match_len);
+        match_len += LZ_MIN_MATCH;
+        if (!offset || offset > (size_t)(op - base) || match_len > (size_t)(op_end - op)) return 0;
+
+        ref = op - offset;
+        if (offset >= 16 && match_len <= 16 && op_end - op >= 16)
+        {
+            memcpy(op, ref, 16);
+            op += match_len;
+        }
+        else if (offset >= match_len)
+        {
+            memcpy(op, ref, match_len);
+            op += match_len;
+        }
+        else
+        {
+            /* overlapping match: the pattern repeats every `offset` bytes, so
+             * copy it with doubling, non-overlapping chunks */
+            uint8_t *match_end = op + match_len;
+            size_t chunk = offset;
+            while (op < match_end)
+            {
+                size_t n = (size_t)(match_end - op) < chunk ? (size_t)(match_end - op) : chunk;
+                memcpy(op, ref, n);
+                op += n;
+                chunk += n;
+            }
+        }
+    }
+
+#undef LENGTH
+
+    return op == op_end;
+}
+
+/*
+ * Byte shuffle filter: regroups an array of `stride`-byte records so that
+ * byte k of every record is stored contiguously. Fixed-size records with
+ * small or repeated fields turn into long runs that compress far better.
+ */
+static void
+lz_shuffle(const void *src, void *dst, size_t count, size_t stride)
+{
+    const uint8_t *s = src;
+    uint8_t *d = dst;
+    for (size_t k = 0; k < stride; ++k)
+        for (size_t i = 0; i < count; ++i)
+            *d++ = s[i * stride + k];
+}
+
+/* writes records sequentially, reading one byte from each of `stride` planes */
+static void
+lz_unshuffle(const void *src, void *dst, size_t count, size_t stride)
+{
+    const uint8_t *s = src;
+    uint8_t *d = dst;
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    /* records made of 32-bit fields are rebuilt a word at a time */
+    if (stride % 4 == 0)
+    {
+        for (size_t k = 0; k < stride; k += 4)
+        {
+            const uint8_t *p0 = s + k * count, *p1 = p0 + count, *p2 = p1 + count, *p3 = p2 + count;
+            uint8_t *w = d + k;
+            for (size_t i = 0; i < count; ++i, w += stride)
+            {
+                uint32_t v = p0[i] | (uint32_t)p1[i] << 8 | (uint32_t)p2[i] << 16 | (uint32_t)p3[i] << 24;
+                memcpy(w, &v, 4);
+            }
+        }
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i)
+        for (size_t k = 0; k < stride; ++k)
+            *d++ = s[k * count + i];
+}
+
+#endif
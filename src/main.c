@@ -34,8 +34,50 @@
 #include "node_editor.h"
 #define CONSOLE_IMPLEMENTATION
 #include "console.h"
+#include "recorder.h"
+#include "build.h"
+#include "config_file.h"
 
-int main(void)
+static void
+handle_event(SDL_Event *evt, struct console *console)
+{
+    if (evt->type == SDL_KEYDOWN && evt->key.keysym.scancode == SDL_SCANCODE_GRAVE)
+        console->hidden = !console->hidden;
+    nk_sdl_handle_event(evt);
+}
+
+/*
+ * node types from -config <file>, or the built-in ones, plus those of every
+ * -plugin <library>; returns the config file, if any
+ */
+static const char*
+load_config(struct config *config, int argc, char *argv[])
+{
+    const char *path = NULL;
+    char **plugins = malloc(argc * sizeof *plugins);
+    int plugin_count = 0;
+
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-plugin")) plugins[plugin_count++] = argv[++i];
+        else if (!strcmp(argv[i], "-config") && !path) path = argv[++i];
+    }
+    if (path && !config_load(config, path))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        exit(1);
+    }
+    if (!path) config_init_default(config);
+    if (plugin_count && !config_load_plugins(config, plugins, plugin_count))
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        exit(1);
+    }
+    free(plugins);
+    return path;
+}
+
+int main(int argc, char *argv[])
 {
     /* Platform */
     SDL_Window *win;
@@ -50,12 +92,52 @@ int main(void)
     struct node_editor editor;
     struct console console;
     struct config config;
+    struct recorder recorder;
+
+    /* headless batch build: aigraph -build <dir> [-force] [-native] [-threads <n>] [-config <file>] [-plugin <library>...] */
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-build") && i + 1 < argc)
+        {
+            const char *dir = argv[i + 1];
+            int force = 0, native = 0, threads = -1, ok;
+            for (int j = 1; j < argc; ++j)
+            {
+                if (!strcmp(argv[j], "-force")) force = 1;
+                else if (!strcmp(argv[j], "-native")) native = 1;
+                else if (!strcmp(argv[j], "-threads") && j + 1 < argc) threads = SDL_max(atoi(argv[++j]), 1) - 1;
+            }
+            SDL_Init(SDL_INIT_TIMER);
+            load_config(&config, argc, argv);
+            ok = build_directory(dir, &config, force, native, threads, stdout);
+            config_cleanup(&config);
+            SDL_Quit();
+            return ok ? 0 : 1;
+        }
+    }
 
     console_init(&console);
+    recorder_init(&recorder);
+
+    /* command line */
+    for (int i = 1; i < argc; ++i)
+    {
+        if ((!strcmp(argv[i], "-record") || !strcmp(argv[i], "-replay")) && i + 1 < argc)
+        {
+            recorder_mode mode = !strcmp(argv[i], "-record") ? RECORDER_RECORD : RECORDER_REPLAY;
+            if (!recorder_start(&recorder, mode, argv[++i]))
+            {
+                fprintf(stderr, "%s\n", SDL_GetError());
+                exit(1);
+            }
+        }
+    }
 
     /* SDL setup */
     SDL_SetHint(SDL_HINT_VIDEO_HIGHDPI_DISABLED, "0");
     SDL_Init(SDL_INIT_VIDEO|SDL_INIT_TIMER|SDL_INIT_EVENTS);
+    /* batch kernels for this CPU, chosen once before anything links a graph */
+    kernel_isa_active();
     SDL_GL_SetAttribute (SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);
     SDL_GL_SetAttribute (SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
@@ -65,7 +147,8 @@ int main(void)
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
         WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL|SDL_WINDOW_SHOWN|SDL_WINDOW_ALLOW_HIGHDPI);
     glContext = SDL_GL_CreateContext(win);
-    SDL_GL_SetSwapInterval(1);
+    /* replays run as fast as possible, pacing comes from the recorded delta times */
+    SDL_GL_SetSwapInterval(recorder.mode == RECORDER_REPLAY ? 0 : 1);
     SDL_GetWindowSize(win, &win_width, &win_height);
 
     /* OpenGL setup */
@@ -87,8 +170,9 @@ int main(void)
     nk_sdl_font_stash_begin(&atlas);
     nk_sdl_font_stash_end();}
 
-    config_init_default(&config);
+    {const char *config_path = load_config(&config, argc, argv);
     node_editor_init(&editor, &config, &console);
+    if (config_path) node_editor_watch_config(&editor, config_path);}
 
     bg.r = 0.10f, bg.g = 0.18f, bg.b = 0.24f, bg.a = 1.0f;
     float time = SDL_GetTicks() / 1000.0f;
@@ -100,22 +184,52 @@ int main(void)
             time = new_time;
         }
 
+        recorder_time_begin(&recorder, TIMING_FRAME);
+
         /* Input */
         SDL_Event evt;
         nk_input_begin(ctx);
-        while (SDL_PollEvent(&evt)) {
-            if (evt.type == SDL_QUIT) goto cleanup;
-            if (evt.type == SDL_KEYDOWN && evt.key.keysym.scancode == SDL_SCANCODE_GRAVE)
-                console.hidden = !console.hidden;
-            nk_sdl_handle_event(&evt);
+        if (recorder.mode == RECORDER_REPLAY)
+        {
+            /* live input is ignored while replaying, except for quitting */
+            while (SDL_PollEvent(&evt))
+                if (evt.type == SDL_QUIT) goto cleanup;
+            if (!recorder_read_frame(&recorder)) goto cleanup;
+            for (int i = 0; i < recorder.event_count; ++i)
+                handle_event(&recorder.events[i], &console);
+            ctx->delta_time_seconds = recorder.delta_time;
+            if (recorder.width != win_width || recorder.height != win_height)
+                SDL_SetWindowSize(win, recorder.width, recorder.height);
+        }
+        else
+        {
+            while (SDL_PollEvent(&evt)) {
+                if (evt.type == SDL_QUIT) goto cleanup;
+                if (recorder.mode == RECORDER_RECORD) recorder_push(&recorder, &evt);
+                handle_event(&evt, &console);
+            }
         } nk_input_end(ctx);
 
         SDL_GetWindowSize(win, &win_width, &win_height);
-        
+        if (recorder.mode == RECORDER_REPLAY)
+            win_width = recorder.width, win_height = recorder.height;
+        else if (recorder.mode == RECORDER_RECORD)
+            recorder_write_frame(&recorder, ctx->delta_time_seconds, win_width, win_height);
+
+        node_editor_update(&editor);
+
+        recorder_time_begin(&recorder, TIMING_GUI);
         node_editor_gui(ctx, &editor, nk_rect(0, 0, win_width, win_height), NK_WINDOW_NO_SCROLLBAR);
         console_gui(ctx, &console, &editor, nk_rect(0, 0, win_width, win_height));
+        if (editor.library)
+        {
+            const char *picked = library_gui(ctx, editor.library, nk_rect(0, 0, win_width, win_height));
+            if (picked) node_editor_load(&editor, (char*)picked);
+        }
+        recorder_time_end(&recorder, TIMING_GUI);
 
         /* Draw */
+        recorder_time_begin(&recorder, TIMING_RENDER);
         glViewport(0, 0, win_width, win_height);
         glClear(GL_COLOR_BUFFER_BIT);
         glClearColor(bg.r, bg.g, bg.b, bg.a);
@@ -125,10 +239,15 @@ int main(void)
          * Make sure to either a.) save and restore or b.) reset your own state after
          * rendering the UI. */
         nk_sdl_render(NK_ANTI_ALIASING_ON, MAX_VERTEX_MEMORY, MAX_ELEMENT_MEMORY);
+        recorder_time_end(&recorder, TIMING_RENDER);
+        recorder_time_end(&recorder, TIMING_FRAME);
+        recorder_commit_timings(&recorder);
         SDL_GL_SwapWindow(win);
     }
 
 cleanup:
+    recorder_report(&recorder, stdout);
+    recorder_cleanup(&recorder);
     console_cleanup(&console);
     config_cleanup(&config);
     node_editor_cleanup(&editor);
@@ -0,0 +1,479 @@
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL2/SDL_loadso.h>
+#include <SDL2/SDL_error.h>
+#include "compiler.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <errno.h>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+
+/*
+ * Native backend: a compiled graph is turned into a self-contained C
+ * source file, built into a shared library by the system C compiler and
+ * loaded back with SDL_LoadObject.
+ *
+ * The generated code is one loop over agents whose body is the program
+ * written out straight-line, registers as locals and constants as literals,
+ * so the C compiler sees all of it at once. Inputs are SoA rows as for
+ * compiled_graph_run_batch. The uniform prologue isn't part of it: the
+ * caller runs it with compiled_graph_run_uniform and passes the register
+ * file, whose prologue results each agent starts with. Events come grouped
+ * by agent, each agent's in instruction order, exactly what
+ * compiled_graph_run gives one agent after the other; native_graph_verify
+ * checks that it does. OP_KERNEL instructions call the graph's linked
+ * kernels, which keeps plugin node types working at the cost of a register
+ * array in memory.
+ *
+ * The C compiler is NATIVE_CC or the program the AIGRAPH_CC environment
+ * variable names, and must not be told to reassociate floats: sums are
+ * written in the order the interpreter adds them.
+ */
+
+#define NATIVE_ABI 2
+#define NATIVE_ENTRY_RUN "aigraph_native_run"
+#define NATIVE_ENTRY_INFO "aigraph_native_info"
+
+#ifdef _WIN32
+#define NATIVE_CC "cl"
+#else
+#define NATIVE_CC "cc"
+#endif
+
+#if defined(_WIN32)
+#define NATIVE_SUFFIX ".dll"
+#elif defined(__APPLE__)
+#define NATIVE_SUFFIX ".dylib"
+#else
+#define NATIVE_SUFFIX ".so"
+#endif
+
+typedef int (*native_run_func)(const float *inputs, size_t stride, size_t count, const float *uniform,
+    const int32_t *props, const node_kernel *calls, struct aigc_event *events);
+typedef int (*native_info_func)(uint64_t *graph_hash, uint64_t *config_hash);
+
+/* a loaded native library of one compiled graph */
+struct native_graph
+{
+    void *object;
+    native_run_func run;
+};
+
+/* writes a float as a literal that reads back to the same bits */
+static void
+native_put_float(FILE *f, float value)
+{
+    if (isfinite(value))
+    {
+        fprintf(f, "%af", (double)value);
+    }
+    else
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof bits);
+        fprintf(f, "native_float(0x%08xu)", (unsigned)bits);
+    }
+}
+
+/* writes the reference to register `k` */
+static void
+native_put_register(FILE *f, int array, uint32_t k)
+{
+    fprintf(f, array ? "r[%u]" : "r%u", (unsigned)k);
+}
+
+static void
+native_put_input(FILE *f, int32_t index)
+{
+    fprintf(f, "inputs[%d * stride + i]", (int)index);
+}
+
+/* writes a sum of the instruction's operands, left to right as the interpreter adds them */
+static void
+native_put_sum(FILE *f, int array, const uint32_t *a, uint32_t n)
+{
+    for (uint32_t k = 0; k < n; ++k)
+    {
+        if (k) fputs(" + ", f);
+        native_put_register(f, array, a[k]);
+    }
+}
+
+/*
+ * Writes `g` as C source to `path`. Returns 0 and sets the SDL error if the
+ * file can't be written.
+ */
+static int
+native_generate(struct compiled_graph *g, const char *path)
+{
+    struct aigc_header *h = g->header;
+    FILE *f = fopen(path, "w");
+    int array = 0, ok;
+
+    if (!f)
+    {
+        SDL_SetError("couldn't open '%s' for writing", path);
+        return 0;
+    }
+    for (uint32_t k = 0; k < h->instruction_count; ++k) array |= g->instructions[k].op == OP_KERNEL;
+
+    fprintf(f, "/*\n * Native code of compiled graph %08x%08x, generated by aigraph. Regenerate it\n"
+        " * rather than editing it.\n */\n\n",
+        (unsigned)(h->graph_hash >> 32), (unsigned)h->graph_hash);
+    fputs("#include <stddef.h>\n#include <stdint.h>\n#include <string.h>\n\n"
+        "#ifdef _WIN32\n#define NATIVE_EXPORT __declspec(dllexport)\n"
+        "#else\n#define NATIVE_EXPORT __attribute__((visibility(\"default\")))\n#endif\n\n"
+        "typedef void (*node_kernel)(float *r, const uint32_t *args, uint32_t arg_count, uint32_t dst,\n"
+        "    const int32_t *props);\n\n"
+        "struct aigc_event\n{\n    uint32_t op;\n    uint32_t node;\n    const int32_t *props;\n"
+        "    float value;\n    uint32_t agent;\n};\n\n"
+        "static inline float\nnative_float(uint32_t bits)\n{\n    float value;\n"
+        "    memcpy(&value, &bits, sizeof value);\n    return value;\n}\n\n", f);
+    fprintf(f, "#define EVENT(op_, node_, props_, value_) do { \\\n"
+        "        struct aigc_event *e = &events[event_count++]; \\\n"
+        "        e->op = (op_); \\\n        e->node = (node_); \\\n        e->props = props + (props_); \\\n"
+        "        e->value = (value_); \\\n        e->agent = (uint32_t)i; \\\n    } while (0)\n\n");
+
+    fprintf(f, "NATIVE_EXPORT int\n" NATIVE_ENTRY_INFO "(uint64_t *graph_hash, uint64_t *config_hash)\n{\n"
+        "    *graph_hash = 0x%08x%08xull;\n    *config_hash = 0x%08x%08xull;\n    return %d;\n}\n\n",
+        (unsigned)(h->graph_hash >> 32), (unsigned)h->graph_hash,
+        (unsigned)(h->config_hash >> 32), (unsigned)h->config_hash, NATIVE_ABI);
+
+    fputs("NATIVE_EXPORT int\n" NATIVE_ENTRY_RUN "(const float *inputs, size_t stride, size_t count, "
+        "const float *uniform,\n    const int32_t *props, const node_kernel *calls, struct aigc_event *events)\n{\n"
+        "    int event_count = 0;\n    (void)inputs; (void)uniform; (void)props; (void)calls;\n"
+        "    for (size_t i = 0; i < count; ++i)\n    {\n", f);
+
+    if (array)
+    {
+        fprintf(f, "        float r[%u];\n", (unsigned)h->register_count);
+    }
+    else
+    {
+        for (uint32_t k = 0; k < h->register_count; ++k)
+            fprintf(f, "%sr%u%s", k % 16 ? ", " : "        float ", (unsigned)k,
+                k % 16 == 15 || k + 1 == h->register_count ? ";\n" : "");
+    }
+    for (uint32_t k = 0; k < h->const_count; ++k)
+    {
+        fputs("        ", f);
+        native_put_register(f, array, k);
+        fputs(" = ", f);
+        native_put_float(f, g->consts[k]);
+        fputs(";\n", f);
+    }
+    for (uint32_t k = 0; k < g->uniform_register_count; ++k)
+    {
+        fputs("        ", f);
+        native_put_register(f, array, g->uniform_registers[k]);
+        fprintf(f, " = uniform[%u];\n", (unsigned)g->uniform_registers[k]);
+    }
+
+    for (uint32_t k = h->uniform_count; k < h->instruction_count; ++k)
+    {
+        struct aigc_instruction *in = &g->instructions[k];
+        const uint32_t *a = g->operands + in->args;
+
+        fputs("        ", f);
+        if (in->op == OP_PLAY_ANIM)
+        {
+            fputs("if (", f);
+            native_put_register(f, array, a[0]);
+            fputs(" > 0) EVENT(", f);
+            fprintf(f, "%u, %u, %u, ", (unsigned)in->op, (unsigned)in->node, (unsigned)in->props);
+            native_put_register(f, array, a[0]);
+            fputs(");\n", f);
+            continue;
+        }
+        if (in->op == OP_KERNEL)
+        {
+            fputs("{ static const uint32_t a[] = { ", f);
+            for (uint32_t j = 0; j < in->arg_count; ++j) fprintf(f, "%s%u", j ? ", " : "", (unsigned)a[j]);
+            fprintf(f, " }; calls[%u](r, a, %u, %u, props + %u); }\n",
+                (unsigned)k, (unsigned)in->arg_count, (unsigned)in->dst, (unsigned)in->props);
+            continue;
+        }
+
+        native_put_register(f, array, in->dst);
+        fputs(" = ", f);
+        switch (in->op)
+        {
+            case OP_INPUT:
+                native_put_input(f, g->props[in->props]);
+                break;
+            case OP_NEGATE:
+                fputc('-', f);
+                native_put_register(f, array, a[0]);
+                break;
+            case OP_SUM:
+            case OP_SUM3:
+            case AIGC_OP_SUM_CHAIN:
+                native_put_sum(f, array, a, in->arg_count);
+                break;
+            case AIGC_OP_SUB:
+                native_put_register(f, array, a[0]);
+                fputs(" - ", f);
+                native_put_register(f, array, a[1]);
+                break;
+            case AIGC_OP_ADD_INPUT:
+                native_put_register(f, array, a[0]);
+                fputs(" + ", f);
+                native_put_input(f, g->props[in->props]);
+                break;
+        }
+        fputs(";\n", f);
+    }
+    fputs("    }\n    return event_count;\n}\n", f);
+
+    ok = !ferror(f);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok)
+    {
+        remove(path);
+        SDL_SetError("error while writing '%s'", path);
+    }
+    return ok;
+}
+
+/*
+ * A path as a compiler argument: one that would read as an option gets a
+ * "./" in front.
+ */
+static const char*
+native_path_arg(char *buffer, size_t size, const char *path)
+{
+#ifdef _WIN32
+    if (path[0] != '-' && path[0] != '/') return path;
+#else
+    if (path[0] != '-') return path;
+#endif
+    snprintf(buffer, size, "./%s", path);
+    return buffer;
+}
+
+/*
+ * Builds the C source at `source` into the shared library `library` with
+ * the system C compiler. The compiler is started with an argument list, no
+ * shell sees the paths, so AIGRAPH_CC names just the program. Returns 0
+ * and sets the SDL error if it can't be started or fails.
+ */
+static int
+native_compile(const char *source, const char *library)
+{
+    const char *cc = getenv("AIGRAPH_CC");
+    char source_arg[1040], library_arg[1040];
+    int status;
+
+    if (!cc) cc = NATIVE_CC;
+
+    source = native_path_arg(source_arg, sizeof source_arg, source);
+    library = native_path_arg(library_arg, sizeof library_arg, library);
+#ifdef _WIN32
+    {
+        /* _spawnvp joins the arguments into one command line, so each is quoted */
+        char program[1040], quoted[1040], output[1040], object[1040];
+        const char *argv[] = { program, "/nologo", "/O2", "/fp:precise", "/LD", quoted, output, object, NULL };
+
+        if (strchr(cc, '"') || strchr(source, '"') || strchr(library, '"'))
+        {
+            SDL_SetError("can't pass '%s' to the C compiler",
+                strchr(cc, '"') ? cc : strchr(source, '"') ? source : library);
+            return 0;
+        }
+        snprintf(program, sizeof program, "\"%s\"", cc);
+        snprintf(quoted, sizeof quoted, "\"%s\"", source);
+        snprintf(output, sizeof output, "/Fe\"%s\"", library);
+        snprintf(object, sizeof object, "/Fo\"%s.obj\"", library);
+        status = (int)_spawnvp(_P_WAIT, cc, argv);
+        if (status == -1)
+        {
+            SDL_SetError("couldn't run the C compiler '%s'", cc);
+            return 0;
+        }
+    }
+#else
+    {
+        const char *argv[] = { cc, "-O2", "-shared", "-fPIC", "-ffp-contract=off", "-o", library, source, NULL };
+        pid_t pid, waited;
+        int error = posix_spawnp(&pid, cc, NULL, NULL, (char**)argv, environ);
+
+        if (error)
+        {
+            SDL_SetError("couldn't run the C compiler '%s': %s", cc, strerror(error));
+            return 0;
+        }
+        while ((waited = waitpid(pid, &status, 0)) < 0 && errno == EINTR);
+        status = waited == pid && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+#endif
+    if (status != 0)
+    {
+        SDL_SetError("the C compiler '%s' failed on '%s' with status %d", cc, source, status);
+        return 0;
+    }
+    return 1;
+}
+
+static void
+native_graph_close(struct native_graph *ng)
+{
+    if (ng->object) SDL_UnloadObject(ng->object);
+    ng->object = NULL;
+    ng->run = NULL;
+}
+
+/*
+ * Loads the native library of `g`. Returns 0 and sets the SDL error if it
+ * can't be loaded or was built from another graph or config.
+ */
+static int
+native_graph_open(struct native_graph *ng, const char *library, struct compiled_graph *g)
+{
+    native_info_func info;
+    uint64_t graph_hash, config_hash;
+    char path[1024], error[512];
+
+    /* without a directory the loader would search the library path instead */
+    snprintf(path, sizeof path, "%s%s", strchr(library, '/') || strchr(library, '\\') ? "" : "./", library);
+    ng->run = NULL;
+    ng->object = SDL_LoadObject(path);
+    if (!ng->object)
+    {
+        snprintf(error, sizeof error, "%s", SDL_GetError());
+        SDL_SetError("couldn't load native code '%s': %s", library, error);
+        return 0;
+    }
+    info = (native_info_func)SDL_LoadFunction(ng->object, NATIVE_ENTRY_INFO);
+    ng->run = (native_run_func)SDL_LoadFunction(ng->object, NATIVE_ENTRY_RUN);
+    if (!info || !ng->run || info(&graph_hash, &config_hash) != NATIVE_ABI)
+    {
+        native_graph_close(ng);
+        SDL_SetError("'%s' is not native code of a compiled graph", library);
+        return 0;
+    }
+    if (graph_hash != g->header->graph_hash || config_hash != g->header->config_hash)
+    {
+        native_graph_close(ng);
+        SDL_SetError("'%s' was built from a different graph or config", library);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Evaluates the graph for `count` agents with native code. `uniform` is the
+ * register file compiled_graph_run_uniform ran on this tick, `inputs` holds
+ * input_count rows of `stride` floats and `events` room for event_count *
+ * count events, grouped by agent. Returns the number of events emitted.
+ */
+static int
+native_graph_run(struct native_graph *ng, struct compiled_graph *g, const float *uniform, const float *inputs,
+    size_t stride, size_t count, struct aigc_event *events)
+{
+    return ng->run(inputs, stride, count, uniform, g->props, g->calls, events);
+}
+
+/*
+ * Runs `count` agents with pseudo-random inputs and globals through both
+ * the native code and compiled_graph_run and compares the events bit for
+ * bit. Returns 0 and sets the SDL error if they differ.
+ */
+static int
+native_graph_verify(struct native_graph *ng, struct compiled_graph *g, size_t count)
+{
+    struct aigc_header *h = g->header;
+    float *inputs = malloc(((size_t)h->input_count * count + 1) * sizeof *inputs);
+    float *agent_inputs = malloc((h->input_count + 1) * sizeof *agent_inputs);
+    float *registers = malloc((h->register_count + 1) * sizeof *registers);
+    float *globals = malloc((h->global_count + 1) * sizeof *globals);
+    struct aigc_event *native = malloc(((size_t)h->event_count * count + 1) * sizeof *native);
+    struct aigc_event *expected = malloc((h->event_count + 1) * sizeof *expected);
+    uint32_t seed = 1;
+    int native_count, seen = 0, ok = 0;
+
+    if (!inputs || !agent_inputs || !registers || !globals || !native || !expected)
+    {
+        SDL_SetError("out of memory");
+        goto cleanup;
+    }
+    for (size_t i = 0; i < (size_t)h->input_count * count; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        inputs[i] = (float)(seed >> 16 & 0x7fff) / 0x1000 - 4;
+    }
+    for (uint32_t i = 0; i < h->global_count; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        globals[i] = (float)(seed >> 16 & 0x7fff) / 0x1000 - 4;
+    }
+    compiled_graph_init_registers(g, registers);
+    compiled_graph_run_uniform(g, registers, globals);
+
+    native_count = native_graph_run(ng, g, registers, inputs, count, count, native);
+    for (size_t i = 0; i < count; ++i)
+    {
+        int n;
+        for (uint32_t k = 0; k < h->input_count; ++k) agent_inputs[k] = inputs[k * count + i];
+        n = compiled_graph_run(g, registers, agent_inputs, expected);
+        for (int e = 0; e < n; ++e, ++seen)
+        {
+            struct aigc_event *x = &expected[e], *y = &native[seen];
+            if (seen >= native_count || x->op != y->op || x->node != y->node || x->props != y->props ||
+                memcmp(&x->value, &y->value, sizeof x->value) || y->agent != i)
+            {
+                SDL_SetError("native code differs from the interpreter at agent %u, node %u", (unsigned)i, x->node);
+                goto cleanup;
+            }
+        }
+    }
+    if (seen != native_count)
+    {
+        SDL_SetError("native code emits %d events, the interpreter %d", native_count, seen);
+        goto cleanup;
+    }
+    ok = 1;
+
+cleanup:
+    free(inputs);
+    free(agent_inputs);
+    free(registers);
+    free(globals);
+    free(native);
+    free(expected);
+    return ok;
+}
+
+/*
+ * Generates, builds, loads and verifies the native code of `g` as
+ * `base`.c and `base`NATIVE_SUFFIX. Returns 0 and sets the SDL error on
+ * failure, leaving `ng` closed.
+ */
+static int
+native_graph_build(struct native_graph *ng, struct compiled_graph *g, const char *base)
+{
+    char source[1024], library[1024];
+
+    snprintf(source, sizeof source, "%s.c", base);
+    snprintf(library, sizeof library, "%s" NATIVE_SUFFIX, base);
+    ng->object = NULL;
+    if (!native_generate(g, source) || !native_compile(source, library) || !native_graph_open(ng, library, g))
+        return 0;
+    if (!native_graph_verify(ng, g, 64))
+    {
+        native_graph_close(ng);
+        return 0;
+    }
+    return 1;
+}
+
+#endif
@@ -2,6 +2,19 @@
 #include <SDL2/SDL_rwops.h>
 #include "aigraph.h"
 #include "console.h"
+#include "graph_file.h"
+#include "save_job.h"
+#include "journal.h"
+#include "text_format.h"
+#include "compiler.h"
+#include "compile_cache.h"
+#include "components.h"
+#include "native.h"
+#include "wavefront.h"
+#include "incremental.h"
+#include "library.h"
+#include "config_file.h"
+#include "plugins.h"
 
 #define NODE_WIDTH 180.0f
 
@@ -51,6 +64,20 @@ struct node_editor {
     int selected_id;
     struct nk_vec2 scrolling;
     struct node_linking linking;
+    struct save_job *save;  /* in-flight background save, if any */
+    struct journal *journal;  /* edit journal of the file being edited, if any */
+    struct compile_cache *cache;  /* created by the first compile */
+    struct library *library;  /* asset browser, if one was opened */
+    struct config_watch *watch;  /* config file reloaded when it changes, if any */
+};
+
+#define CONFIG_WATCH_INTERVAL_MS 500
+
+struct config_watch
+{
+    char *path;
+    uint64_t mtime, size;
+    Uint32 last_check;
 };
 
 static float
@@ -163,6 +190,9 @@ node_editor_add(struct node_editor *editor, node_type type, float pos_x, float p
         (info->input_count + info->output_count + info->prop_count) + 35);
     node->consts = calloc(info->input_count, sizeof *node->consts);
     node->props = calloc(info->prop_count, sizeof *node->props);
+
+    if (editor->journal)
+        journal_append(editor->journal, JOURNAL_ADD, type, journal_float(pos_x), journal_float(pos_y), 0);
 }
 
 static void 
@@ -170,6 +200,8 @@ node_editor_delete(struct node_editor *editor, int node_id)
 {
     struct node *node = &editor->nodes[node_id];
 
+    if (editor->journal) journal_append(editor->journal, JOURNAL_DELETE, node_id, 0, 0, 0);
+
     /* remove all links to node */
     for (int i = 0; i < node->links.size; ++i)
     {
@@ -210,6 +242,8 @@ node_editor_link(struct node_editor *editor, int in_id, int in_slot,
 {
     add_link(&editor->nodes[in_id].links, LINK_OUTBOUND, in_slot, out_id, out_slot);
     add_link(&editor->nodes[out_id].links, LINK_INBOUND, out_slot, in_id, in_slot);
+
+    if (editor->journal) journal_append(editor->journal, JOURNAL_LINK, in_id, in_slot, out_id, out_slot);
 }
 
 static void
@@ -218,6 +252,8 @@ node_editor_unlink(struct node_editor *editor, int in_id, int in_slot,
 {
     struct node_link_list *links;
 
+    if (editor->journal) journal_append(editor->journal, JOURNAL_UNLINK, in_id, in_slot, out_id, out_slot);
+
     links = &editor->nodes[in_id].links;
     for (int i = 0; i < links->size; ++i)
     {
@@ -243,6 +279,36 @@ node_editor_unlink(struct node_editor *editor, int in_id, int in_slot,
     }
 }
 
+static void
+node_editor_set_const(struct node_editor *editor, int node_id, int slot, float value)
+{
+    struct node *node = &editor->nodes[node_id];
+    if (node->consts[slot] == value) return;
+    node->consts[slot] = value;
+    if (editor->journal) journal_append(editor->journal, JOURNAL_CONST, node_id, slot, journal_float(value), 0);
+}
+
+static void
+node_editor_set_prop(struct node_editor *editor, int node_id, int slot, int value)
+{
+    struct node *node = &editor->nodes[node_id];
+    if (node->props[slot].i == value) return;
+    node->props[slot].i = value;
+    if (editor->journal) journal_append(editor->journal, JOURNAL_PROP, node_id, slot, value, 0);
+}
+
+static void
+node_editor_move(struct node_editor *editor, int node_id, float x, float y)
+{
+    struct node *node = &editor->nodes[node_id];
+    /* layout round trips jitter positions by a few ulps, those aren't edits */
+    if (fabsf(node->bounds.x - x) < 0.01f && fabsf(node->bounds.y - y) < 0.01f) return;
+    node->bounds.x = x;
+    node->bounds.y = y;
+    if (editor->journal)
+        journal_append(editor->journal, JOURNAL_MOVE, node_id, journal_float(x), journal_float(y), 0);
+}
+
 static void
 node_editor_init(struct node_editor *editor, struct config *config, struct console *console)
 {
@@ -255,9 +321,33 @@ node_editor_init(struct node_editor *editor, struct config *config, struct conso
 static void
 node_editor_cleanup(struct node_editor *editor)
 {
+    if (editor->save) save_job_finish(editor->save);
+    if (editor->journal)
+    {
+        journal_cleanup(editor->journal);
+        free(editor->journal);
+    }
+    if (editor->cache)
+    {
+        compile_cache_cleanup(editor->cache);
+        free(editor->cache);
+    }
+    if (editor->library)
+    {
+        library_cleanup(editor->library);
+        free(editor->library);
+    }
+    if (editor->watch)
+    {
+        free(editor->watch->path);
+        free(editor->watch);
+    }
     for (int i = 0; i < editor->node_count; ++i)
-        if (editor->nodes[i].links.links)
-            free(editor->nodes[i].links.links);
+    {
+        free(editor->nodes[i].links.links);
+        free(editor->nodes[i].consts);
+        free(editor->nodes[i].props);
+    }
     free(editor->nodes);
 }
 
@@ -272,7 +362,6 @@ find_node_input(struct node *node, int slot)
     return NULL;
 }
 
-static struct compiled_graph* node_editor_compile(struct node_editor *editor);
 static int tsort(struct node *nodes, int node_count, struct node **sorted);
 
 static int
@@ -330,6 +419,7 @@ node_editor_gui(struct nk_context *ctx, struct node_editor *nodedit, struct nk_r
                     /* ================= NODE CONTENT =====================*/
                     nk_layout_row_dynamic(ctx, 25, 1);
                     struct node_info *info = &infos[it->type];
+                    int id = (int)(it - nodedit->nodes);
                     char pname[16];
                     for (int i = 0; i < info->output_count; ++i)
                     {
@@ -341,15 +431,19 @@ node_editor_gui(struct nk_context *ctx, struct node_editor *nodedit, struct nk_r
                         switch (info->props[i].type)
                         {
                             case FIELD_INT: 
-                                it->props[i].i = nk_propertyi(ctx, pname, -100, it->props[i].i, 100, 1, 1);
+                                node_editor_set_prop(nodedit, id, i, nk_propertyi(ctx, pname, -100, it->props[i].i, 100, 1, 1));
                                 break;
                             case FIELD_FLOAT:
-                                it->props[i].f = nk_propertyf(ctx, pname, -100, it->props[i].f, 100, 1, 1);
+                                {union node_property v = it->props[i];
+                                v.f = nk_propertyf(ctx, pname, -100, it->props[i].f, 100, 1, 1);
+                                node_editor_set_prop(nodedit, id, i, v.i);}
                                 break;
                             case FIELD_ENUM:
                                 {struct enum_info *e = &nodedit->conf->enums[info->props[i].enum_type];
-                                it->props[i].e = nk_combo(ctx, e->values, e->count, it->props[i].e, 
-                                    25, nk_vec2(nk_layout_widget_bounds(ctx).w, 200));}
+                                union node_property v = it->props[i];
+                                v.e = (short)nk_combo(ctx, e->values, e->count, it->props[i].e, 
+                                    25, nk_vec2(nk_layout_widget_bounds(ctx).w, 200));
+                                node_editor_set_prop(nodedit, id, i, v.i);}
                                 break;
                         }
                     }
@@ -362,7 +456,7 @@ node_editor_gui(struct nk_context *ctx, struct node_editor *nodedit, struct nk_r
                         else 
                         {
                             sprintf_s(pname, NK_LEN(pname), "#%s", info->inputs[i].name);
-                            it->consts[i] = nk_propertyf(ctx, pname, -100, it->consts[i], 100, 1, 1);
+                            node_editor_set_const(nodedit, id, i, nk_propertyf(ctx, pname, -100, it->consts[i], 100, 1, 1));
                         }
                     }
                     /* ====================================================*/
@@ -375,6 +469,7 @@ node_editor_gui(struct nk_context *ctx, struct node_editor *nodedit, struct nk_r
                     bounds = nk_layout_space_rect_to_local(ctx, node->bounds);
                     bounds.x += nodedit->scrolling.x;
                     bounds.y += nodedit->scrolling.y;
+                    node_editor_move(nodedit, i, bounds.x, bounds.y);
                     it->bounds = bounds;
 
                     /* output connector */
@@ -544,23 +639,22 @@ tsort(struct node *nodes, int node_count, struct node **sorted)
 
     int sorted_count = 0;
 
-    struct node **unmarked = malloc(node_count * sizeof *unmarked);
-    int unmarked_count = 0;
+    int next_root = 0;
 
     struct stack_frame *stack = malloc(node_count * sizeof *stack);
     int stack_size = 0;
 
     for (int i = 0; i < node_count; i++)
-    {
         nodes[i].mark = MARK_NONE;
-        unmarked[i] = &nodes[i];
-    }
 
-    unmarked_count = node_count;
-
-    while (unmarked_count)
+    for (;;)
     {
-        struct node *n = unmarked[0];
+        struct node *n;
+
+        /* roots are taken in index order, everything before next_root is marked */
+        while (next_root < node_count && nodes[next_root].mark != MARK_NONE) ++next_root;
+        if (next_root == node_count) break;
+        n = &nodes[next_root];
 
         stack[stack_size++] = (struct stack_frame) { n, 0 };
 
@@ -569,19 +663,7 @@ tsort(struct node *nodes, int node_count, struct node **sorted)
             struct stack_frame *s = &stack[stack_size - 1];
             n = s->node;
 
-            if (n->mark == MARK_NONE)
-            {
-                for (int i = 0; i < unmarked_count; ++i)
-                {
-                    if (unmarked[i] == n)
-                    {
-                        unmarked[i] = unmarked[--unmarked_count];
-                        break;
-                    }
-                }
-
-                n->mark = MARK_TEMPORARY;
-            }
+            if (n->mark == MARK_NONE) n->mark = MARK_TEMPORARY;
 
             struct node *next = NULL;
             for (int i = s->loop_counter; i < n->links.size; ++i)
@@ -621,300 +703,1273 @@ tsort(struct node *nodes, int node_count, struct node **sorted)
 
     cleanup:
     free(stack);
-    free(unmarked);
 
     return result;
 }
 
-static void
-node_editor_save(struct node_editor *editor, char *path)
+/* flattens the graph into a v2 file image held in `view->storage` */
+static int
+node_editor_flatten(struct node_editor *editor, struct graph_view *view, uint32_t generation)
 {
-    SDL_RWops *file = SDL_RWFromFile(path, "w");
-    size_t pos, temp;
+    int link_count = 0, const_count = 0, prop_count = 0;
+    struct aig_link *link_it;
+    struct aig_const *const_it;
+    struct aig_prop *prop_it;
 
-    if (!file) { editor_print(editor, SDL_GetError()); return; }
-
-    /* write magic */
-    char *magic = "aigraph";
-    SDL_RWwrite(file, magic, 1, strlen(magic) + 1);
-
-    /* write scroll */
-    SDL_RWwrite(file, &editor->scrolling, sizeof editor->scrolling, 1);
-
-    /* write nodes */
-    SDL_WriteLE32(file, editor->node_count);
-    for (int i = 0; i < editor->node_count; ++i)
-    {
-        struct node *n = &editor->nodes[i];
-        SDL_WriteLE16(file, (uint16_t)n->type);
-        SDL_WriteLE32(file, *((uint32_t*)(&n->bounds.x)));
-        SDL_WriteLE32(file, *((uint32_t*)(&n->bounds.y)));
-    }
-
-    /* reserve space for link count */
-    pos = SDL_RWtell(file);
-    SDL_WriteLE32(file, 0);
-
-    /* write links */
-    int link_count = 0;
     for (int i = 0; i < editor->node_count; ++i)
     {
         struct node *n = &editor->nodes[i];
+        int inbound = 0;
         for (int j = 0; j < n->links.size; ++j)
         {
-            struct node_link *link = get_link(&n->links, j);
-            if (link->type == LINK_OUTBOUND)
-            {
-                SDL_WriteLE32(file, i);
-                SDL_WriteLE32(file, link->other_id);
-                SDL_WriteU8(file, (uint8_t)link->slot);
-                SDL_WriteU8(file, (uint8_t)link->other_slot);
-                ++link_count;
-            }
+            if (get_link(&n->links, j)->type == LINK_OUTBOUND) ++link_count;
+            else ++inbound;
         }
+        const_count += editor->conf->nodes[n->type].input_count - inbound;
+        prop_count += editor->conf->nodes[n->type].prop_count;
     }
 
-    /* write link count */
-    temp = SDL_RWtell(file);
-    SDL_RWseek(file, pos, RW_SEEK_SET);
-    SDL_WriteLE32(file, link_count);
-    SDL_RWseek(file, temp, RW_SEEK_SET);
+    if (!graph_file_begin(view, (int)editor->node_count, link_count, const_count, prop_count))
+        return 0;
 
-    /* reserve space for const input count */
-    pos = SDL_RWtell(file);
-    SDL_WriteLE32(file, 0);
+    view->generation = generation;
+    view->scroll_x = editor->scrolling.x;
+    view->scroll_y = editor->scrolling.y;
+    link_it = view->links;
+    const_it = view->consts;
+    prop_it = view->props;
 
-    /* write const inputs */
-    int const_inputs = 0;
     for (int i = 0; i < editor->node_count; ++i)
     {
         struct node *n = &editor->nodes[i];
-        char is_const[16];
-        memset(is_const, 1, NK_LEN(is_const));
+        struct node_info *info = &editor->conf->nodes[n->type];
+
+        view->nodes[i].type = n->type;
+        view->nodes[i].x = n->bounds.x;
+        view->nodes[i].y = n->bounds.y;
+
         for (int j = 0; j < n->links.size; ++j)
         {
             struct node_link *link = get_link(&n->links, j);
-            if (link->type == LINK_INBOUND) is_const[link->slot] = 0;
+            if (link->type == LINK_OUTBOUND)
+            {
+                link_it->in_id = i;
+                link_it->in_slot = link->slot;
+                link_it->out_id = link->other_id;
+                link_it->out_slot = link->other_slot;
+                ++link_it;
+            }
         }
-        for (int j = 0; j < editor->conf->nodes[n->type].input_count; ++j)
+        for (int j = 0; j < info->input_count; ++j)
         {
-            if (is_const[j])
+            if (!find_node_input(n, j))
             {
-                SDL_WriteLE32(file, i);
-                SDL_WriteLE32(file, *((uint32_t*)(&n->consts[j])));
-                SDL_WriteU8(file, (uint8_t)j);
-                ++const_inputs;
+                const_it->node_id = i;
+                const_it->slot = j;
+                const_it->value = n->consts[j];
+                ++const_it;
             }
         }
+        for (int j = 0; j < info->prop_count; ++j)
+        {
+            prop_it->node_id = i;
+            prop_it->slot = j;
+            prop_it->value = n->props[j].i;
+            ++prop_it;
+        }
     }
 
-    /* write const input count */
-    temp = SDL_RWtell(file);
-    SDL_RWseek(file, pos, RW_SEEK_SET);
-    SDL_WriteLE32(file, const_inputs);
-    SDL_RWseek(file, temp, RW_SEEK_SET);
+    graph_file_end(view);
+    return 1;
+}
 
-    /* reserve space for property count */
-    pos = SDL_RWtell(file);
-    SDL_WriteLE32(file, 0);
+/* snapshot path without its .aig extension, used to name journal files */
+static char*
+node_editor_base_path(const char *path)
+{
+    char *base = _strdup(path);
+    size_t len = strlen(base);
+    if (len > 4 && !strcmp(base + len - 4, ".aig")) base[len - 4] = '\0';
+    return base;
+}
 
-    /* write properties */
-    int property_count = 0;
-    for (int i = 0; i < editor->node_count; ++i)
+/*
+ * Snapshots the graph as the journal's next generation and hands it to a
+ * worker thread that compresses (if `compress` is set), writes and syncs the
+ * file; node_editor_update reports the outcome and rotates the journal.
+ */
+static void
+node_editor_start_save(struct node_editor *editor, char *path, int compress)
+{
+    struct journal *journal = editor->journal;
+    struct graph_view view;
+
+    if (!node_editor_flatten(editor, &view, journal->generation + 1))
     {
-        struct node *n = &editor->nodes[i];
-        struct node_info *info = &editor->conf->nodes[n->type];
-        for (int j = 0; j < info->prop_count; ++j)
+        editor_printf(editor, "error: %s", SDL_GetError());
+        return;
+    }
+
+    if (!journal_begin_rotation(journal))
+    {
+        editor_print(editor, "error: couldn't create the edit journal");
+        journal_abort_rotation(journal);
+        graph_view_free(&view);
+        return;
+    }
+
+    editor->save = save_job_start(&view, path, compress);
+    if (!editor->save)
+    {
+        editor_printf(editor, "error: %s", SDL_GetError());
+        journal_abort_rotation(journal);
+        graph_view_free(&view);
+    }
+}
+
+/* saves the graph and keeps journaling further edits next to the file */
+static void
+node_editor_save(struct node_editor *editor, char *path, int compress)
+{
+    char *base;
+
+    if (editor->save)
+    {
+        editor_print(editor, "error: a save is already in progress");
+        return;
+    }
+
+    base = node_editor_base_path(path);
+    if (!editor->journal || strcmp(editor->journal->base, base))
+    {
+        /* the previous file keeps its own snapshot and journal */
+        if (editor->journal) journal_cleanup(editor->journal);
+        else editor->journal = malloc(sizeof *editor->journal);
+        journal_init(editor->journal, base, 0, compress);
+    }
+    editor->journal->compress = compress;
+    free(base);
+
+    node_editor_start_save(editor, path, compress);
+}
+
+static void
+node_editor_finish_save(struct node_editor *editor)
+{
+    struct save_job *job = editor->save;
+    struct journal *journal = editor->journal;
+
+    if (journal && journal->next.file)
+    {
+        if (job->ok) journal_commit_rotation(journal);
+        else journal_abort_rotation(journal);
+        if (!journal->current.file)
         {
-            SDL_WriteLE32(file, i);
-            SDL_WriteLE32(file, (uint32_t)n->props[j].i);
-            SDL_WriteU8(file, (uint8_t)j);
-            ++property_count;
+            journal_cleanup(journal);
+            free(journal);
+            editor->journal = NULL;
         }
     }
 
-    /* write property count */
-    temp = SDL_RWtell(file);
-    SDL_RWseek(file, pos, RW_SEEK_SET);
-    SDL_WriteLE32(file, property_count);
-    SDL_RWseek(file, temp, RW_SEEK_SET);
-
-    if (SDL_RWclose(file) == -1)
-        editor_print(editor, SDL_GetError());
+    if (!job->ok)
+        editor_printf(editor, "error: %s", job->message);
+    else if (job->compress)
+        editor_printf(editor, "successfully saved into file '%s' (%d%% of %d bytes)", job->path,
+            (int)(job->written * 100 / job->view.storage_size), (int)job->view.storage_size);
     else
-        editor_printf(editor, "successfully saved into file '%s'", path);
+        editor_printf(editor, "successfully saved into file '%s'", job->path);
+
+    save_job_finish(job);
+    editor->save = NULL;
+}
+
+/*
+ * Called once per frame: reports finished background saves, flushes the
+ * edit journal every JOURNAL_FLUSH_INTERVAL and folds it into a new snapshot
+ * once it outgrows the graph.
+ */
+static void node_editor_check_config(struct node_editor *editor);
+
+static void
+node_editor_update(struct node_editor *editor)
+{
+    struct journal *journal;
+
+    if (editor->save && save_job_done(editor->save))
+        node_editor_finish_save(editor);
+
+    if (editor->watch) node_editor_check_config(editor);
+
+    if (editor->library && !library_update(editor->library))
+        editor_printf(editor, "error: %s", SDL_GetError());
+
+    journal = editor->journal;
+    if (!journal) return;
+
+    if (journal_should_flush(journal) && !journal_flush(journal))
+        editor_print(editor, "error: couldn't write the edit journal");
+
+    if (!editor->save && journal->current.size > JOURNAL_COMPACT_MIN_BYTES &&
+        journal->current.size > editor->node_count * sizeof(struct aig_node) * 4)
+    {
+        char path[1024];
+        snprintf(path, sizeof path, "%s.aig", journal->base);
+        node_editor_start_save(editor, path, journal->compress);
+    }
 }
 
 static void node_editor_clear(struct node_editor *editor)
 {
     struct config *config = editor->conf;
-    struct print_ops *console = editor->console;
+    struct console *console = editor->console;
+    struct save_job *save = editor->save;
+    struct journal *journal = editor->journal;
+    struct compile_cache *cache = editor->cache;
+    struct library *library = editor->library;
+    struct config_watch *watch = editor->watch;
+    editor->save = NULL;
+    editor->journal = NULL;
+    editor->cache = NULL;
+    editor->library = NULL;
+    editor->watch = NULL;
     node_editor_cleanup(editor);
     node_editor_init(editor, config, console);
+    editor->save = save;
+    editor->journal = journal;
+    editor->cache = cache;
+    editor->library = library;
+    editor->watch = watch;
+}
+
+/* replaces the editor contents with a validated graph view */
+static void
+node_editor_load_view(struct node_editor *editor, struct graph_view *view)
+{
+    node_editor_clear(editor);
+
+    editor->nodes = malloc((view->node_count ? view->node_count : 1) * sizeof *editor->nodes);
+    editor->nodes_capacity = view->node_count;
+    for (int i = 0; i < view->node_count; ++i)
+        node_editor_add(editor, (node_type)view->nodes[i].type, view->nodes[i].x, view->nodes[i].y);
+
+    /* size every link list exactly before linking */
+    for (int i = 0; i < view->link_count; ++i)
+    {
+        ++editor->nodes[view->links[i].in_id].links.capacity;
+        ++editor->nodes[view->links[i].out_id].links.capacity;
+    }
+    for (int i = 0; i < view->node_count; ++i)
+    {
+        struct node_link_list *list = &editor->nodes[i].links;
+        if (list->capacity) list->links = malloc(list->capacity * sizeof *list->links);
+    }
+    for (int i = 0; i < view->link_count; ++i)
+    {
+        struct aig_link *l = &view->links[i];
+        node_editor_link(editor, l->in_id, l->in_slot, l->out_id, l->out_slot);
+    }
+
+    for (int i = 0; i < view->const_count; ++i)
+        editor->nodes[view->consts[i].node_id].consts[view->consts[i].slot] = view->consts[i].value;
+    for (int i = 0; i < view->prop_count; ++i)
+        editor->nodes[view->props[i].node_id].props[view->props[i].slot].i = view->props[i].value;
+
+    editor->scrolling = nk_vec2(view->scroll_x, view->scroll_y);
+}
+
+/*
+ * Applies journal records on top of the loaded snapshot. Stops at the first
+ * record that doesn't fit the graph and returns how many were applied.
+ */
+static int
+node_editor_replay(struct node_editor *editor, struct journal_record *records, int count)
+{
+    struct node_info *infos = editor->conf->nodes;
+    struct property_info *prop;
+    int n = (int)editor->node_count;
+
+#define NODE_OK(id) ((id) >= 0 && (id) < n)
+    for (int i = 0; i < count; ++i)
+    {
+        struct journal_record *r = &records[i];
+        int32_t *a = r->args;
+        n = (int)editor->node_count;
+        switch (r->op)
+        {
+            case JOURNAL_ADD:
+                if (a[0] < 0 || a[0] >= editor->conf->node_count) return i;
+                node_editor_add(editor, (node_type)a[0], journal_to_float(a[1]), journal_to_float(a[2]));
+                break;
+            case JOURNAL_DELETE:
+                if (!NODE_OK(a[0])) return i;
+                node_editor_delete(editor, a[0]);
+                break;
+            case JOURNAL_LINK:
+            case JOURNAL_UNLINK:
+                if (!NODE_OK(a[0]) || !NODE_OK(a[2]) || a[0] == a[2] ||
+                    a[1] < 0 || a[1] >= infos[editor->nodes[a[0]].type].output_count ||
+                    a[3] < 0 || a[3] >= infos[editor->nodes[a[2]].type].input_count)
+                    return i;
+                if (r->op == JOURNAL_UNLINK)
+                    node_editor_unlink(editor, a[0], a[1], a[2], a[3]);
+                else if (find_node_input(&editor->nodes[a[2]], a[3]))
+                    return i;
+                else
+                    node_editor_link(editor, a[0], a[1], a[2], a[3]);
+                break;
+            case JOURNAL_CONST:
+                if (!NODE_OK(a[0]) || a[1] < 0 || a[1] >= infos[editor->nodes[a[0]].type].input_count)
+                    return i;
+                node_editor_set_const(editor, a[0], a[1], journal_to_float(a[2]));
+                break;
+            case JOURNAL_PROP:
+                if (!NODE_OK(a[0]) || a[1] < 0 || a[1] >= infos[editor->nodes[a[0]].type].prop_count)
+                    return i;
+                prop = &infos[editor->nodes[a[0]].type].props[a[1]];
+                if (prop->type == FIELD_ENUM && (a[2] < 0 || a[2] >= editor->conf->enums[prop->enum_type].count))
+                    return i;
+                node_editor_set_prop(editor, a[0], a[1], a[2]);
+                break;
+            case JOURNAL_MOVE:
+                if (!NODE_OK(a[0])) return i;
+                node_editor_move(editor, a[0], journal_to_float(a[1]), journal_to_float(a[2]));
+                break;
+            default:
+                return i;
+        }
+    }
+#undef NODE_OK
+    return count;
 }
 
+/*
+ * Loads a snapshot, replays the edits journaled since it was written (which
+ * is also how a crashed session is recovered) and keeps journaling.
+ */
 static void
 node_editor_load(struct node_editor *editor, char *path)
 {
-#define READ(dst, size, n) do { if (!SDL_RWread(file, dst, size, n)) goto error; } while(0)
-#define SEEK(offset, mode) do { if (SDL_RWseek(file, offset, mode) == -1) goto error; } while(0)
-#define FAIL_IF(cond) do { if ((cond)) goto error; } while(0)
+    struct graph_view view;
+    struct journal_record *records;
+    int count, applied;
+    char *base;
 
-    struct node_data {
-        node_type type;
-        float x, y;
-    };
+    if (editor->save)
+    {
+        editor_print(editor, "error: wait for the save in progress to finish");
+        return;
+    }
 
-    struct link_data {
-        int input_id, output_id;
-        int input_slot, output_slot;
-    };
+    if (!graph_view_open(&view, path) || !graph_view_validate(&view, editor->conf))
+    {
+        editor_printf(editor, "error: %s", SDL_GetError());
+        graph_view_free(&view);
+        return;
+    }
 
-    struct const_data {
-        int node_id;
-        int node_slot;
-        float value;
-    };
+    if (editor->journal)
+    {
+        journal_cleanup(editor->journal);
+        free(editor->journal);
+        editor->journal = NULL;
+    }
 
-    struct property_data {
-        int node_id;
-        int idx;
-        int value;
-    };
+    node_editor_load_view(editor, &view);
 
-    SDL_RWops *file = SDL_RWFromFile(path, "r");
-    struct nk_vec2 scroll;
-    struct node_data *nodes = NULL;
-    struct link_data *links = NULL;
-    struct const_data *consts = NULL;
-    struct property_data *props = NULL;
+    editor_printf(editor, "file loaded: %d nodes, %d links, %d consts, %d properties",
+        view.node_count, view.link_count, view.const_count, view.prop_count);
 
-    if (!file) { editor_print(editor, SDL_GetError()); return; }
+    base = node_editor_base_path(path);
+    if (!journal_read(base, view.generation, &records, &count))
+    {
+        editor_print(editor, "error: out of memory while reading the edit journal");
+        free(base);
+        graph_view_free(&view);
+        return;
+    }
 
-    /* read magic */
-    char magic[8];
-    READ(&magic, 1, NK_LEN(magic));
-    if (strcmp(magic, "aigraph"))
+    applied = node_editor_replay(editor, records, count);
+    if (applied < count)
+        editor_printf(editor, "warning: edit journal is invalid after record %d, dropped %d edits",
+            applied, count - applied);
+    if (applied)
+        editor_printf(editor, "recovered %d edits from the edit journal", applied);
+
+    /* rewrite the journal without any torn or invalid tail and keep appending to it */
+    editor->journal = malloc(sizeof *editor->journal);
+    journal_init(editor->journal, base, view.generation, view.compressed);
+    if (!journal_file_create(&editor->journal->current, base, view.generation, records, applied))
     {
-        editor_print(editor, "error: invalid file");
-        goto cleanup;
+        editor_print(editor, "error: couldn't create the edit journal");
+        journal_cleanup(editor->journal);
+        free(editor->journal);
+        editor->journal = NULL;
+    }
+
+    free(records);
+    free(base);
+    graph_view_free(&view);
+}
+
+
+/* writes the graph as text, see text_format.h */
+static void
+node_editor_export(struct node_editor *editor, char *path)
+{
+    struct graph_view view;
+
+    if (!node_editor_flatten(editor, &view, 0))
+    {
+        editor_printf(editor, "error: %s", SDL_GetError());
+        return;
+    }
+    /* the text writer reads host-order records */
+    aig_swap_records(&view);
+
+    if (text_format_save(&view, path, editor->conf))
+        editor_printf(editor, "successfully exported into file '%s'", path);
+    else
+        editor_printf(editor, "error: %s", SDL_GetError());
+    graph_view_free(&view);
+}
+
+/* replaces the graph with a text graph; the journal stays detached until the next save */
+static void
+node_editor_import(struct node_editor *editor, char *path)
+{
+    struct graph_view view;
+
+    if (editor->save)
+    {
+        editor_print(editor, "error: wait for the save in progress to finish");
+        return;
+    }
+
+    if (!text_format_read(&view, path, editor->conf))
+    {
+        editor_printf(editor, "error: %s", SDL_GetError());
+        return;
+    }
+    if (!graph_view_validate(&view, editor->conf))
+    {
+        editor_printf(editor, "error: %s: %s", path, SDL_GetError());
+        text_view_free(&view);
+        return;
+    }
+
+    if (editor->journal)
+    {
+        journal_cleanup(editor->journal);
+        free(editor->journal);
+        editor->journal = NULL;
     }
+    node_editor_load_view(editor, &view);
+    editor_printf(editor, "file imported: %d nodes, %d links, %d consts, %d properties",
+        view.node_count, view.link_count, view.const_count, view.prop_count);
+    text_view_free(&view);
+}
+
+/* compiles the graph into a malloc'ed compiled_graph, NULL and the SDL error on failure; see compile_graph_view_flags */
+static struct compiled_graph*
+node_editor_compile(struct node_editor *editor, int flags)
+{
+    struct graph_view view;
+    struct compiled_graph *g = malloc(sizeof *g);
+    int ok;
+
+    if (!g) { SDL_SetError("out of memory"); return NULL; }
+    if (!node_editor_flatten(editor, &view, 0)) { free(g); return NULL; }
+    aig_swap_records(&view);
+    ok = compile_graph_view_flags(g, &view, editor->conf, flags);
+    graph_view_free(&view);
+    if (!ok) { free(g); return NULL; }
+    return g;
+}
+
+typedef int (*compiled_graph_run_func)(struct compiled_graph *g, float *registers, const float *inputs,
+    struct aigc_event *events);
 
-    /* read scroll */
-    READ(&scroll, sizeof scroll, 1);
+/* fills `count` global slots with pseudo-random values for benchmarks; returns NULL when out of memory */
+static float*
+node_editor_bench_globals(uint32_t count)
+{
+    float *globals = malloc((count + 1) * sizeof *globals);
+    uint32_t seed = 7;
+
+    for (uint32_t i = 0; globals && i < count; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        globals[i] = (float)(seed >> 16 & 0x7fff) / 0x4000 - 1;
+    }
+    return globals;
+}
 
-    /* read nodes */
-    int node_count = (int)SDL_ReadLE32(file);
-    FAIL_IF(node_count < 0 || node_count > 4096);
-    if (node_count)
+/*
+ * Best time of a few passes running `g` once for each of `agents` agents,
+ * whose inputs are laid out one agent after the other, in nanoseconds per
+ * agent. Each pass is a tick: the uniform prologue runs once, on
+ * `globals`, and the agents share its results.
+ */
+static double
+node_editor_bench_run(struct compiled_graph *g, compiled_graph_run_func run, float *registers, const float *globals,
+    const float *inputs, struct aigc_event *events, int agents)
+{
+    double best = 0;
+    for (int pass = 0; pass < 8; ++pass)
     {
-        nodes = malloc(node_count * sizeof *nodes);
-        for (int i = 0; i < node_count; ++i)
+        Uint64 start = SDL_GetPerformanceCounter();
+        double ns;
+        compiled_graph_init_registers(g, registers);
+        compiled_graph_run_uniform(g, registers, globals);
+        for (int i = 0; i < agents; ++i)
+            run(g, registers, inputs + (size_t)i * g->header->input_count, events);
+        ns = (SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency() / agents;
+        if (pass == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+#define NODE_EDITOR_BENCH_BATCH 256
+
+/*
+ * The same through compiled_graph_run_batch, NODE_EDITOR_BENCH_BATCH agents
+ * at a time; `inputs` holds a block of input rows per batch. Returns 0 when
+ * out of memory.
+ */
+static double
+node_editor_bench_batch(struct compiled_graph *g, const float *globals, const float *inputs, int agents)
+{
+    size_t stride = NODE_EDITOR_BENCH_BATCH;
+    float *registers = malloc(((size_t)g->header->register_count * stride + 1) * sizeof *registers);
+    float *uniform = malloc((g->header->register_count + 1) * sizeof *uniform);
+    struct aigc_event *events = malloc(((size_t)g->header->event_count * stride + 1) * sizeof *events);
+    double best = 0;
+
+    for (int pass = 0; registers && uniform && events && pass < 8; ++pass)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        double ns;
+        compiled_graph_init_registers(g, uniform);
+        compiled_graph_run_uniform(g, uniform, globals);
+        for (size_t i = 0; i < (size_t)agents; i += stride)
         {
-            node_type type = (node_type)SDL_ReadLE16(file);
-            uint32_t x_int = SDL_ReadLE32(file);
-            uint32_t y_int = SDL_ReadLE32(file);
-            FAIL_IF(type < 0 || type >= editor->conf->node_count);
-            nodes[i].type = type;
-            nodes[i].x = *((float*)(&x_int));
-            nodes[i].y = *((float*)(&y_int));
+            size_t count = SDL_min(stride, (size_t)agents - i);
+            compiled_graph_init_batch(g, registers, stride, count, uniform);
+            compiled_graph_run_batch(g, registers, stride, count, inputs + i * g->header->input_count, events);
         }
+        ns = (SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency() / agents;
+        if (pass == 0 || ns < best) best = ns;
     }
+    free(registers);
+    free(uniform);
+    free(events);
+    return best;
+}
 
-    /* read links */
-    int link_count = (int)SDL_ReadLE32(file);
-    FAIL_IF(link_count < 0 || link_count > node_count * node_count);
-    if (link_count)
+/*
+ * The same through wavefront_run on a pool with a thread per core, for
+ * programs with parallel segments. Returns 0 when there's no worker
+ * thread or no memory.
+ */
+static double
+node_editor_bench_wavefront(struct compiled_graph *g, float *registers, const float *globals, const float *inputs,
+    struct aigc_event *events, int agents)
+{
+    struct job_pool pool;
+    struct wavefront w;
+    double best = 0;
+
+    if (!jobs_init(&pool, -1))
+    {
+        jobs_cleanup(&pool);
+        return 0;
+    }
+    if (wavefront_init(&w, g, &pool) && wavefront_parallel(&w))
     {
-        links = malloc(link_count * sizeof *links);
-        for (int i = 0; i < link_count; ++i)
+        for (int pass = 0; pass < 8; ++pass)
         {
-            int ii = (int)SDL_ReadLE32(file);
-            int oi = (int)SDL_ReadLE32(file);
-            int is = (int)SDL_ReadU8(file);
-            int os = (int)SDL_ReadU8(file);
-            FAIL_IF(ii < 0 || ii >= node_count);
-            FAIL_IF(oi < 0 || oi >= node_count);
-            FAIL_IF(is < 0);
-            FAIL_IF(os < 0);
-            links[i].input_id = ii;
-            links[i].output_id = oi;
-            links[i].input_slot = is;
-            links[i].output_slot = os;
+            Uint64 start = SDL_GetPerformanceCounter();
+            double ns;
+            compiled_graph_init_registers(g, registers);
+            compiled_graph_run_uniform(g, registers, globals);
+            for (int i = 0; i < agents; ++i)
+                wavefront_run(&w, registers, inputs + (size_t)i * g->header->input_count, events);
+            ns = (SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency() / agents;
+            if (pass == 0 || ns < best) best = ns;
         }
     }
+    wavefront_free(&w);
+    jobs_cleanup(&pool);
+    return best;
+}
+
+/*
+ * Measures interpreter dispatch on the open graph: compiles it as is,
+ * without superinstruction fusion and hoisting only global reads into the
+ * uniform prologue, and times each program under switch and threaded
+ * dispatch, in batches with the active ISA's kernels and, when it has
+ * parallel segments, split across cores by wavefront, over `agents`
+ * agents with pseudo-random inputs and globals. Times are per agent and
+ * per instruction run per agent, which leaves out the prologue's.
+ */
+static void
+node_editor_bench(struct node_editor *editor, int agents)
+{
+    static const char *names[] = { "fused", "unfused", "unhoisted" };
+    static const int flags[] = { 0, COMPILE_NO_FUSION, COMPILE_NO_UNIFORM };
 
-    /* read consts */
-    int const_count = (int)SDL_ReadLE32(file);
-    FAIL_IF(const_count < 0);
-    if (const_count)
+    for (int v = 0; v < 3; ++v)
     {
-        consts = malloc(const_count * sizeof *consts);
-        for (int i = 0; i < const_count; ++i)
+        struct compiled_graph *g = node_editor_compile(editor, flags[v]);
+        float *registers, *inputs, *globals;
+        uint32_t per_agent;
+        struct aigc_event *events;
+        uint32_t seed = 1;
+        double ns;
+
+        if (!g)
+        {
+            editor_printf(editor, "error: %s", SDL_GetError());
+            return;
+        }
+        registers = malloc((g->header->register_count + 1) * sizeof *registers);
+        /* rounded up to whole batches */
+        inputs = malloc(((size_t)g->header->input_count * (agents + NODE_EDITOR_BENCH_BATCH) + 1) * sizeof *inputs);
+        events = malloc((g->header->event_count + 1) * sizeof *events);
+        globals = node_editor_bench_globals(g->header->global_count);
+        per_agent = g->header->instruction_count - g->header->uniform_count;
+        if (!registers || !inputs || !events || !globals)
         {
-            int id = (int)SDL_ReadLE32(file);
-            uint32_t value = SDL_ReadLE32(file);
-            int slot = (int)SDL_ReadU8(file);
-            FAIL_IF(id < 0 || id >= node_count);
-            FAIL_IF(slot < 0);
-            consts[i].node_id = id;
-            consts[i].node_slot = slot;
-            consts[i].value = *((float*)(&value));
+            editor_print(editor, "error: out of memory");
         }
+        else
+        {
+            for (size_t i = 0; i < (size_t)g->header->input_count * (agents + NODE_EDITOR_BENCH_BATCH); ++i)
+            {
+                seed = seed * 1103515245 + 12345;
+                inputs[i] = (float)(seed >> 16 & 0x7fff) / 0x4000 - 1;
+            }
+            editor_printf(editor, "bench %s: %u instructions, %u of them in the uniform prologue",
+                names[v], g->header->instruction_count, g->header->uniform_count);
+            ns = node_editor_bench_run(g, compiled_graph_run_switch, registers, globals, inputs, events, agents);
+            editor_printf(editor, "bench %s, %u instructions: switch %.1f ns per agent, %.2f ns per instruction",
+                names[v], g->header->instruction_count, ns, ns / SDL_max(per_agent, 1));
+#ifdef AIGC_THREADED
+            ns = node_editor_bench_run(g, compiled_graph_run_threaded, registers, globals, inputs, events, agents);
+            editor_printf(editor, "bench %s, %u instructions: threaded %.1f ns per agent, %.2f ns per instruction",
+                names[v], g->header->instruction_count, ns, ns / SDL_max(per_agent, 1));
+#endif
+            ns = node_editor_bench_batch(g, globals, inputs, agents);
+            editor_printf(editor, "bench %s, %u instructions: batches of %d with %s kernels %.1f ns per agent, "
+                "%.2f ns per instruction", names[v], g->header->instruction_count, NODE_EDITOR_BENCH_BATCH,
+                kernel_isa_names[kernel_isa_active()], ns, ns / SDL_max(per_agent, 1));
+            if (g->header->parallel_count)
+            {
+                ns = node_editor_bench_wavefront(g, registers, globals, inputs, events, agents);
+                if (ns > 0)
+                {
+                    editor_printf(editor, "bench %s, %u instructions: wavefront on %d cores %.1f ns per agent, "
+                        "%u instructions in parallel segments", names[v], g->header->instruction_count,
+                        SDL_GetCPUCount(), ns, g->header->parallel_count);
+                }
+                else
+                {
+                    editor_printf(editor, "bench %s: %u instructions in parallel segments, but no worker threads",
+                        names[v], g->header->parallel_count);
+                }
+            }
+        }
+        free(registers);
+        free(inputs);
+        free(events);
+        free(globals);
+        compiled_graph_free(g);
+        free(g);
     }
+}
 
-    /* read properties */
-    int property_count = (int)SDL_ReadLE32(file);
-    FAIL_IF(property_count < 0);
-    if (property_count)
+/* the compile cache, created on first use */
+static struct compile_cache*
+node_editor_cache(struct node_editor *editor)
+{
+    if (!editor->cache)
     {
-        props = malloc(property_count * sizeof *props);
-        for (int i = 0; i < property_count; ++i)
+        editor->cache = malloc(sizeof *editor->cache);
+        compile_cache_init(editor->cache, COMPILE_CACHE_DEFAULT_DIR, editor->conf);
+    }
+    return editor->cache;
+}
+
+/*
+ * Compiles the graph through the compile cache, so an unchanged graph is
+ * never compiled twice, and writes the program as a .aigc file for the
+ * runtime.
+ */
+static void
+node_editor_compile_file(struct node_editor *editor, char *path)
+{
+    struct graph_view view;
+    struct compiled_graph *g;
+    int hit;
+
+    if (!node_editor_flatten(editor, &view, 0))
+    {
+        editor_printf(editor, "error: %s", SDL_GetError());
+        return;
+    }
+    aig_swap_records(&view);
+    g = compile_cache_get(node_editor_cache(editor), &view, &hit);
+    graph_view_free(&view);
+
+    if (!g)
+        editor_printf(editor, "error: %s", SDL_GetError());
+    else if (compiled_graph_save(g, path))
+        editor_printf(editor, "%s into file '%s': graph %08x%08x, %u instructions, %u registers for %u values, %u constants, "
+            "%u of %u nodes eliminated (%u folded, %u merged, %u dead), %u fused, %u uniform",
+            hit ? "cached compile written" : "compiled", path,
+            (uint32_t)(g->header->graph_hash >> 32), (uint32_t)g->header->graph_hash,
+            g->header->instruction_count, g->header->register_count, g->header->value_count, g->header->const_count,
+            g->header->folded_count + g->header->merged_count + g->header->dead_count, g->header->node_count,
+            g->header->folded_count, g->header->merged_count, g->header->dead_count, g->header->fused_count,
+            g->header->uniform_count);
+    else
+        editor_printf(editor, "error: %s", SDL_GetError());
+}
+
+/*
+ * Compiles the graph component by component through the compile cache,
+ * see compile_cache_split, then times the programs running in parallel
+ * against the whole graph's program, both in batches, over `agents`
+ * agents with pseudo-random inputs.
+ */
+static void
+node_editor_split(struct node_editor *editor, int agents)
+{
+    struct graph_view view;
+    struct compiled_split split;
+    struct compiled_graph *whole = NULL;
+    struct job_pool pool;
+    float *inputs = NULL, *globals = NULL;
+    struct aigc_event *events = NULL;
+    size_t stride = NODE_EDITOR_BENCH_BATCH, input_count;
+    double compile_ms, split_ns = 0, whole_ns;
+    uint32_t seed = 1, instructions = 0;
+    Uint64 start;
+    int ok;
+
+    if (!node_editor_flatten(editor, &view, 0))
+    {
+        editor_printf(editor, "error: %s", SDL_GetError());
+        return;
+    }
+    aig_swap_records(&view);
+    if (!jobs_init(&pool, -1))
+    {
+        editor_print(editor, "error: couldn't start worker threads");
+        jobs_cleanup(&pool);
+        graph_view_free(&view);
+        return;
+    }
+    start = SDL_GetPerformanceCounter();
+    ok = compile_cache_split(node_editor_cache(editor), &pool, &view, &split);
+    compile_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    graph_view_free(&view);
+    if (!ok)
+    {
+        editor_printf(editor, "error: %s", SDL_GetError());
+        jobs_cleanup(&pool);
+        return;
+    }
+    for (int k = 0; k < split.count; ++k) instructions += split.graphs[k]->header->instruction_count;
+    editor_printf(editor, "split into %d components, %d programs of %u instructions: %d unchanged, %d compiled in %.1f ms",
+        split.component_count, split.count, instructions, split.unchanged, split.count - split.unchanged, compile_ms);
+
+    whole = node_editor_compile(editor, 0);
+    if (!whole)
+    {
+        editor_printf(editor, "error: %s", SDL_GetError());
+        goto cleanup;
+    }
+    /* the programs read the input slots the whole graph does; rounded up to whole batches */
+    input_count = whole->header->input_count;
+    inputs = malloc((input_count * (agents + stride) + 1) * sizeof *inputs);
+    events = malloc(((size_t)compiled_split_event_count(&split) * stride + 1) * sizeof *events);
+    globals = node_editor_bench_globals(SDL_max(whole->header->global_count, split.global_count));
+    if (!inputs || !events || !globals)
+    {
+        editor_print(editor, "error: out of memory");
+        goto cleanup;
+    }
+    for (size_t i = 0; i < input_count * (agents + stride); ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        inputs[i] = (float)(seed >> 16 & 0x7fff) / 0x4000 - 1;
+    }
+    for (int pass = 0; pass < 8; ++pass)
+    {
+        double ns;
+        start = SDL_GetPerformanceCounter();
+        for (size_t i = 0; i < (size_t)agents; i += stride)
         {
-            int id = (int)SDL_ReadLE32(file);
-            int value = (int)SDL_ReadLE32(file);
-            int idx = (int)SDL_ReadU8(file);
-            FAIL_IF(id < 0 || id >= node_count);
-            FAIL_IF(idx < 0);
-            props[i].node_id = id;
-            props[i].value = value;
-            props[i].idx = idx;
+            size_t count = SDL_min(stride, (size_t)agents - i);
+            if (compiled_split_run_batch(&split, &pool, globals, stride, count, inputs + i * input_count, events) < 0)
+            {
+                editor_printf(editor, "error: %s", SDL_GetError());
+                goto cleanup;
+            }
         }
+        ns = (SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency() / agents;
+        if (pass == 0 || ns < split_ns) split_ns = ns;
     }
+    whole_ns = node_editor_bench_batch(whole, globals, inputs, agents);
+    editor_printf(editor, "split programs on %d threads %.1f ns per agent, whole graph %.1f ns per agent, "
+        "batches of %d", jobs_worker_count(&pool), split_ns, whole_ns, NODE_EDITOR_BENCH_BATCH);
 
-    node_editor_clear(editor);
+cleanup:
+    if (whole) compiled_graph_free(whole);
+    free(whole);
+    free(inputs);
+    free(globals);
+    free(events);
+    compiled_split_free(&split);
+    jobs_cleanup(&pool);
+}
 
-    /* TODO verify data */
-    for (int i = 0; i < node_count; ++i)
-        node_editor_add(editor, nodes[i].type, nodes[i].x, nodes[i].y);
-    for (int i = 0; i < link_count; ++i)
-        node_editor_link(editor, links[i].input_id, links[i].input_slot,
-            links[i].output_id, links[i].output_slot);
-    for (int i = 0; i < const_count; ++i)
-        editor->nodes[consts[i].node_id].consts[consts[i].node_slot] =
-            consts[i].value;
-    for (int i = 0; i < property_count; ++i)
-        editor->nodes[props[i].node_id].props[props[i].idx].i =
-            props[i].value;
-    editor->scrolling = scroll;
+/*
+ * Builds the graph's native code as `base`.c and its shared library,
+ * checks it against the interpreter and times both over `agents` agents.
+ */
+static void
+node_editor_native(struct node_editor *editor, const char *base, int agents)
+{
+    struct compiled_graph *g = node_editor_compile(editor, 0);
+    struct native_graph ng;
+    float *registers = NULL, *inputs = NULL, *globals = NULL;
+    struct aigc_event *events = NULL;
+    double native_ns = 0, interpreter_ns;
+    uint32_t seed = 1;
+
+    if (!g || !native_graph_build(&ng, g, base))
+    {
+        editor_printf(editor, "error: %s", SDL_GetError());
+        if (g) compiled_graph_free(g);
+        free(g);
+        return;
+    }
 
-    editor_printf(editor, "file loaded: %d nodes, %d links, %d consts, %d properties",
-        node_count, link_count, const_count, property_count);
+    registers = malloc((g->header->register_count + 1) * sizeof *registers);
+    inputs = malloc(((size_t)g->header->input_count * agents + 1) * sizeof *inputs);
+    events = malloc(((size_t)g->header->event_count * agents + 1) * sizeof *events);
+    globals = node_editor_bench_globals(g->header->global_count);
+    if (!registers || !inputs || !events || !globals)
+    {
+        editor_print(editor, "error: out of memory");
+        goto cleanup;
+    }
+    for (size_t i = 0; i < (size_t)g->header->input_count * agents; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        inputs[i] = (float)(seed >> 16 & 0x7fff) / 0x4000 - 1;
+    }
+    for (int pass = 0; pass < 8; ++pass)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        double ns;
+        compiled_graph_init_registers(g, registers);
+        compiled_graph_run_uniform(g, registers, globals);
+        native_graph_run(&ng, g, registers, inputs, agents, agents, events);
+        ns = (SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency() / agents;
+        if (pass == 0 || ns < native_ns) native_ns = ns;
+    }
+    /* the same random inputs, read agent by agent */
+    interpreter_ns = node_editor_bench_run(g, compiled_graph_run, registers, globals, inputs, events, agents);
+    editor_printf(editor, "native code of %u instructions in '%s" NATIVE_SUFFIX "' matches the interpreter: "
+        "%.1f ns per agent, interpreter %.1f ns per agent", g->header->instruction_count, base, native_ns, interpreter_ns);
 
-    if (0) {
-error:
-        editor_print(editor, "error while reading file", path);
+cleanup:
+    native_graph_close(&ng);
+    free(registers);
+    free(inputs);
+    free(globals);
+    free(events);
+    compiled_graph_free(g);
+    free(g);
+}
+
+#define NODE_EDITOR_INCREMENTAL_TICKS 8
+
+/*
+ * Simulates `agents` agents over a few ticks, `percent` of them getting
+ * new pseudo-random inputs each tick, through incremental_run and through
+ * compiled_graph_run, checks that they emit the same events and times
+ * both. The first tick, which every agent runs in full, isn't counted.
+ */
+static void
+node_editor_incremental(struct node_editor *editor, int agents, int percent)
+{
+    struct compiled_graph *g = node_editor_compile(editor, 0);
+    struct incremental inc;
+    struct incremental_agent *states = NULL;
+    float *registers = NULL, *uniform = NULL, *inputs = NULL, *globals = NULL;
+    struct aigc_event *expected = NULL, *events = NULL;
+    double incremental_ns = 0, full_ns = 0;
+    uint32_t seed = 1, input_count, event_count;
+
+    if (!g || !incremental_init(&inc, g, editor->conf))
+    {
+        editor_printf(editor, "error: %s", SDL_GetError());
+        if (g) compiled_graph_free(g);
+        free(g);
+        return;
+    }
+    input_count = g->header->input_count;
+    event_count = g->header->event_count;
+    registers = malloc((g->header->register_count + 1) * sizeof *registers);
+    uniform = malloc((g->header->register_count + 1) * sizeof *uniform);
+    inputs = malloc(((size_t)input_count * agents + 1) * sizeof *inputs);
+    globals = node_editor_bench_globals(g->header->global_count);
+    expected = malloc(((size_t)event_count * agents + 1) * sizeof *expected);
+    events = malloc(((size_t)event_count * agents + 1) * sizeof *events);
+    states = calloc(agents, sizeof *states);
+    if (!registers || !uniform || !inputs || !globals || !expected || !events || !states)
+        goto oom;
+    for (int i = 0; i < agents; ++i)
+        if (!incremental_agent_init(&inc, &states[i])) goto oom;
+    for (size_t i = 0; i < (size_t)input_count * agents; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        inputs[i] = (float)(seed >> 16 & 0x7fff) / 0x4000 - 1;
     }
+    compiled_graph_init_registers(g, uniform);
+    compiled_graph_run_uniform(g, uniform, globals);
+    memcpy(registers, uniform, g->header->register_count * sizeof *registers);
+
+    for (int tick = 0; tick <= NODE_EDITOR_INCREMENTAL_TICKS; ++tick)
+    {
+        size_t expected_count = 0, event_total = 0;
+        Uint64 start;
 
+        for (int i = 0; tick && i < agents; ++i)
+        {
+            seed = seed * 1103515245 + 12345;
+            if ((int)(seed >> 16 & 0x7fff) % 100 >= percent) continue;
+            for (uint32_t k = 0; k < input_count; ++k)
+            {
+                seed = seed * 1103515245 + 12345;
+                inputs[(size_t)i * input_count + k] = (float)(seed >> 16 & 0x7fff) / 0x4000 - 1;
+            }
+        }
+        if (tick == 1) incremental_clear_counters(&inc);
+
+        start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < agents; ++i)
+            expected_count += compiled_graph_run(g, registers, inputs + (size_t)i * input_count, expected + expected_count);
+        if (tick) full_ns += (SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency();
+
+        start = SDL_GetPerformanceCounter();
+        for (int i = 0; i < agents; ++i)
+            event_total += incremental_run(&inc, &states[i], uniform, inputs + (size_t)i * input_count, events + event_total);
+        if (tick) incremental_ns += (SDL_GetPerformanceCounter() - start) * 1e9 / SDL_GetPerformanceFrequency();
+
+        for (size_t e = 0; e < expected_count || e < event_total; ++e)
+        {
+            struct aigc_event *x = &expected[e], *y = &events[e];
+            if (e >= expected_count || e >= event_total || x->node != y->node || memcmp(&x->value, &y->value, sizeof x->value))
+            {
+                editor_printf(editor, "error: incremental evaluation differs from the interpreter on tick %d", tick);
+                goto cleanup;
+            }
+        }
+    }
+    incremental_ns /= (double)agents * NODE_EDITOR_INCREMENTAL_TICKS;
+    full_ns /= (double)agents * NODE_EDITOR_INCREMENTAL_TICKS;
+    editor_printf(editor, "incremental over %d agents, %d%% changing per tick: %.1f ns per agent, full evaluation %.1f ns "
+        "per agent; %.1f%% of instructions skipped in blocks of %d, %.1f%% of agent ticks idle",
+        agents, percent, incremental_ns, full_ns, incremental_skip_rate(&inc) * 100, INCREMENTAL_BLOCK,
+        inc.ticks ? inc.idle_ticks * 100.0 / inc.ticks : 0.0);
+    goto cleanup;
+
+oom:
+    editor_print(editor, "error: out of memory");
 cleanup:
-    if (nodes) free(nodes);
-    if (links) free(links);
-    if (consts) free(consts);
-    if (props) free(props);
-    SDL_RWclose(file);
-    return;
-
-#undef READ
-#undef SEEK
-#undef FAIL_IF
-}
\ No newline at end of file
+    for (int i = 0; states && i < agents; ++i) incremental_agent_free(&states[i]);
+    free(states);
+    free(registers);
+    free(uniform);
+    free(inputs);
+    free(globals);
+    free(expected);
+    free(events);
+    incremental_free(&inc);
+    compiled_graph_free(g);
+    free(g);
+}
+
+/* opens (or switches) the library browser on an asset directory, indexing new and changed graphs */
+static void
+node_editor_open_library(struct node_editor *editor, const char *dir)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    if (editor->library) library_cleanup(editor->library);
+    else editor->library = malloc(sizeof *editor->library);
+
+    if (!library_init(editor->library, dir, editor->conf))
+    {
+        editor_printf(editor, "error: %s", SDL_GetError());
+        library_cleanup(editor->library);
+        free(editor->library);
+        editor->library = NULL;
+        return;
+    }
+    editor_printf(editor, "library '%s': %d graphs indexed in %.1f ms", dir, editor->library->index.entry_count,
+        (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+/*
+ * Moves the graph onto `next`, a reloaded config, in one pass over the
+ * nodes. Types, ports and properties are matched by name: nodes whose type
+ * is gone are dropped, links lose either end are dropped, constants and
+ * property values follow their slot's name and enum values are matched by
+ * name too. Returns 0 when out of memory, leaving the graph as it was.
+ */
+static int
+node_editor_migrate(struct node_editor *editor, struct config *next, int *dropped_nodes, int *dropped_links)
+{
+    struct config *prev = editor->conf;
+    int *types, *base, *map, *ids, *old_types, total = 0, kept = 0, links = 0;
+    float **new_consts;
+    union node_property **new_props;
+
+    /* per old type: its new type, then new slots of its inputs, outputs and properties */
+    for (int t = 0; t < prev->node_count; ++t)
+        total += prev->nodes[t].input_count + prev->nodes[t].output_count + prev->nodes[t].prop_count;
+    types = malloc((2 * (size_t)prev->node_count + total + 2 * editor->node_count + 1) * sizeof *types);
+    new_consts = calloc(editor->node_count + 1, sizeof *new_consts);
+    new_props = calloc(editor->node_count + 1, sizeof *new_props);
+    if (!types || !new_consts || !new_props) goto oom;
+    base = types + prev->node_count;
+    map = base + prev->node_count;
+    ids = map + total;
+    old_types = ids + editor->node_count;
+
+    total = 0;
+    for (int t = 0; t < prev->node_count; ++t)
+    {
+        struct node_info *old = &prev->nodes[t];
+        int nt = config_find_type(next, old->name, (int)strlen(old->name));
+        types[t] = nt;
+        base[t] = total;
+        for (int i = 0; i < old->input_count; ++i, ++total)
+            map[total] = nt < 0 ? -1 : config_find_input(next, nt, old->inputs[i].name, (int)strlen(old->inputs[i].name));
+        for (int i = 0; i < old->output_count; ++i, ++total)
+            map[total] = nt < 0 ? -1 : config_find_output(next, nt, old->outputs[i].name, (int)strlen(old->outputs[i].name));
+        for (int i = 0; i < old->prop_count; ++i, ++total)
+            map[total] = nt < 0 ? -1 : config_find_prop(next, nt, old->props[i].name, (int)strlen(old->props[i].name));
+    }
+#define INPUT_SLOT(t, i) map[base[t] + (i)]
+#define OUTPUT_SLOT(t, i) map[base[t] + prev->nodes[t].input_count + (i)]
+#define PROP_SLOT(t, i) map[base[t] + prev->nodes[t].input_count + prev->nodes[t].output_count + (i)]
+
+    /*
+     * nodes move down as they are compacted, so the pass reads old types and
+     * ids from here; the kept nodes' new arrays are allocated before any node
+     * changes
+     */
+    for (size_t i = 0; i < editor->node_count; ++i)
+    {
+        struct node_info *info;
+        old_types[i] = editor->nodes[i].type;
+        ids[i] = types[old_types[i]] < 0 ? -1 : kept++;
+        for (size_t j = 0; j < editor->nodes[i].links.size; ++j)
+            links += get_link(&editor->nodes[i].links, (int)j)->type == LINK_OUTBOUND;
+        if (ids[i] < 0) continue;
+        info = &next->nodes[types[old_types[i]]];
+        new_consts[i] = calloc(info->input_count ? info->input_count : 1, sizeof **new_consts);
+        new_props[i] = calloc(info->prop_count ? info->prop_count : 1, sizeof **new_props);
+        if (!new_consts[i] || !new_props[i]) goto oom;
+    }
+
+    for (size_t id = 0; id < editor->node_count; ++id)
+    {
+        struct node *node = &editor->nodes[id];
+        struct node_info *old = &prev->nodes[node->type], *info;
+        int t = node->type;
+        float *consts;
+        union node_property *props;
+
+        if (ids[id] < 0)
+        {
+            free(node->links.links);
+            free(node->consts);
+            free(node->props);
+            continue;
+        }
+        info = &next->nodes[types[t]];
+
+        consts = new_consts[id];
+        props = new_props[id];
+        for (int i = 0; i < old->input_count; ++i)
+            if (INPUT_SLOT(t, i) >= 0) consts[INPUT_SLOT(t, i)] = node->consts[i];
+        for (int i = 0; i < old->prop_count; ++i)
+        {
+            struct property_info *from = &old->props[i], *to;
+            union node_property v = node->props[i];
+            if (PROP_SLOT(t, i) < 0) continue;
+            to = &info->props[PROP_SLOT(t, i)];
+            if (from->type == FIELD_ENUM && to->type == FIELD_ENUM)
+            {
+                const char *name = v.e >= 0 && v.e < prev->enums[from->enum_type].count ?
+                    prev->enums[from->enum_type].values[v.e] : "";
+                int e = config_find_value(next, to->enum_type, name, (int)strlen(name));
+                v.i = 0;
+                v.e = (short)(e < 0 ? 0 : e);
+            }
+            else if (from->type == FIELD_INT && to->type == FIELD_FLOAT) v.f = (float)v.i;
+            else if (from->type == FIELD_FLOAT && to->type == FIELD_INT) v.i = (int)v.f;
+            else if (from->type != to->type) v.i = 0;
+            props[PROP_SLOT(t, i)] = v;
+        }
+        free(node->consts);
+        free(node->props);
+        node->consts = consts;
+        node->props = props;
+
+        /* links are stored on both ends, each end rewrites its own copy */
+        for (size_t i = 0; i < node->links.size;)
+        {
+            struct node_link *l = get_link(&node->links, (int)i);
+            int other = l->other_id, ot = old_types[other], slot, other_slot;
+            if (l->type == LINK_OUTBOUND)
+            {
+                slot = OUTPUT_SLOT(t, l->slot);
+                other_slot = ids[other] < 0 ? -1 : INPUT_SLOT(ot, l->other_slot);
+            }
+            else
+            {
+                slot = INPUT_SLOT(t, l->slot);
+                other_slot = ids[other] < 0 ? -1 : OUTPUT_SLOT(ot, l->other_slot);
+            }
+            if (slot < 0 || other_slot < 0)
+            {
+                remove_link(&node->links, (int)i);
+                continue;
+            }
+            l->slot = slot;
+            l->other_id = ids[other];
+            l->other_slot = other_slot;
+            ++i;
+        }
+
+        node->type = (node_type)types[t];
+        node->bounds.h = 30.0f * (info->input_count + info->output_count + info->prop_count) + 35;
+        for (size_t i = 0; i < node->links.size; ++i) links -= get_link(&node->links, (int)i)->type == LINK_OUTBOUND;
+        editor->nodes[ids[id]] = *node;
+    }
+#undef INPUT_SLOT
+#undef OUTPUT_SLOT
+#undef PROP_SLOT
+
+    *dropped_nodes = (int)editor->node_count - kept;
+    *dropped_links = links;
+    editor->node_count = kept;
+    editor->selected_id = -1;
+    editor->linking.active = 0;
+    free(types);
+    free(new_consts);
+    free(new_props);
+    return 1;
+
+oom:
+    for (size_t i = 0; new_consts && new_props && i < editor->node_count; ++i)
+    {
+        free(new_consts[i]);
+        free(new_props[i]);
+    }
+    free(types);
+    free(new_consts);
+    free(new_props);
+    return 0;
+}
+
+/* follows `path` for changes; the editor must already use the config loaded from it */
+static void
+node_editor_watch_config(struct node_editor *editor, const char *path)
+{
+    if (!editor->watch) editor->watch = calloc(1, sizeof *editor->watch);
+    else free(editor->watch->path);
+    editor->watch->path = _strdup(path);
+    file_stat(path, &editor->watch->mtime, &editor->watch->size);
+    editor->watch->last_check = SDL_GetTicks();
+}
+
+/* reloads the watched config, with the plugins loaded into the current one, and migrates the open graph onto it */
+static void
+node_editor_reload_config(struct node_editor *editor)
+{
+    struct config next;
+    char *library = editor->library ? _strdup(editor->library->index.dir) : NULL;
+    Uint64 start = SDL_GetPerformanceCounter();
+    int dropped_nodes, dropped_links;
+    char **plugins;
+    int plugin_count = config_plugins(editor->conf, &plugins);
+
+    if (!config_load(&next, editor->watch->path))
+    {
+        editor_printf(editor, "error: config not reloaded: %s", SDL_GetError());
+        free(library);
+        return;
+    }
+    if (plugin_count && !config_load_plugins(&next, plugins, plugin_count))
+    {
+        editor_printf(editor, "error: config not reloaded: %s", SDL_GetError());
+        config_cleanup(&next);
+        free(library);
+        return;
+    }
+
+    if (!node_editor_migrate(editor, &next, &dropped_nodes, &dropped_links))
+    {
+        editor_print(editor, "error: config not reloaded: out of memory");
+        config_cleanup(&next);
+        free(library);
+        return;
+    }
+    /* a library rescan in progress reads the old config */
+    if (editor->library) library_cancel_scan(editor->library);
+    config_cleanup(editor->conf);
+    *editor->conf = next;
+
+    editor_printf(editor, "config '%s' reloaded: %d node types, dropped %d nodes and %d links, %.1f ms",
+        editor->watch->path, editor->conf->node_count, dropped_nodes, dropped_links,
+        (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+
+    /* journal records and the library index hold type indices of the old config */
+    if (editor->journal)
+    {
+        char path[1024];
+        snprintf(path, sizeof path, "%s.aig", editor->journal->base);
+        node_editor_start_save(editor, path, editor->journal->compress);
+    }
+    if (library)
+    {
+        node_editor_open_library(editor, library);
+        free(library);
+    }
+}
+
+static void
+node_editor_check_config(struct node_editor *editor)
+{
+    struct config_watch *watch = editor->watch;
+    uint64_t mtime, size;
+
+    if (SDL_GetTicks() - watch->last_check < CONFIG_WATCH_INTERVAL_MS) return;
+    watch->last_check = SDL_GetTicks();
+    /* a half-written file shows up as a parse error, so wait for saves to settle */
+    if (editor->save || !file_stat(watch->path, &mtime, &size)) return;
+    if (mtime == watch->mtime && size == watch->size) return;
+    watch->mtime = mtime;
+    watch->size = size;
+    node_editor_reload_config(editor);
+}
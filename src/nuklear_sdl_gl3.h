@@ -341,7 +341,8 @@ nk_sdl_handle_event(SDL_Event *evt)
     if (evt->type == SDL_KEYUP || evt->type == SDL_KEYDOWN) {
         /* key events */
         int down = evt->type == SDL_KEYDOWN;
-        const Uint8* state = SDL_GetKeyboardState(0);
+        /* modifiers come from the event, not the live keyboard, so recorded input replays identically */
+        int ctrl = (evt->key.keysym.mod & KMOD_LCTRL) != 0;
         SDL_Keycode sym = evt->key.keysym.sym;
         if (sym == SDLK_RSHIFT || sym == SDLK_LSHIFT)
             nk_input_key(ctx, NK_KEY_SHIFT, down);
@@ -364,29 +365,29 @@ nk_sdl_handle_event(SDL_Event *evt)
         } else if (sym == SDLK_PAGEUP) {
             nk_input_key(ctx, NK_KEY_SCROLL_UP, down);
         } else if (sym == SDLK_z)
-            nk_input_key(ctx, NK_KEY_TEXT_UNDO, down && state[SDL_SCANCODE_LCTRL]);
+            nk_input_key(ctx, NK_KEY_TEXT_UNDO, down && ctrl);
         else if (sym == SDLK_r)
-            nk_input_key(ctx, NK_KEY_TEXT_REDO, down && state[SDL_SCANCODE_LCTRL]);
+            nk_input_key(ctx, NK_KEY_TEXT_REDO, down && ctrl);
         else if (sym == SDLK_c)
-            nk_input_key(ctx, NK_KEY_COPY, down && state[SDL_SCANCODE_LCTRL]);
+            nk_input_key(ctx, NK_KEY_COPY, down && ctrl);
         else if (sym == SDLK_v)
-            nk_input_key(ctx, NK_KEY_PASTE, down && state[SDL_SCANCODE_LCTRL]);
+            nk_input_key(ctx, NK_KEY_PASTE, down && ctrl);
         else if (sym == SDLK_x)
-            nk_input_key(ctx, NK_KEY_CUT, down && state[SDL_SCANCODE_LCTRL]);
+            nk_input_key(ctx, NK_KEY_CUT, down && ctrl);
         else if (sym == SDLK_b)
-            nk_input_key(ctx, NK_KEY_TEXT_LINE_START, down && state[SDL_SCANCODE_LCTRL]);
+            nk_input_key(ctx, NK_KEY_TEXT_LINE_START, down && ctrl);
         else if (sym == SDLK_e)
-            nk_input_key(ctx, NK_KEY_TEXT_LINE_END, down && state[SDL_SCANCODE_LCTRL]);
+            nk_input_key(ctx, NK_KEY_TEXT_LINE_END, down && ctrl);
         else if (sym == SDLK_UP)
             nk_input_key(ctx, NK_KEY_UP, down);
         else if (sym == SDLK_DOWN)
             nk_input_key(ctx, NK_KEY_DOWN, down);
         else if (sym == SDLK_LEFT) {
-            if (state[SDL_SCANCODE_LCTRL])
+            if (ctrl)
                 nk_input_key(ctx, NK_KEY_TEXT_WORD_LEFT, down);
             else nk_input_key(ctx, NK_KEY_LEFT, down);
         } else if (sym == SDLK_RIGHT) {
-            if (state[SDL_SCANCODE_LCTRL])
+            if (ctrl)
                 nk_input_key(ctx, NK_KEY_TEXT_WORD_RIGHT, down);
             else nk_input_key(ctx, NK_KEY_RIGHT, down);
         } else return 0;
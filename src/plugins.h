@@ -0,0 +1,232 @@
+#ifndef PLUGINS_H
+#define PLUGINS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_loadso.h>
+#include <SDL2/SDL_error.h>
+#include "aigraph.h"
+#include "kernels.h"
+#include "symbols.h"
+
+/*
+ * Loads plugin libraries into a config. The plugins' node types and enums
+ * are appended after the config's own, so type indices of a graph built
+ * against the config stay valid, and the libraries stay loaded until the
+ * config is cleaned up. The layer wraps whatever owned the config before
+ * and restores it on release.
+ */
+
+struct plugin_layer
+{
+    struct config prev;     /* the config before the plugins, released after them */
+    struct node_info *nodes;
+    struct enum_info *enums;
+    void **objects;
+    char **paths;
+    int count;
+};
+
+/* registry state while plugins register */
+struct plugin_host
+{
+    struct plugin_layer *layer;
+    struct config *conf;
+    const char *path;
+    int node_capacity, enum_capacity;
+};
+
+static void
+plugin_layer_release(struct config *conf)
+{
+    struct plugin_layer *layer = conf->storage;
+    *conf = layer->prev;
+    config_cleanup(conf);
+    for (int i = 0; i < layer->count; ++i)
+    {
+        if (layer->objects[i]) SDL_UnloadObject(layer->objects[i]);
+        free(layer->paths[i]);
+    }
+    free(layer->nodes);
+    free(layer->enums);
+    free(layer->objects);
+    free(layer->paths);
+    free(layer);
+}
+
+static int
+plugin_add_enum(struct plugin_registry *reg, const struct enum_info *info)
+{
+    struct plugin_host *host = reg->host;
+    struct config *conf = host->conf;
+    int named = info->values != NULL;
+
+    for (int i = 0; named && i < info->count; ++i) named = info->values[i] != NULL;
+    if (!info->name || info->count <= 0 || !named)
+    {
+        SDL_SetError("plugin '%s': enum without a name or values", host->path);
+        return -1;
+    }
+    if (conf->enum_count == host->enum_capacity)
+    {
+        int capacity = host->enum_capacity * 2;
+        struct enum_info *enums = realloc(host->layer->enums, capacity * sizeof *enums);
+        if (!enums) { SDL_SetError("out of memory"); return -1; }
+        host->layer->enums = conf->enums = enums;
+        host->enum_capacity = capacity;
+    }
+    conf->enums[conf->enum_count] = *info;
+    return conf->enum_count++;
+}
+
+static int
+plugin_add_node(struct plugin_registry *reg, const struct node_info *info)
+{
+    struct plugin_host *host = reg->host;
+    struct config *conf = host->conf;
+
+    if (!info->name || !info->category || info->op != OP_KERNEL || !info->kernels ||
+        !kernels_scalar(info->kernels, info->input_count) || !kernels_batch(info->kernels, info->input_count))
+    {
+        SDL_SetError("plugin '%s': node type '%s' needs a name, a category and kernels",
+            host->path, info->name ? info->name : "?");
+        return -1;
+    }
+    for (int i = 0; i < info->input_count; ++i) if (!info->inputs[i].name) goto unnamed;
+    for (int i = 0; i < info->output_count; ++i) if (!info->outputs[i].name) goto unnamed;
+    for (int i = 0; i < info->prop_count; ++i)
+    {
+        if (!info->props[i].name) goto unnamed;
+        if (info->props[i].type == FIELD_ENUM &&
+            (info->props[i].enum_type < 0 || info->props[i].enum_type >= conf->enum_count))
+        {
+            SDL_SetError("plugin '%s': node type '%s' uses an unknown enum", host->path, info->name);
+            return -1;
+        }
+    }
+    if (conf->node_count == host->node_capacity)
+    {
+        int capacity = host->node_capacity * 2;
+        struct node_info *nodes = realloc(host->layer->nodes, capacity * sizeof *nodes);
+        if (!nodes) { SDL_SetError("out of memory"); return -1; }
+        host->layer->nodes = conf->nodes = nodes;
+        host->node_capacity = capacity;
+    }
+    conf->nodes[conf->node_count] = *info;
+    return conf->node_count++;
+
+unnamed:
+    SDL_SetError("plugin '%s': node type '%s' has a port or property without a name", host->path, info->name);
+    return -1;
+}
+
+/*
+ * Loads the plugin libraries at `paths` into `conf`, calling each one's
+ * AIGRAPH_PLUGIN_ENTRY. Either all of them load or `conf` is left as it
+ * was; returns 0 and sets the SDL error on failure, e.g. when a plugin
+ * registers a name the config already has.
+ */
+static int
+config_load_plugins(struct config *conf, char **paths, int count)
+{
+    struct plugin_layer *layer = calloc(1, sizeof *layer);
+    struct plugin_host host = {0};
+    struct plugin_registry reg;
+    struct config next;
+    char error[512];
+
+    if (!layer) { SDL_SetError("out of memory"); return 0; }
+    layer->prev = *conf;
+    host.layer = layer;
+    host.conf = &next;
+    host.node_capacity = conf->node_count + 16;
+    host.enum_capacity = conf->enum_count + 16;
+    layer->nodes = malloc(host.node_capacity * sizeof *layer->nodes);
+    layer->enums = malloc(host.enum_capacity * sizeof *layer->enums);
+    layer->objects = calloc(count + 1, sizeof *layer->objects);
+    layer->paths = calloc(count + 1, sizeof *layer->paths);
+    if (!layer->nodes || !layer->enums || !layer->objects || !layer->paths)
+    {
+        SDL_SetError("out of memory");
+        goto fail;
+    }
+    memcpy(layer->nodes, conf->nodes, conf->node_count * sizeof *layer->nodes);
+    memcpy(layer->enums, conf->enums, conf->enum_count * sizeof *layer->enums);
+
+    next = *conf;
+    next.nodes = layer->nodes;
+    next.enums = layer->enums;
+    next.symbols = NULL;
+    next.storage = layer;
+    next.release = plugin_layer_release;
+
+    reg.version = AIGRAPH_PLUGIN_VERSION;
+    reg.host = &host;
+    reg.add_enum = plugin_add_enum;
+    reg.add_node = plugin_add_node;
+
+    for (int i = 0; i < count; ++i)
+    {
+        plugin_register_func entry;
+
+        host.path = paths[i];
+        layer->paths[i] = _strdup(paths[i]);
+        layer->objects[i] = SDL_LoadObject(paths[i]);
+        layer->count = i + 1;
+        if (!layer->paths[i] || !layer->objects[i])
+        {
+            snprintf(error, sizeof error, "%s", layer->paths[i] ? SDL_GetError() : "out of memory");
+            SDL_SetError("couldn't load plugin '%s': %s", paths[i], error);
+            goto fail;
+        }
+        entry = (plugin_register_func)SDL_LoadFunction(layer->objects[i], AIGRAPH_PLUGIN_ENTRY);
+        if (!entry)
+        {
+            SDL_SetError("'%s' is not an aigraph plugin", paths[i]);
+            goto fail;
+        }
+        /* add_node and add_enum set the error of a refused type, a plugin may go on without it */
+        SDL_ClearError();
+        if (!entry(&reg))
+        {
+            snprintf(error, sizeof error, "%s", SDL_GetError());
+            SDL_SetError("plugin '%s' failed to register%s%s", paths[i], error[0] ? ": " : "", error);
+            goto fail;
+        }
+    }
+
+    /* names that can't be told apart are load errors, as for config files */
+    if (!config_symbols_build(&next)) goto fail;
+    free(conf->symbols);
+    *conf = next;
+    layer->prev.symbols = NULL;
+    return 1;
+
+fail:
+    /* unloading may set errors of its own, keep the one that matters */
+    snprintf(error, sizeof error, "%s", SDL_GetError());
+    for (int i = 0; i < layer->count; ++i)
+    {
+        if (layer->objects[i]) SDL_UnloadObject(layer->objects[i]);
+        free(layer->paths[i]);
+    }
+    free(layer->nodes);
+    free(layer->enums);
+    free(layer->objects);
+    free(layer->paths);
+    free(layer);
+    SDL_SetError("%s", error);
+    return 0;
+}
+
+/* paths of the plugin libraries loaded into `conf`; returns how many there are */
+static int
+config_plugins(struct config *conf, char ***paths)
+{
+    struct plugin_layer *layer = conf->release == plugin_layer_release ? conf->storage : NULL;
+    *paths = layer ? layer->paths : NULL;
+    return layer ? layer->count : 0;
+}
+
+#endif
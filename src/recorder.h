@@ -0,0 +1,221 @@
+
+#include <SDL2/SDL.h>
+
+/*
+ * Input recorder: captures the SDL events fed to nuklear, frame by frame,
+ * together with each frame's delta time and window size. Replaying the file
+ * feeds the very same input back, so an editing session becomes a
+ * repeatable benchmark.
+ *
+ * File layout (little-endian):
+ *   magic "aigrec\0", u8 version
+ *   per frame: f32 delta_time, u16 width, u16 height, u16 event_count
+ *   per event: u32 type, u8 payload size, payload (SDL event struct bytes)
+ */
+
+#define RECORDER_MAGIC "aigrec"
+#define RECORDER_VERSION 1
+
+typedef enum { RECORDER_OFF, RECORDER_RECORD, RECORDER_REPLAY } recorder_mode;
+typedef enum { TIMING_FRAME, TIMING_GUI, TIMING_RENDER, TIMING_COUNT } timing_phase;
+
+static char *timing_names[TIMING_COUNT] = { "frame", "gui", "render" };
+
+struct frame_timings {
+    float *samples[TIMING_COUNT];
+    int count, capacity;
+    Uint64 started[TIMING_COUNT];
+    float current[TIMING_COUNT];
+};
+
+struct recorder {
+    recorder_mode mode;
+    SDL_RWops *file;
+    SDL_Event *events;
+    int event_count, event_capacity;
+    float delta_time;
+    int width, height;
+    int frame;
+    struct frame_timings timings;
+};
+
+static int
+recorder_event_size(Uint32 type)
+{
+    switch (type)
+    {
+        case SDL_KEYDOWN: case SDL_KEYUP: return sizeof(SDL_KeyboardEvent);
+        case SDL_TEXTINPUT: return sizeof(SDL_TextInputEvent);
+        case SDL_MOUSEMOTION: return sizeof(SDL_MouseMotionEvent);
+        case SDL_MOUSEBUTTONDOWN: case SDL_MOUSEBUTTONUP: return sizeof(SDL_MouseButtonEvent);
+        case SDL_MOUSEWHEEL: return sizeof(SDL_MouseWheelEvent);
+        default: return 0;
+    }
+}
+
+static void
+recorder_init(struct recorder *rec)
+{
+    memset(rec, 0, sizeof *rec);
+}
+
+static int
+recorder_start(struct recorder *rec, recorder_mode mode, char *path)
+{
+    char magic[8];
+
+    rec->file = SDL_RWFromFile(path, mode == RECORDER_RECORD ? "wb" : "rb");
+    if (!rec->file) return 0;
+
+    if (mode == RECORDER_RECORD)
+    {
+        SDL_RWwrite(rec->file, RECORDER_MAGIC, 1, sizeof(RECORDER_MAGIC));
+        SDL_WriteU8(rec->file, RECORDER_VERSION);
+    }
+    else if (SDL_RWread(rec->file, magic, 1, sizeof(RECORDER_MAGIC)) != sizeof(RECORDER_MAGIC) ||
+        memcmp(magic, RECORDER_MAGIC, sizeof(RECORDER_MAGIC)) ||
+        SDL_ReadU8(rec->file) != RECORDER_VERSION)
+    {
+        SDL_SetError("'%s' is not an input recording", path);
+        SDL_RWclose(rec->file);
+        rec->file = NULL;
+        return 0;
+    }
+
+    rec->mode = mode;
+    return 1;
+}
+
+static void
+recorder_push(struct recorder *rec, SDL_Event *evt)
+{
+    if (rec->event_count == rec->event_capacity)
+    {
+        int new_capacity = rec->event_capacity ? 2 * rec->event_capacity : 16;
+        rec->events = realloc(rec->events, new_capacity * sizeof *rec->events);
+        rec->event_capacity = new_capacity;
+    }
+    rec->events[rec->event_count++] = *evt;
+}
+
+/* record mode: write out the events pushed during this frame */
+static void
+recorder_write_frame(struct recorder *rec, float delta_time, int width, int height)
+{
+    int count = 0;
+    for (int i = 0; i < rec->event_count; ++i)
+        if (recorder_event_size(rec->events[i].type)) ++count;
+
+    SDL_WriteLE32(rec->file, *((Uint32*)&delta_time));
+    SDL_WriteLE16(rec->file, (Uint16)width);
+    SDL_WriteLE16(rec->file, (Uint16)height);
+    SDL_WriteLE16(rec->file, (Uint16)count);
+    for (int i = 0; i < rec->event_count; ++i)
+    {
+        SDL_Event *evt = &rec->events[i];
+        int size = recorder_event_size(evt->type);
+        if (!size) continue;
+        SDL_WriteLE32(rec->file, evt->type);
+        SDL_WriteU8(rec->file, (Uint8)size);
+        SDL_RWwrite(rec->file, evt, size, 1);
+    }
+
+    rec->event_count = 0;
+    ++rec->frame;
+}
+
+/* replay mode: load the next frame into `events`, returns 0 at the end of the recording */
+static int
+recorder_read_frame(struct recorder *rec)
+{
+    Uint32 dt;
+    int count;
+
+    rec->event_count = 0;
+    if (SDL_RWread(rec->file, &dt, sizeof dt, 1) != 1) return 0;
+    dt = SDL_SwapLE32(dt);
+    rec->delta_time = *((float*)&dt);
+    rec->width = SDL_ReadLE16(rec->file);
+    rec->height = SDL_ReadLE16(rec->file);
+    count = SDL_ReadLE16(rec->file);
+
+    for (int i = 0; i < count; ++i)
+    {
+        SDL_Event evt;
+        Uint32 type = SDL_ReadLE32(rec->file);
+        int size = SDL_ReadU8(rec->file);
+        if (size != recorder_event_size(type)) return 0;
+        memset(&evt, 0, sizeof evt);
+        if (SDL_RWread(rec->file, &evt, size, 1) != 1) return 0;
+        recorder_push(rec, &evt);
+    }
+
+    ++rec->frame;
+    return 1;
+}
+
+static void
+recorder_time_begin(struct recorder *rec, timing_phase phase)
+{
+    rec->timings.started[phase] = SDL_GetPerformanceCounter();
+}
+
+static void
+recorder_time_end(struct recorder *rec, timing_phase phase)
+{
+    Uint64 elapsed = SDL_GetPerformanceCounter() - rec->timings.started[phase];
+    rec->timings.current[phase] = (float)(elapsed * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+/* replay mode: store the timings measured during the current frame */
+static void
+recorder_commit_timings(struct recorder *rec)
+{
+    struct frame_timings *t = &rec->timings;
+    if (rec->mode != RECORDER_REPLAY) return;
+    if (t->count == t->capacity)
+    {
+        int new_capacity = t->capacity ? 2 * t->capacity : 256;
+        for (int i = 0; i < TIMING_COUNT; ++i)
+            t->samples[i] = realloc(t->samples[i], new_capacity * sizeof *t->samples[i]);
+        t->capacity = new_capacity;
+    }
+    for (int i = 0; i < TIMING_COUNT; ++i)
+        t->samples[i][t->count] = t->current[i];
+    ++t->count;
+}
+
+static int
+compare_floats(const void *a, const void *b)
+{
+    float fa = *(const float*)a, fb = *(const float*)b;
+    return (fa > fb) - (fa < fb);
+}
+
+/* print min/avg/p50/p99/max of every phase in milliseconds */
+static void
+recorder_report(struct recorder *rec, FILE *out)
+{
+    struct frame_timings *t = &rec->timings;
+    if (!t->count) return;
+    fprintf(out, "replayed %d frames\n", t->count);
+    for (int i = 0; i < TIMING_COUNT; ++i)
+    {
+        float *s = t->samples[i];
+        double sum = 0;
+        qsort(s, t->count, sizeof *s, compare_floats);
+        for (int j = 0; j < t->count; ++j) sum += s[j];
+        fprintf(out, "%-8s min %.3f avg %.3f p50 %.3f p99 %.3f max %.3f ms\n", timing_names[i],
+            s[0], sum / t->count, s[t->count / 2], s[(int)(t->count * 0.99f)], s[t->count - 1]);
+    }
+}
+
+static void
+recorder_cleanup(struct recorder *rec)
+{
+    if (rec->file) SDL_RWclose(rec->file);
+    for (int i = 0; i < TIMING_COUNT; ++i)
+        free(rec->timings.samples[i]);
+    free(rec->events);
+    memset(rec, 0, sizeof *rec);
+}
@@ -0,0 +1,131 @@
+#ifndef SAVE_JOB_H
+#define SAVE_JOB_H
+
+#include <stdio.h>
+#include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_atomic.h>
+#include "graph_file.h"
+
+#ifdef _WIN32
+#include <io.h>
+#endif
+
+/*
+ * Writes `size` bytes to `path` durably: the data goes to a temporary file
+ * that is flushed to disk and then renamed over the target, so a crash
+ * leaves either the old or the new file. Returns 0 and fills `error` on
+ * failure.
+ */
+static int
+file_write_durable(const char *path, const void *data, size_t size, char *error, int error_size)
+{
+    char tmp[1024];
+    FILE *f;
+    int ok;
+
+    snprintf(tmp, sizeof tmp, "%s.tmp", path);
+    f = fopen(tmp, "wb");
+    if (!f)
+    {
+        snprintf(error, error_size, "couldn't open '%s' for writing", tmp);
+        return 0;
+    }
+
+    ok = (!size || fwrite(data, size, 1, f) == 1) && fflush(f) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = (fclose(f) == 0) && ok;
+
+#ifdef _WIN32
+    ok = ok && MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    ok = ok && rename(tmp, path) == 0;
+#endif
+
+    if (!ok)
+    {
+        remove(tmp);
+        snprintf(error, error_size, "error while writing '%s'", path);
+    }
+    return ok;
+}
+
+/*
+ * A save running on a worker thread. The job owns a flat snapshot of the
+ * graph taken on the UI thread, so the editor can keep changing while the
+ * snapshot is compressed and written.
+ */
+struct save_job
+{
+    SDL_Thread *thread;
+    SDL_atomic_t done;
+    struct graph_view view;
+    char *path;
+    int compress;
+    int ok;
+    size_t written;
+    char message[256];
+};
+
+static int SDLCALL
+save_job_run(void *data)
+{
+    struct save_job *job = data;
+    void *bytes = job->view.storage;
+    size_t size = job->view.storage_size;
+
+    if (job->compress && !(bytes = graph_file_pack(job->view.storage, job->view.storage_size, &size)))
+        snprintf(job->message, sizeof job->message, "%s", SDL_GetError());
+    else if (file_write_durable(job->path, bytes, size, job->message, sizeof job->message))
+    {
+        job->ok = 1;
+        job->written = size;
+    }
+
+    if (bytes != job->view.storage) free(bytes);
+    SDL_AtomicSet(&job->done, 1);
+    return 0;
+}
+
+/* takes ownership of `snapshot`; returns NULL and sets the SDL error on failure */
+static struct save_job*
+save_job_start(struct graph_view *snapshot, const char *path, int compress)
+{
+    struct save_job *job = calloc(1, sizeof *job);
+    if (!job) { SDL_SetError("out of memory"); return NULL; }
+
+    job->view = *snapshot;
+    memset(snapshot, 0, sizeof *snapshot);
+    job->path = _strdup(path);
+    job->compress = compress;
+    job->thread = SDL_CreateThread(save_job_run, "save", job);
+    if (!job->thread)
+    {
+        *snapshot = job->view;
+        free(job->path);
+        free(job);
+        return NULL;
+    }
+    return job;
+}
+
+static int
+save_job_done(struct save_job *job)
+{
+    return SDL_AtomicGet(&job->done);
+}
+
+/* waits for the worker and releases the job */
+static void
+save_job_finish(struct save_job *job)
+{
+    SDL_WaitThread(job->thread, NULL);
+    graph_view_free(&job->view);
+    free(job->path);
+    free(job);
+}
+
+#endif
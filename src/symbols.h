@@ -0,0 +1,332 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <SDL2/SDL_error.h>
+#include "aigraph.h"
+
+/*
+ * By-name lookups into a config: node types, enums, the inputs, outputs
+ * and properties of each node type and the values of each enum. Every
+ * scope gets a minimal perfect hash (hash and displace): a name's bucket
+ * holds either a displacement that rehashes its keys into free slots or,
+ * for single-key buckets, the slot itself. A lookup is one string hash,
+ * two table reads and a fingerprint compare; the name is only compared
+ * byte by byte to confirm a fingerprint hit.
+ *
+ * All scopes share three flat arrays in one allocation owned by the
+ * config (conf->symbols), built on first use or by config_symbols_build.
+ */
+
+/* keys of one scope at [first, first + size) of the shared arrays */
+struct name_map
+{
+    uint32_t first, size;
+};
+
+struct config_symbols
+{
+    struct name_map types, enums;
+    struct name_map *inputs, *outputs, *props;  /* per node type */
+    struct name_map *values;                    /* per enum */
+    int32_t *displace;  /* per bucket: < 0 is -(slot + 1), otherwise a hash seed */
+    uint32_t *slots;    /* per slot: index of the key in its scope */
+    uint64_t *hashes;   /* per slot: hash of that key */
+};
+
+#define SYMBOL_MAX_SEED (1 << 20)
+
+static uint64_t
+symbol_hash(const char *s, int len)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (int i = 0; i < len; ++i) h = (h ^ (unsigned char)s[i]) * 0x100000001b3ull;
+    /* fnv1a is weak in the high bits, finish like splitmix64 */
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+static uint32_t
+symbol_bucket(uint64_t h, uint32_t size)
+{
+    return (uint32_t)(((h >> 32) * size) >> 32);
+}
+
+static uint32_t
+symbol_slot(uint64_t h, int32_t seed, uint32_t size)
+{
+    h ^= (uint64_t)seed * 0x9e3779b97f4a7c15ull;
+    h = (h ^ (h >> 29)) * 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 32;
+    return (uint32_t)(((h & 0xffffffffu) * size) >> 32);
+}
+
+/* records of every config table start with their `char *name` */
+static const char*
+symbol_name(const void *records, size_t stride, uint32_t i)
+{
+    return *(char* const*)((const char*)records + i * stride);
+}
+
+/* scratch space for building the largest scope */
+struct symbol_scratch
+{
+    uint64_t *hashes;   /* per key */
+    uint32_t *order;    /* keys grouped by bucket */
+    uint32_t *start;    /* first key of each bucket in `order`, plus an end */
+};
+
+/*
+ * Places the `map->size` keys of one scope. Returns 0 and sets the SDL
+ * error when two keys share a name.
+ */
+static int
+name_map_build(struct config_symbols *sym, struct name_map *map, const void *records, size_t stride,
+    struct symbol_scratch *scratch, const char *scope)
+{
+    uint32_t n = map->size, next_free = 0, largest = 0;
+    uint32_t *slots = sym->slots + map->first, *order = scratch->order, *start = scratch->start;
+    int32_t *displace = sym->displace + map->first;
+    uint64_t *hashes = scratch->hashes;
+
+    if (!n) return 1;
+    memset(start, 0, (n + 1) * sizeof *start);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        const char *name = symbol_name(records, stride, i);
+        hashes[i] = symbol_hash(name, (int)strlen(name));
+        slots[i] = UINT32_MAX;
+        displace[i] = 0;
+        ++start[symbol_bucket(hashes[i], n) + 1];
+    }
+
+    /* keys grouped by bucket with a counting sort */
+    for (uint32_t b = 0; b < n; ++b)
+    {
+        if (start[b + 1] > largest) largest = start[b + 1];
+        start[b + 1] += start[b];
+    }
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        uint32_t b = symbol_bucket(hashes[i], n);
+        order[start[b] + (uint32_t)displace[b]++] = i;
+    }
+    memset(displace, 0, n * sizeof *displace);
+
+    /* larger buckets are harder to place, so they go first */
+    for (uint32_t size = largest; size >= 2; --size)
+    {
+        for (uint32_t b = 0; b < n; ++b)
+        {
+            uint32_t *keys = order + start[b];
+            int32_t seed;
+            if (start[b + 1] - start[b] != size) continue;
+
+            for (uint32_t i = 1; i < size; ++i)
+            {
+                for (uint32_t j = 0; j < i; ++j)
+                {
+                    const char *name = symbol_name(records, stride, keys[i]);
+                    if (hashes[keys[i]] == hashes[keys[j]] && !strcmp(name, symbol_name(records, stride, keys[j])))
+                    {
+                        SDL_SetError("'%s' is defined twice in %s", name, scope);
+                        return 0;
+                    }
+                }
+            }
+
+            for (seed = 1; seed < SYMBOL_MAX_SEED; ++seed)
+            {
+                uint32_t i;
+                for (i = 0; i < size; ++i)
+                {
+                    uint32_t s = symbol_slot(hashes[keys[i]], seed, n);
+                    if (slots[s] != UINT32_MAX) break;
+                    slots[s] = keys[i];
+                }
+                if (i == size) break;
+                while (i--) slots[symbol_slot(hashes[keys[i]], seed, n)] = UINT32_MAX;
+            }
+            if (seed == SYMBOL_MAX_SEED)
+            {
+                SDL_SetError("couldn't build the name table of %s", scope);
+                return 0;
+            }
+            displace[b] = seed;
+        }
+    }
+
+    /* single keys take whatever slots are left */
+    for (uint32_t b = 0; b < n; ++b)
+    {
+        if (start[b + 1] - start[b] != 1) continue;
+        while (slots[next_free] != UINT32_MAX) ++next_free;
+        slots[next_free] = order[start[b]];
+        displace[b] = -(int32_t)next_free - 1;
+    }
+
+    for (uint32_t s = 0; s < n; ++s) sym->hashes[map->first + s] = hashes[slots[s]];
+    return 1;
+}
+
+/* index of `s` in the scope of `map`, or -1 */
+static int
+name_map_find(const struct config_symbols *sym, const struct name_map *map, const void *records, size_t stride,
+    const char *s, int len)
+{
+    uint64_t h;
+    int32_t d;
+    uint32_t slot;
+    const char *name;
+
+    if (!map->size) return -1;
+    h = symbol_hash(s, len);
+    d = sym->displace[map->first + symbol_bucket(h, map->size)];
+    slot = d < 0 ? (uint32_t)(-d - 1) : symbol_slot(h, d, map->size);
+    if (sym->hashes[map->first + slot] != h) return -1;
+    slot = sym->slots[map->first + slot];
+    name = symbol_name(records, stride, slot);
+    return !strncmp(name, s, len) && name[len] == '\0' ? (int)slot : -1;
+}
+
+/* builds conf->symbols; returns 0 and sets the SDL error if a scope has a name twice */
+static int
+config_symbols_build(struct config *conf)
+{
+    struct config_symbols *sym;
+    struct symbol_scratch scratch;
+    uint32_t total = conf->node_count + conf->enum_count, largest = conf->node_count;
+    size_t maps = 3 * (size_t)conf->node_count + conf->enum_count;
+    char scope[256];
+    int ok = 1;
+
+    if (conf->symbols) return 1;
+    if ((uint32_t)conf->enum_count > largest) largest = conf->enum_count;
+    for (int i = 0; i < conf->node_count; ++i)
+    {
+        struct node_info *n = &conf->nodes[i];
+        total += n->input_count + n->output_count + n->prop_count;
+        if ((uint32_t)n->input_count > largest) largest = n->input_count;
+        if ((uint32_t)n->output_count > largest) largest = n->output_count;
+        if ((uint32_t)n->prop_count > largest) largest = n->prop_count;
+    }
+    for (int i = 0; i < conf->enum_count; ++i)
+    {
+        total += conf->enums[i].count;
+        if ((uint32_t)conf->enums[i].count > largest) largest = conf->enums[i].count;
+    }
+
+    /* hashes first for alignment */
+    sym = malloc(sizeof *sym + total * (sizeof *sym->hashes + sizeof *sym->displace + sizeof *sym->slots) +
+        maps * sizeof(struct name_map));
+    scratch.hashes = malloc((size_t)largest * (sizeof *scratch.hashes + 2 * sizeof *scratch.order) + sizeof *scratch.order);
+    if (!sym || !scratch.hashes)
+    {
+        free(sym);
+        free(scratch.hashes);
+        SDL_SetError("out of memory");
+        return 0;
+    }
+    scratch.order = (uint32_t*)(scratch.hashes + largest);
+    scratch.start = scratch.order + largest;
+    sym->hashes = (uint64_t*)(sym + 1);
+    sym->displace = (int32_t*)(sym->hashes + total);
+    sym->slots = (uint32_t*)(sym->displace + total);
+    sym->inputs = (struct name_map*)(sym->slots + total);
+    sym->outputs = sym->inputs + conf->node_count;
+    sym->props = sym->outputs + conf->node_count;
+    sym->values = sym->props + conf->node_count;
+
+    total = 0;
+#define SCOPE(map, count) (map).first = total, (map).size = (count), total += (count)
+    SCOPE(sym->types, conf->node_count);
+    SCOPE(sym->enums, conf->enum_count);
+    for (int i = 0; i < conf->node_count; ++i)
+    {
+        SCOPE(sym->inputs[i], conf->nodes[i].input_count);
+        SCOPE(sym->outputs[i], conf->nodes[i].output_count);
+        SCOPE(sym->props[i], conf->nodes[i].prop_count);
+    }
+    for (int i = 0; i < conf->enum_count; ++i) SCOPE(sym->values[i], conf->enums[i].count);
+#undef SCOPE
+
+    ok = name_map_build(sym, &sym->types, conf->nodes, sizeof *conf->nodes, &scratch, "the node types") &&
+        name_map_build(sym, &sym->enums, conf->enums, sizeof *conf->enums, &scratch, "the enums");
+    for (int i = 0; ok && i < conf->node_count; ++i)
+    {
+        struct node_info *n = &conf->nodes[i];
+        snprintf(scope, sizeof scope, "the inputs of '%s'", n->name);
+        ok = name_map_build(sym, &sym->inputs[i], n->inputs, sizeof *n->inputs, &scratch, scope);
+        snprintf(scope, sizeof scope, "the outputs of '%s'", n->name);
+        ok = ok && name_map_build(sym, &sym->outputs[i], n->outputs, sizeof *n->outputs, &scratch, scope);
+        snprintf(scope, sizeof scope, "the properties of '%s'", n->name);
+        ok = ok && name_map_build(sym, &sym->props[i], n->props, sizeof *n->props, &scratch, scope);
+    }
+    for (int i = 0; ok && i < conf->enum_count; ++i)
+    {
+        snprintf(scope, sizeof scope, "the values of enum '%s'", conf->enums[i].name ? conf->enums[i].name : "?");
+        ok = name_map_build(sym, &sym->values[i], conf->enums[i].values, sizeof *conf->enums[i].values, &scratch, scope);
+    }
+    free(scratch.hashes);
+    if (!ok)
+    {
+        free(sym);
+        return 0;
+    }
+    conf->symbols = sym;
+    return 1;
+}
+
+/* lookups return the index in the config, or -1 for unknown names */
+
+static int
+config_find_type(struct config *conf, const char *s, int len)
+{
+    if (!config_symbols_build(conf)) return -1;
+    return name_map_find(conf->symbols, &conf->symbols->types, conf->nodes, sizeof *conf->nodes, s, len);
+}
+
+static int
+config_find_enum(struct config *conf, const char *s, int len)
+{
+    if (!config_symbols_build(conf)) return -1;
+    return name_map_find(conf->symbols, &conf->symbols->enums, conf->enums, sizeof *conf->enums, s, len);
+}
+
+static int
+config_find_input(struct config *conf, int type, const char *s, int len)
+{
+    struct node_info *n = &conf->nodes[type];
+    if (!config_symbols_build(conf)) return -1;
+    return name_map_find(conf->symbols, &conf->symbols->inputs[type], n->inputs, sizeof *n->inputs, s, len);
+}
+
+static int
+config_find_output(struct config *conf, int type, const char *s, int len)
+{
+    struct node_info *n = &conf->nodes[type];
+    if (!config_symbols_build(conf)) return -1;
+    return name_map_find(conf->symbols, &conf->symbols->outputs[type], n->outputs, sizeof *n->outputs, s, len);
+}
+
+static int
+config_find_prop(struct config *conf, int type, const char *s, int len)
+{
+    struct node_info *n = &conf->nodes[type];
+    if (!config_symbols_build(conf)) return -1;
+    return name_map_find(conf->symbols, &conf->symbols->props[type], n->props, sizeof *n->props, s, len);
+}
+
+static int
+config_find_value(struct config *conf, int enum_type, const char *s, int len)
+{
+    struct enum_info *e = &conf->enums[enum_type];
+    if (!config_symbols_build(conf)) return -1;
+    return name_map_find(conf->symbols, &conf->symbols->values[enum_type], e->values, sizeof *e->values, s, len);
+}
+
+#endif
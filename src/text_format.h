@@ -0,0 +1,751 @@
+#ifndef TEXT_FORMAT_H
+#define TEXT_FORMAT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <SDL2/SDL_error.h>
+#include "aigraph.h"
+#include "graph_file.h"
+#include "save_job.h"
+#include "symbols.h"
+
+/*
+ * Text form of a graph (.aigt), a JSON subset meant to live in version
+ * control: one record per line and names instead of indices wherever the
+ * config has them, so diffs and merges stay readable.
+ *
+ *   {
+ *   "format": "aigraph", "version": 1,
+ *   "scroll": [0, 0],
+ *   "nodes": [
+ *   {"type": "sum", "pos": [120, 80]},
+ *   ...
+ *   ],
+ *   "links": [
+ *   [0, 0, 1, 1],            source node, output slot, target node, input slot
+ *   ],
+ *   "consts": [
+ *   [1, 0, 2.5],             node, input slot, value
+ *   ],
+ *   "props": [
+ *   [2, 0, "wave_hand"]      node, property slot, value
+ *   ]
+ *   }
+ *
+ * Nodes are numbered in file order. Enum properties are written by value
+ * name, so "props" has to come after "nodes". Unknown keys are skipped.
+ *
+ * The parser is a single pass over the mapped file that writes records
+ * straight into growing arrays, no tree is built and no strings are copied.
+ */
+
+#define TEXT_FORMAT_VERSION 1
+#define TEXT_MAX_DEPTH 64
+
+struct text_buffer
+{
+    char *data;
+    size_t size, capacity;
+};
+
+static int
+text_reserve(struct text_buffer *b, size_t extra)
+{
+    char *data;
+    size_t capacity;
+
+    if (b->size + extra <= b->capacity) return 1;
+    capacity = b->capacity ? b->capacity : 4096;
+    while (capacity < b->size + extra) capacity *= 2;
+    data = realloc(b->data, capacity);
+    if (!data) return 0;
+    b->data = data;
+    b->capacity = capacity;
+    return 1;
+}
+
+/* callers reserve space first, these never grow the buffer */
+static inline void
+text_put(struct text_buffer *b, const char *s, size_t len)
+{
+    memcpy(b->data + b->size, s, len);
+    b->size += len;
+}
+
+#define TEXT_PUT_LITERAL(b, s) text_put(b, s, sizeof(s) - 1)
+
+static inline void
+text_put_int(struct text_buffer *b, int32_t value)
+{
+    char digits[12];
+    int n = 0;
+    uint32_t v = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+
+    do { digits[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+    if (value < 0) b->data[b->size++] = '-';
+    while (n) b->data[b->size++] = digits[--n];
+}
+
+static const double text_powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+/*
+ * m * 10^exp to float. Mantissas under 2^53 with small exponents are exact
+ * in double, so one multiply or divide gives the correctly rounded double
+ * (Clinger's fast path) and rounding that to float is exact unless the
+ * double lands on a midpoint between two floats. Returns 0 where the fast
+ * path doesn't apply.
+ */
+static inline int
+text_decimal_to_float(uint64_t m, int exp, float *out)
+{
+    double d;
+    uint64_t bits;
+
+    if (!m) { *out = 0; return 1; }
+    if (m >= (1ull << 53) || exp < -22 || exp > 22) return 0;
+    d = exp < 0 ? (double)m / text_powers[-exp] : (double)m * text_powers[exp];
+    memcpy(&bits, &d, sizeof bits);
+    if (d < FLT_MIN || d > FLT_MAX || (bits & 0x1fffffff) == 0x10000000) return 0;
+    *out = (float)d;
+    return 1;
+}
+
+/* writes digits * 10^exp in plain decimal notation */
+static void
+text_put_decimal(struct text_buffer *b, int negative, uint64_t digits, int exp)
+{
+    char s[24];
+    int n = 0, point;
+
+    while (digits && digits % 10 == 0) { digits /= 10; ++exp; }
+    do { s[n++] = (char)('0' + digits % 10); digits /= 10; } while (digits);
+
+    if (negative) b->data[b->size++] = '-';
+    point = n + exp;  /* digits before the decimal point */
+    if (point <= 0)
+    {
+        TEXT_PUT_LITERAL(b, "0.");
+        while (point++ < 0) b->data[b->size++] = '0';
+        while (n) b->data[b->size++] = s[--n];
+        return;
+    }
+    while (n && point) { b->data[b->size++] = s[--n]; --point; }
+    while (point--) b->data[b->size++] = '0';
+    if (n) b->data[b->size++] = '.';
+    while (n) b->data[b->size++] = s[--n];
+}
+
+/* shortest decimal that reads back as the same float */
+static void
+text_put_float(struct text_buffer *b, float value)
+{
+    float a = value < 0 ? -value : value;
+    char s[32];
+    int len;
+
+    if (a < 1e9f && value == (float)(int32_t)value && (value || !signbit(value)))
+    {
+        text_put_int(b, (int32_t)value);
+        return;
+    }
+
+    /* try 1 to 9 significant digits, rounded to nearest, until one reads back */
+    if (a >= 1e-6f && a < 1e9f)
+    {
+        int scale = (int)floor(log10(a));
+        for (int precision = 1; precision <= 9; ++precision)
+        {
+            int k = precision - 1 - scale;
+            double scaled = k >= 0 ? a * text_powers[k] : a / text_powers[-k];
+            uint64_t digits = (uint64_t)(scaled + 0.5);
+            float back;
+            if (text_decimal_to_float(digits, -k, &back) && back == a)
+            {
+                text_put_decimal(b, value < 0, digits, -k);
+                return;
+            }
+        }
+    }
+
+    if (value != value || a - a != 0)
+    {
+        /* JSON has no inf or nan, write the nearest finite value */
+        value = value != value ? 0 : value > 0 ? FLT_MAX : -FLT_MAX;
+    }
+    for (int precision = 6; ; ++precision)
+    {
+        len = snprintf(s, sizeof s, "%.*g", precision, value);
+        if (precision == 9 || strtof(s, NULL) == value) break;
+    }
+    text_put(b, s, len);
+}
+
+static void
+text_put_string(struct text_buffer *b, const char *s)
+{
+    b->data[b->size++] = '"';
+    text_put(b, s, strlen(s));
+    b->data[b->size++] = '"';
+}
+
+/*
+ * Formats `view` as text into a malloc'ed buffer. Returns NULL and sets the
+ * SDL error on failure.
+ */
+static char*
+text_format_write(struct graph_view *view, struct config *conf, size_t *size)
+{
+    struct text_buffer b = {0};
+    /* longest node line is a type name plus two floats of at most 16 characters */
+    size_t name_max = 0;
+
+    for (int i = 0; i < conf->node_count; ++i)
+        if (strlen(conf->nodes[i].name) > name_max) name_max = strlen(conf->nodes[i].name);
+    for (int i = 0; i < conf->enum_count; ++i)
+        for (int j = 0; j < conf->enums[i].count; ++j)
+            if (strlen(conf->enums[i].values[j]) > name_max) name_max = strlen(conf->enums[i].values[j]);
+
+    if (!text_reserve(&b, 256)) goto oom;
+    TEXT_PUT_LITERAL(&b, "{\n\"format\": \"aigraph\", \"version\": ");
+    text_put_int(&b, TEXT_FORMAT_VERSION);
+    TEXT_PUT_LITERAL(&b, ",\n\"scroll\": [");
+    text_put_float(&b, view->scroll_x);
+    TEXT_PUT_LITERAL(&b, ", ");
+    text_put_float(&b, view->scroll_y);
+    TEXT_PUT_LITERAL(&b, "],\n\"nodes\": [\n");
+
+    if (!text_reserve(&b, view->node_count * (name_max + 64))) goto oom;
+    for (int i = 0; i < view->node_count; ++i)
+    {
+        struct aig_node *n = &view->nodes[i];
+        TEXT_PUT_LITERAL(&b, "{\"type\": ");
+        text_put_string(&b, conf->nodes[n->type].name);
+        TEXT_PUT_LITERAL(&b, ", \"pos\": [");
+        text_put_float(&b, n->x);
+        TEXT_PUT_LITERAL(&b, ", ");
+        text_put_float(&b, n->y);
+        if (i + 1 < view->node_count) TEXT_PUT_LITERAL(&b, "]},\n");
+        else TEXT_PUT_LITERAL(&b, "]}\n");
+    }
+
+    if (!text_reserve(&b, 32 + view->link_count * 56)) goto oom;
+    TEXT_PUT_LITERAL(&b, "],\n\"links\": [\n");
+    for (int i = 0; i < view->link_count; ++i)
+    {
+        struct aig_link *l = &view->links[i];
+        b.data[b.size++] = '[';
+        text_put_int(&b, l->in_id);
+        TEXT_PUT_LITERAL(&b, ", ");
+        text_put_int(&b, l->in_slot);
+        TEXT_PUT_LITERAL(&b, ", ");
+        text_put_int(&b, l->out_id);
+        TEXT_PUT_LITERAL(&b, ", ");
+        text_put_int(&b, l->out_slot);
+        if (i + 1 < view->link_count) TEXT_PUT_LITERAL(&b, "],\n");
+        else TEXT_PUT_LITERAL(&b, "]\n");
+    }
+
+    if (!text_reserve(&b, 32 + view->const_count * 48)) goto oom;
+    TEXT_PUT_LITERAL(&b, "],\n\"consts\": [\n");
+    for (int i = 0; i < view->const_count; ++i)
+    {
+        struct aig_const *c = &view->consts[i];
+        b.data[b.size++] = '[';
+        text_put_int(&b, c->node_id);
+        TEXT_PUT_LITERAL(&b, ", ");
+        text_put_int(&b, c->slot);
+        TEXT_PUT_LITERAL(&b, ", ");
+        text_put_float(&b, c->value);
+        if (i + 1 < view->const_count) TEXT_PUT_LITERAL(&b, "],\n");
+        else TEXT_PUT_LITERAL(&b, "]\n");
+    }
+
+    if (!text_reserve(&b, 32 + view->prop_count * (name_max + 48))) goto oom;
+    TEXT_PUT_LITERAL(&b, "],\n\"props\": [\n");
+    for (int i = 0; i < view->prop_count; ++i)
+    {
+        struct aig_prop *p = &view->props[i];
+        struct property_info *info = &conf->nodes[view->nodes[p->node_id].type].props[p->slot];
+        union { int32_t i; float f; short e; } value;
+        value.i = p->value;
+
+        b.data[b.size++] = '[';
+        text_put_int(&b, p->node_id);
+        TEXT_PUT_LITERAL(&b, ", ");
+        text_put_int(&b, p->slot);
+        TEXT_PUT_LITERAL(&b, ", ");
+        switch (info->type)
+        {
+            case FIELD_INT: text_put_int(&b, value.i); break;
+            case FIELD_FLOAT: text_put_float(&b, value.f); break;
+            case FIELD_ENUM:
+                {struct enum_info *e = &conf->enums[info->enum_type];
+                if (value.e >= 0 && value.e < e->count) text_put_string(&b, e->values[value.e]);
+                else text_put_int(&b, value.e);}
+                break;
+        }
+        if (i + 1 < view->prop_count) TEXT_PUT_LITERAL(&b, "],\n");
+        else TEXT_PUT_LITERAL(&b, "]\n");
+    }
+    TEXT_PUT_LITERAL(&b, "]\n}\n");
+
+    *size = b.size;
+    return b.data;
+
+oom:
+    free(b.data);
+    SDL_SetError("out of memory");
+    return NULL;
+}
+
+struct text_parser
+{
+    const char *begin, *p, *end;
+    const char *path;
+    struct config *conf;
+    struct graph_view *view;
+    int node_capacity, link_capacity, const_capacity, prop_capacity;
+    int failed;
+};
+
+static int
+text_error(struct text_parser *tp, const char *fmt, ...)
+{
+    char message[256];
+    int line = 1;
+    va_list args;
+
+    if (tp->failed) return 0;
+    tp->failed = 1;
+    for (const char *c = tp->begin; c < tp->p; ++c) line += *c == '\n';
+    va_start(args, fmt);
+    vsnprintf(message, sizeof message, fmt, args);
+    va_end(args);
+    SDL_SetError("%s:%d: %s", tp->path, line, message);
+    return 0;
+}
+
+static inline void
+text_skip_ws(struct text_parser *tp)
+{
+    const char *p = tp->p, *end = tp->end;
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) ++p;
+    tp->p = p;
+}
+
+/* skips whitespace and consumes `c` */
+static inline int
+text_expect(struct text_parser *tp, char c)
+{
+    text_skip_ws(tp);
+    if (tp->p < tp->end && *tp->p == c) { ++tp->p; return 1; }
+    return text_error(tp, "expected '%c'", c);
+}
+
+/* skips whitespace and consumes `c` if it is next */
+static inline int
+text_accept(struct text_parser *tp, char c)
+{
+    text_skip_ws(tp);
+    if (tp->p < tp->end && *tp->p == c) { ++tp->p; return 1; }
+    return 0;
+}
+
+/* points `s` into the file; escapes are skipped over but not decoded */
+static int
+text_parse_string(struct text_parser *tp, const char **s, int *len)
+{
+    const char *p;
+    if (!text_expect(tp, '"')) return 0;
+    p = tp->p;
+    while (p < tp->end && *p != '"')
+    {
+        if (*p == '\\') ++p;
+        ++p;
+    }
+    if (p >= tp->end) return text_error(tp, "unterminated string");
+    *s = tp->p;
+    *len = (int)(p - tp->p);
+    tp->p = p + 1;
+    return 1;
+}
+
+static int
+text_parse_int(struct text_parser *tp, int32_t *out)
+{
+    const char *p, *end = tp->end;
+    int64_t v = 0;
+    int neg = 0;
+
+    text_skip_ws(tp);
+    p = tp->p;
+    if (p < end && *p == '-') { neg = 1; ++p; }
+    if (p >= end || (unsigned)(*p - '0') > 9) return text_error(tp, "expected an integer");
+    while (p < end && (unsigned)(*p - '0') <= 9)
+    {
+        v = v * 10 + (*p++ - '0');
+        if (v > (int64_t)INT32_MAX + 1) return text_error(tp, "integer out of range");
+    }
+    if (neg) v = -v;
+    if (v > INT32_MAX) return text_error(tp, "integer out of range");
+    *out = (int32_t)v;
+    tp->p = p;
+    return 1;
+}
+
+/* decimal to float, exact: the fast path or strtof */
+static int
+text_parse_float(struct text_parser *tp, float *out)
+{
+    const char *p, *start, *end = tp->end;
+    uint64_t m = 0;
+    int digits = 0, seen = 0, exp = 0, neg = 0;
+
+    text_skip_ws(tp);
+    p = start = tp->p;
+    if (p < end && *p == '-') { neg = 1; ++p; }
+    for (; p < end && (unsigned)(*p - '0') <= 9; ++p, seen = 1)
+    {
+        if (digits < 19) { m = m * 10 + (*p - '0'); digits += m != 0; }
+        else ++exp;
+    }
+    if (p < end && *p == '.')
+    {
+        for (++p; p < end && (unsigned)(*p - '0') <= 9; ++p, seen = 1)
+        {
+            if (digits < 19) { m = m * 10 + (*p - '0'); digits += m != 0; --exp; }
+        }
+    }
+    if (!seen) return text_error(tp, "expected a number");
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        int e = 0, eneg = 0;
+        ++p;
+        if (p < end && (*p == '-' || *p == '+')) eneg = *p++ == '-';
+        if (p >= end || (unsigned)(*p - '0') > 9) return text_error(tp, "expected an exponent");
+        for (; p < end && (unsigned)(*p - '0') <= 9; ++p) if (e < 10000) e = e * 10 + (*p - '0');
+        exp += eneg ? -e : e;
+    }
+    tp->p = p;
+
+    if (text_decimal_to_float(m, exp, out))
+    {
+        if (neg) *out = -*out;
+        return 1;
+    }
+
+    {char buf[64];
+    if (p - start >= (ptrdiff_t)sizeof buf) return text_error(tp, "number too long");
+    memcpy(buf, start, p - start);
+    buf[p - start] = '\0';
+    *out = strtof(buf, NULL);}
+    return 1;
+}
+
+static int
+text_skip_value(struct text_parser *tp, int depth)
+{
+    const char *s;
+    int len;
+
+    if (depth > TEXT_MAX_DEPTH) return text_error(tp, "nesting too deep");
+    text_skip_ws(tp);
+    if (tp->p >= tp->end) return text_error(tp, "unexpected end of file");
+
+    switch (*tp->p)
+    {
+        case '"': return text_parse_string(tp, &s, &len);
+        case '{':
+        case '[':
+            {char close = *tp->p == '{' ? '}' : ']';
+            ++tp->p;
+            if (text_accept(tp, close)) return 1;
+            do
+            {
+                if (close == '}' && !(text_parse_string(tp, &s, &len) && text_expect(tp, ':'))) return 0;
+                if (!text_skip_value(tp, depth + 1)) return 0;
+            } while (text_accept(tp, ','));
+            return text_expect(tp, close);}
+        case 't': case 'f': case 'n':
+            {static const char *words[] = { "true", "false", "null" };
+            for (int i = 0; i < 3; ++i)
+            {
+                size_t n = strlen(words[i]);
+                if ((size_t)(tp->end - tp->p) >= n && !memcmp(tp->p, words[i], n)) { tp->p += n; return 1; }
+            }
+            return text_error(tp, "unexpected token");}
+        default:
+            {float f;
+            return text_parse_float(tp, &f);}
+    }
+}
+
+static inline int
+text_key_is(const char *s, int len, const char *key)
+{
+    return (int)strlen(key) == len && !memcmp(s, key, len);
+}
+
+/* makes room for one more record after the `count` in use */
+static int
+text_grow(struct text_parser *tp, void **records, int *capacity, int count, size_t record_size)
+{
+    void *grown;
+    int new_capacity;
+
+    if (count < *capacity) return 1;
+    new_capacity = *capacity ? *capacity * 2 : 1024;
+    grown = realloc(*records, new_capacity * record_size);
+    if (!grown) return text_error(tp, "out of memory");
+    *records = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+static int
+text_parse_node(struct text_parser *tp)
+{
+    struct graph_view *view = tp->view;
+    struct aig_node *node;
+    const char *key, *s;
+    int len, slen, has_type = 0;
+
+    if (!text_grow(tp, (void**)&view->nodes, &tp->node_capacity, view->node_count, sizeof *view->nodes))
+        return 0;
+    node = &view->nodes[view->node_count];
+    node->x = node->y = 0;
+
+    if (!text_expect(tp, '{')) return 0;
+    if (!text_accept(tp, '}')) do
+    {
+        if (!text_parse_string(tp, &key, &len) || !text_expect(tp, ':')) return 0;
+        if (text_key_is(key, len, "type"))
+        {
+            if (!text_parse_string(tp, &s, &slen)) return 0;
+            node->type = config_find_type(tp->conf, s, slen);
+            if (node->type < 0) return text_error(tp, "unknown node type '%.*s'", slen, s);
+            has_type = 1;
+        }
+        else if (text_key_is(key, len, "pos"))
+        {
+            if (!text_expect(tp, '[') || !text_parse_float(tp, &node->x) || !text_expect(tp, ',') ||
+                !text_parse_float(tp, &node->y) || !text_expect(tp, ']'))
+                return 0;
+        }
+        else if (!text_skip_value(tp, 1)) return 0;
+    } while (text_accept(tp, ','));
+    if (!text_expect(tp, '}')) return 0;
+    if (!has_type) return text_error(tp, "node without a type");
+
+    ++view->node_count;
+    return 1;
+}
+
+static int
+text_parse_link(struct text_parser *tp)
+{
+    struct graph_view *view = tp->view;
+    struct aig_link *l;
+
+    if (!text_grow(tp, (void**)&view->links, &tp->link_capacity, view->link_count, sizeof *view->links))
+        return 0;
+    l = &view->links[view->link_count];
+    if (!text_expect(tp, '[') ||
+        !text_parse_int(tp, &l->in_id) || !text_expect(tp, ',') ||
+        !text_parse_int(tp, &l->in_slot) || !text_expect(tp, ',') ||
+        !text_parse_int(tp, &l->out_id) || !text_expect(tp, ',') ||
+        !text_parse_int(tp, &l->out_slot) || !text_expect(tp, ']'))
+        return 0;
+    ++view->link_count;
+    return 1;
+}
+
+static int
+text_parse_const(struct text_parser *tp)
+{
+    struct graph_view *view = tp->view;
+    struct aig_const *c;
+
+    if (!text_grow(tp, (void**)&view->consts, &tp->const_capacity, view->const_count, sizeof *view->consts))
+        return 0;
+    c = &view->consts[view->const_count];
+    if (!text_expect(tp, '[') ||
+        !text_parse_int(tp, &c->node_id) || !text_expect(tp, ',') ||
+        !text_parse_int(tp, &c->slot) || !text_expect(tp, ',') ||
+        !text_parse_float(tp, &c->value) || !text_expect(tp, ']'))
+        return 0;
+    ++view->const_count;
+    return 1;
+}
+
+static int
+text_parse_prop(struct text_parser *tp)
+{
+    struct graph_view *view = tp->view;
+    struct property_info *info;
+    struct node_info *node;
+    struct aig_prop *p;
+    union { int32_t i; float f; short e; } value;
+
+    if (!text_grow(tp, (void**)&view->props, &tp->prop_capacity, view->prop_count, sizeof *view->props))
+        return 0;
+    p = &view->props[view->prop_count];
+    if (!text_expect(tp, '[') ||
+        !text_parse_int(tp, &p->node_id) || !text_expect(tp, ',') ||
+        !text_parse_int(tp, &p->slot) || !text_expect(tp, ','))
+        return 0;
+
+    /* the value's meaning depends on the node, so it has to be known by now */
+    if (p->node_id < 0 || p->node_id >= view->node_count)
+        return text_error(tp, "property of unknown node %d", p->node_id);
+    node = &tp->conf->nodes[view->nodes[p->node_id].type];
+    if (p->slot < 0 || p->slot >= node->prop_count)
+        return text_error(tp, "node type '%s' has no property %d", node->name, p->slot);
+    info = &node->props[p->slot];
+
+    value.i = 0;
+    switch (info->type)
+    {
+        case FIELD_INT:
+            if (!text_parse_int(tp, &value.i)) return 0;
+            break;
+        case FIELD_FLOAT:
+            if (!text_parse_float(tp, &value.f)) return 0;
+            break;
+        case FIELD_ENUM:
+            {const char *s;
+            int len;
+            if (!text_parse_string(tp, &s, &len)) return 0;
+            value.e = (short)config_find_value(tp->conf, info->enum_type, s, len);
+            if (value.e < 0)
+                return text_error(tp, "'%.*s' is not a value of property '%s'", len, s, info->name);}
+            break;
+    }
+    p->value = value.i;
+    if (!text_expect(tp, ']')) return 0;
+    ++view->prop_count;
+    return 1;
+}
+
+static int
+text_parse_array(struct text_parser *tp, int (*parse_record)(struct text_parser*))
+{
+    if (!text_expect(tp, '[')) return 0;
+    if (text_accept(tp, ']')) return 1;
+    do
+    {
+        if (!parse_record(tp)) return 0;
+    } while (text_accept(tp, ','));
+    return text_expect(tp, ']');
+}
+
+static int
+text_parse_document(struct text_parser *tp)
+{
+    const char *key;
+    int len;
+
+    if (!text_expect(tp, '{')) return 0;
+    if (!text_accept(tp, '}')) do
+    {
+        if (!text_parse_string(tp, &key, &len) || !text_expect(tp, ':')) return 0;
+        if (text_key_is(key, len, "version"))
+        {
+            int32_t version;
+            if (!text_parse_int(tp, &version)) return 0;
+            if (version != TEXT_FORMAT_VERSION) return text_error(tp, "unsupported version %d", version);
+        }
+        else if (text_key_is(key, len, "scroll"))
+        {
+            if (!text_expect(tp, '[') || !text_parse_float(tp, &tp->view->scroll_x) || !text_expect(tp, ',') ||
+                !text_parse_float(tp, &tp->view->scroll_y) || !text_expect(tp, ']'))
+                return 0;
+        }
+        else if (text_key_is(key, len, "nodes"))
+        {
+            if (!text_parse_array(tp, text_parse_node)) return 0;
+        }
+        else if (text_key_is(key, len, "links"))
+        {
+            if (!text_parse_array(tp, text_parse_link)) return 0;
+        }
+        else if (text_key_is(key, len, "consts"))
+        {
+            if (!text_parse_array(tp, text_parse_const)) return 0;
+        }
+        else if (text_key_is(key, len, "props"))
+        {
+            if (!text_parse_array(tp, text_parse_prop)) return 0;
+        }
+        else if (!text_skip_value(tp, 1)) return 0;
+    } while (text_accept(tp, ','));
+    if (!text_expect(tp, '}')) return 0;
+
+    text_skip_ws(tp);
+    if (tp->p != tp->end) return text_error(tp, "trailing data after the graph");
+    return 1;
+}
+
+/* releases a view filled by text_format_read */
+static void
+text_view_free(struct graph_view *view)
+{
+    free(view->nodes);
+    free(view->links);
+    free(view->consts);
+    free(view->props);
+    memset(view, 0, sizeof *view);
+}
+
+/*
+ * Parses the text graph at `path` into `view`, whose record arrays are
+ * malloc'ed and released with text_view_free. Ids and slots other than
+ * property slots are not checked, run graph_view_validate on the result.
+ * Returns 0 and sets the SDL error on failure.
+ */
+static int
+text_format_read(struct graph_view *view, const char *path, struct config *conf)
+{
+    struct file_map map;
+    struct text_parser tp;
+    int ok;
+
+    memset(view, 0, sizeof *view);
+    if (!file_map_open(&map, path)) return 0;
+
+    memset(&tp, 0, sizeof tp);
+    tp.begin = tp.p = map.data;
+    tp.end = tp.begin + map.size;
+    tp.path = path;
+    tp.conf = conf;
+    tp.view = view;
+
+    ok = text_parse_document(&tp);
+    file_map_close(&map);
+    if (!ok) text_view_free(view);
+    return ok;
+}
+
+/* writes `view` as text to `path`; returns 0 and sets the SDL error on failure */
+static int
+text_format_save(struct graph_view *view, const char *path, struct config *conf)
+{
+    char error[256];
+    size_t size;
+    char *text = text_format_write(view, conf, &size);
+    int ok;
+
+    if (!text) return 0;
+    ok = file_write_durable(path, text, size, error, sizeof error);
+    if (!ok) SDL_SetError("%s", error);
+    free(text);
+    return ok;
+}
+
+#endif
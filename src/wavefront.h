@@ -0,0 +1,186 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_atomic.h>
+#include <SDL2/SDL_timer.h>
+#include "compiler.h"
+#include "jobs.h"
+
+/*
+ * Runs single agents of big compiled graphs across a job pool, for graphs
+ * too big for one thread and run for too few agents to batch. Every thread
+ * of the pool takes an equal share of each parallel segment and one of
+ * them runs the sequential segments; a spin barrier after each segment is
+ * the only synchronization. Events go to fixed slots, one per side-effect
+ * instruction, and are compacted afterwards, so they come in the order
+ * compiled_graph_run gives. The uniform prologue isn't run, registers
+ * come with it done, as for compiled_graph_run. Programs without parallel
+ * segments, or runs without worker threads, go to compiled_graph_run.
+ */
+
+struct wavefront
+{
+    struct compiled_graph *g;
+    struct job_pool *pool;
+    uint32_t *slots;        /* per instruction, its event slot */
+    int workers;
+    SDL_atomic_t arrived, phase;
+    /* the run in progress */
+    float *registers;
+    const float *inputs;
+    struct aigc_event *events;
+};
+
+/* sets up runs of `g` on `pool`; returns 0 when out of memory */
+static int
+wavefront_init(struct wavefront *w, struct compiled_graph *g, struct job_pool *pool)
+{
+    uint32_t slot = 0;
+
+    memset(w, 0, sizeof *w);
+    w->g = g;
+    w->pool = pool;
+    w->workers = jobs_worker_count(pool);
+    w->slots = malloc((g->header->instruction_count + 1) * sizeof *w->slots);
+    if (!w->slots) return 0;
+    for (uint32_t k = 0; k < g->header->instruction_count; ++k)
+    {
+        w->slots[k] = slot;
+        slot += aigc_ops[g->instructions[k].op].side_effect;
+    }
+    return 1;
+}
+
+static void
+wavefront_free(struct wavefront *w)
+{
+    free(w->slots);
+    memset(w, 0, sizeof *w);
+}
+
+/* whether runs are split across threads */
+static int
+wavefront_parallel(struct wavefront *w)
+{
+    return w->g->header->parallel_count && w->workers > 1;
+}
+
+/* waits for every thread of the run; the last one to arrive releases the others */
+static void
+wavefront_barrier(struct wavefront *w)
+{
+    int phase = SDL_AtomicGet(&w->phase);
+    if (SDL_AtomicAdd(&w->arrived, 1) == w->workers - 1)
+    {
+        SDL_AtomicSet(&w->arrived, 0);
+        SDL_AtomicAdd(&w->phase, 1);
+        return;
+    }
+    /* spin, letting other threads on the core run if the wait gets long */
+    for (int spins = 0; SDL_AtomicGet(&w->phase) == phase; ++spins)
+        if (spins >= 1 << 12) SDL_Delay(0);
+}
+
+/*
+ * Runs instructions [first, end) for the agent of the run in progress,
+ * side effects writing their event slot, with op OP_NONE when they don't
+ * fire.
+ */
+static void
+wavefront_run_range(struct wavefront *w, uint32_t first, uint32_t end)
+{
+    struct compiled_graph *g = w->g;
+    const uint32_t *operands = g->operands;
+    const int32_t *props = g->props;
+    const float *inputs = w->inputs;
+    float *r = w->registers;
+
+    for (uint32_t k = first; k < end; ++k)
+    {
+        struct aigc_instruction *in = &g->instructions[k];
+        const uint32_t *a = operands + in->args;
+        switch (in->op)
+        {
+            case OP_INPUT:
+                r[in->dst] = inputs[props[in->props]];
+                break;
+            case OP_SUM:
+                r[in->dst] = r[a[0]] + r[a[1]];
+                break;
+            case OP_SUM3:
+                r[in->dst] = r[a[0]] + r[a[1]] + r[a[2]];
+                break;
+            case OP_NEGATE:
+                r[in->dst] = -r[a[0]];
+                break;
+            case OP_PLAY_ANIM:
+            {
+                struct aigc_event *e = &w->events[w->slots[k]];
+                e->op = r[a[0]] > 0 ? in->op : OP_NONE;
+                e->node = in->node;
+                e->props = props + in->props;
+                e->value = r[a[0]];
+                e->agent = 0;
+                break;
+            }
+            case OP_KERNEL:
+            case AIGC_OP_SUM_CHAIN:
+                g->calls[k](r, a, in->arg_count, in->dst, props + in->props);
+                break;
+            case AIGC_OP_SUB:
+                r[in->dst] = r[a[0]] - r[a[1]];
+                break;
+            case AIGC_OP_ADD_INPUT:
+                r[in->dst] = r[a[0]] + inputs[props[in->props]];
+                break;
+        }
+    }
+}
+
+static void
+wavefront_job(void *user, int index, int worker)
+{
+    struct wavefront *w = user;
+    struct aigc_header *h = w->g->header;
+
+    (void)worker;
+    for (uint32_t s = 0; s < h->segment_count; ++s)
+    {
+        struct aigc_segment *seg = &w->g->segments[s];
+        /* the uniform prologue is done before the run */
+        uint32_t start = seg->first > h->uniform_count ? seg->first : h->uniform_count;
+        uint32_t count = seg->first + seg->count > start ? seg->first + seg->count - start : 0;
+        if (!count) continue;
+        if (seg->parallel)
+        {
+            uint32_t first = start + (uint32_t)((uint64_t)count * index / w->workers);
+            uint32_t end = start + (uint32_t)((uint64_t)count * (index + 1) / w->workers);
+            wavefront_run_range(w, first, end);
+        }
+        else if (index == 0)
+        {
+            wavefront_run_range(w, start, start + count);
+        }
+        if (s + 1 < h->segment_count) wavefront_barrier(w);
+    }
+}
+
+/* compiled_graph_run for one agent, on the pool if the program has parallel segments */
+static int
+wavefront_run(struct wavefront *w, float *registers, const float *inputs, struct aigc_event *events)
+{
+    int event_count = 0;
+
+    if (!wavefront_parallel(w)) return compiled_graph_run(w->g, registers, inputs, events);
+    w->registers = registers;
+    w->inputs = inputs;
+    w->events = events;
+    jobs_run(w->pool, w->workers, wavefront_job, w);
+    for (uint32_t k = 0; k < w->g->header->event_count; ++k)
+        if (events[k].op != OP_NONE) events[event_count++] = events[k];
+    return event_count;
+}
+
+#endif